@@ -94,6 +94,39 @@ void EthernetClass::hardreset()
     delay(150);
   }
 }
+
+uint8_t EthernetClass::socketStatusSnapshot(EthernetSocketStatus *status, uint8_t mask) 
+{
+  uint8_t chip = W5100.getChip();
+  uint8_t count = 0;
+  
+  if (!chip) 
+    return 0;
+  
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) 
+  {
+    if (!(mask & (1 << s))) 
+      continue;
+    
+    if ((chip == 51) && (s >= 4)) 
+    {
+      // W5100 chip never supports more than 4 sockets
+      status[s].ir     = 0;
+      status[s].sr     = SnSR::CLOSED;
+      status[s].rxSize = 0;
+      continue;
+    }
+    
+    W5100.readSnStatus(s, &status[s].ir, &status[s].sr, &status[s].rxSize);
+    count++;
+  }
+  
+  SPI.endTransaction();
+  
+  return count;
+}
   
 int EthernetClass::begin(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
 {
@@ -93,6 +93,17 @@ enum EthernetHardwareStatus {
 	EthernetW5500
 };
 
+// Socket registers as read by Ethernet.socketStatusSnapshot()
+typedef struct {
+	uint8_t  ir;      // Sn_IR
+	uint8_t  sr;      // Sn_SR, SnSR::ESTABLISHED etc.
+	uint16_t rxSize;  // Sn_RX_RSR, received bytes waiting in the chip. Read once, so
+	                  // only exact when 0, available() gets the byte count
+} EthernetSocketStatus;
+
+// KH, lets the WebSockets server poll its sockets with socketStatusSnapshot()
+#define ETHERNET_SOCKET_SNAPSHOT
+
 class EthernetUDP;
 class EthernetClient;
 class EthernetServer;
@@ -122,6 +133,12 @@ public:
   uint8_t softreset(); // can set only after Ethernet.begin
   void hardreset(); // You need to set the Rst pin
   
+  // Sn_IR, Sn_SR and Sn_RX_RSR of the sockets in mask (bit n = socket n) into
+  // status[MAX_SOCK_NUM], one SPI transaction per socket instead of the several
+  // ones of EthernetClient::connected() and available().
+  // Returns the number of sockets read, 0 without hardware
+  uint8_t socketStatusSnapshot(EthernetSocketStatus *status, uint8_t mask = 0xFF);
+  
 	// Initialise the Ethernet shield to use the provided MAC address and
 	// gain the rest of the configuration through DHCP.
 	// Returns 0 if the DHCP configuration failed, and 1 if it succeeded
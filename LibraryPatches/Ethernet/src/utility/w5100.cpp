@@ -492,20 +492,60 @@ W5100Linkstatus W5100Class::getLinkStatus()
 	}
 }
 
+// bytes staged per block transfer where SPI.transfer() only works in place
+#ifndef W5100_SPI_CHUNK_SIZE
+	#define W5100_SPI_CHUNK_SIZE    32
+#endif
+
+// W5100 reads as one buffered 4 byte transfer per frame, like write(). Off by default,
+// upstream found it not to work and init() detects the chip with this read, only turn it
+// on for a board and core it has been verified on
+#ifndef W5100_SPI_BUFFERED_READ
+	#define W5100_SPI_BUFFERED_READ    0
+#endif
+
+// Send a block of data in as few SPI transactions as the core allows
+static void writeBlock(const uint8_t *buf, uint16_t len)
+{
+#if defined(SPI_HAS_TRANSFER_BUF)
+	SPI.transfer(buf, NULL, len);
+#elif defined(ESP32) || defined(ESP8266)
+	// FIFO driven, no receive buffer needed
+	SPI.writeBytes(buf, len);
+#else
+	// SPI.transfer(buf, count) overwrites buf with the received bytes,
+	// so copy the data to a scratch buffer and send it a chunk at a time
+	uint8_t chunk[W5100_SPI_CHUNK_SIZE];
+
+	while (len) 
+	{
+		uint16_t n = (len < W5100_SPI_CHUNK_SIZE) ? len : W5100_SPI_CHUNK_SIZE;
+
+		memcpy(chunk, buf, n);
+		SPI.transfer(chunk, n);
+		buf += n;
+		len -= n;
+	}
+#endif
+}
+
 uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 {
 	uint8_t cmd[8];
 
 	if (chip == 51) 
 	{
+		// the W5100 takes one byte per 4 byte frame, but each frame
+		// goes out as a single buffered transfer
 		for (uint16_t i=0; i<len; i++) 
 		{
-			setSS();
-			SPI.transfer(0xF0);
-			SPI.transfer(addr >> 8);
-			SPI.transfer(addr & 0xFF);
+			cmd[0] = 0xF0;
+			cmd[1] = addr >> 8;
+			cmd[2] = addr & 0xFF;
+			cmd[3] = buf[i];
 			addr++;
-			SPI.transfer(buf[i]);
+			setSS();
+			SPI.transfer(cmd, 4);
 			resetSS();
 		}
 	} 
@@ -517,16 +557,7 @@ uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 		cmd[2] = ((len >> 8) & 0x7F) | 0x80;
 		cmd[3] = len & 0xFF;
 		SPI.transfer(cmd, 4);
-		
-#ifdef SPI_HAS_TRANSFER_BUF
-		SPI.transfer(buf, NULL, len);
-#else
-		// TODO: copy 8 bytes at a time to cmd[] and block transfer
-		for (uint16_t i=0; i < len; i++) 
-		{
-			SPI.transfer(buf[i]);
-		}
-#endif
+		writeBlock(buf, len);
 		resetSS();
 	} 
 	else 
@@ -591,15 +622,7 @@ uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 		else 
 		{
 			SPI.transfer(cmd, 3);
-#ifdef SPI_HAS_TRANSFER_BUF
-			SPI.transfer(buf, NULL, len);
-#else
-			// TODO: copy 8 bytes at a time to cmd[] and block transfer
-			for (uint16_t i=0; i < len; i++) 
-			{
-				SPI.transfer(buf[i]);
-			}
-#endif
+			writeBlock(buf, len);
 		}
 		resetSS();
 	}
@@ -615,7 +638,7 @@ uint16_t W5100Class::read(uint16_t addr, uint8_t *buf, uint16_t len)
 		for (uint16_t i=0; i < len; i++) 
 		{
 			setSS();
-			#if 1
+			#if !W5100_SPI_BUFFERED_READ
 			SPI.transfer(0x0F);
 			SPI.transfer(addr >> 8);
 			SPI.transfer(addr & 0xFF);
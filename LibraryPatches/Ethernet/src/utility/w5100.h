@@ -370,6 +370,42 @@ public:
   // KH
   static uint8_t softReset(void);
   static uint8_t getChip(void) { return chip; }
+  
+  // Sn_IR, Sn_SR and Sn_RX_RSR of a socket, with Sn_RX_RSR read once instead
+  // of until two reads agree.  Data coming in meanwhile can tear the 16 bit
+  // read, but never into 0, so 0 still means nothing was received:
+  // - W5100, a frame per byte anyway: the low byte of Sn_RX_RSR goes first.
+  //   Sn_RX_RSR only grows, so a high byte of 0 read after it means the low
+  //   byte was read below 256, and as 0 that was nothing received.
+  // - W5200 / W5500: Sn_IR up to Sn_RX_WR in one SPI frame.  The high byte
+  //   comes first, so a 0 can also be Sn_RX_RSR growing from below 256 to a
+  //   multiple of 256 in between.  Sn_RX_WR, read later in the frame, then is
+  //   256 or more past Sn_RX_RD, and rsr reports that distance instead.
+  static void readSnStatus(SOCKET s, uint8_t *ir, uint8_t *sr, uint16_t *rsr) 
+  {
+    uint8_t buf[0x2C - 0x02];
+    
+    if (chip == 51) 
+    {
+      *ir  = readSnIR(s);
+      *sr  = readSnSR(s);
+      *rsr = readSn(s, 0x0027);
+      *rsr |= readSn(s, 0x0026) << 8;
+      return;
+    }
+    
+    readSn(s, 0x0002, buf, sizeof(buf));
+    *ir  = buf[0];
+    *sr  = buf[1];
+    *rsr = (buf[0x26 - 0x02] << 8) | buf[0x27 - 0x02];
+    
+    if (*rsr == 0) 
+    {
+      // Sn_RX_WR - Sn_RX_RD
+      *rsr = ((buf[0x2A - 0x02] << 8) | buf[0x2B - 0x02]) - ((buf[0x28 - 0x02] << 8) | buf[0x29 - 0x02]);
+    }
+  }
+  
 #ifdef ETHERNET_LARGE_BUFFERS
   static uint16_t SSIZE;
   static uint16_t SMASK;
@@ -78,6 +78,33 @@ void EthernetClass::initMaxSockNum(uint8_t maxSockNum)
   _maxSockNum = maxSockNum;
 }
 
+#ifdef ETHERNET_LARGE_BUFFERS
+bool EthernetClass::setSocketBufferSizes(const uint8_t *sizesKB) 
+{
+  return W5100.setSocketBufferSizes(sizesKB);
+}
+
+uint16_t EthernetClass::socketBufferSize(uint8_t s) 
+{
+  return (s < MAX_SOCK_NUM) ? W5100.SSIZE_S(s) : 0;
+}
+
+uint16_t EthernetClass::socketTxHighWater(uint8_t s) 
+{
+  return (s < MAX_SOCK_NUM) ? W5100.txHighWater[s] : 0;
+}
+
+uint16_t EthernetClass::socketRxHighWater(uint8_t s) 
+{
+  return (s < MAX_SOCK_NUM) ? W5100.rxHighWater[s] : 0;
+}
+
+void EthernetClass::resetSocketHighWater() 
+{
+  W5100.resetHighWater();
+}
+#endif
+
 uint8_t EthernetClass::softreset() 
 {
   return W5100.softReset();
@@ -94,6 +121,39 @@ void EthernetClass::hardreset()
   }
 }
 
+uint8_t EthernetClass::socketStatusSnapshot(EthernetSocketStatus *status, uint8_t mask) 
+{
+  uint8_t chip = W5100.getChip();
+  uint8_t count = 0;
+  
+  if (!chip) 
+    return 0;
+  
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) 
+  {
+    if (!(mask & (1 << s))) 
+      continue;
+    
+    if ((chip == 51) && (s >= 4)) 
+    {
+      // W5100 chip never supports more than 4 sockets
+      status[s].ir     = 0;
+      status[s].sr     = SnSR::CLOSED;
+      status[s].rxSize = 0;
+      continue;
+    }
+    
+    W5100.readSnStatus(s, &status[s].ir, &status[s].sr, &status[s].rxSize);
+    count++;
+  }
+  
+  SPI.endTransaction();
+  
+  return count;
+}
+
 int EthernetClass::begin(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
 {
 	static DhcpClass s_dhcp;
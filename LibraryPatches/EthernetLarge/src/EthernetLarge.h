@@ -58,7 +58,9 @@
 // up to 4 sockets.  W5200 & W5500 can have up to 8 sockets.  Several bytes
 // of RAM are used for each socket.  Reducing the maximum can save RAM, but
 // you are limited to fewer simultaneous connections.
+#ifndef MAX_SOCK_NUM
 #define MAX_SOCK_NUM 2
+#endif
 
 // By default, each socket uses 2K buffers inside the Wiznet chip.  If
 // MAX_SOCK_NUM is set to fewer than the chip's maximum, uncommenting
@@ -87,6 +89,17 @@ enum EthernetHardwareStatus {
 	EthernetW5500
 };
 
+// Socket registers as read by Ethernet.socketStatusSnapshot()
+typedef struct {
+	uint8_t  ir;      // Sn_IR
+	uint8_t  sr;      // Sn_SR, SnSR::ESTABLISHED etc.
+	uint16_t rxSize;  // Sn_RX_RSR, received bytes waiting in the chip. Read once, so
+	                  // only exact when 0, available() gets the byte count
+} EthernetSocketStatus;
+
+// KH, lets the WebSockets server poll its sockets with socketStatusSnapshot()
+#define ETHERNET_SOCKET_SNAPSHOT
+
 class EthernetUDP;
 class EthernetClient;
 class EthernetServer;
@@ -113,8 +126,28 @@ public:
   // be carefull of the MAX_SOCK_NUM, because in the moment it can't dynamicly changed
   void initMaxSockNum(uint8_t maxSockNum = 8);
 
+#ifdef ETHERNET_LARGE_BUFFERS
+  // Per-socket RX/TX buffer sizes in KB (1, 2, 4, 8 or 16), one per socket up to MAX_SOCK_NUM,
+  // e.g. { 8, 4, 2, 2 } for the WebSocket sockets and a small one for DNS / NTP.
+  // Must be set before Ethernet.begin(), NULL restores the even split.
+  // Sockets are handed out lowest number first
+  bool setSocketBufferSizes(const uint8_t *sizesKB);
+  uint16_t socketBufferSize(uint8_t s);
+  
+  // Highest TX / RX buffer use seen per socket, to tune the sizes
+  uint16_t socketTxHighWater(uint8_t s);
+  uint16_t socketRxHighWater(uint8_t s);
+  void resetSocketHighWater();
+#endif
+
   uint8_t softreset(); // can set only after Ethernet.begin
   void hardreset(); // You need to set the Rst pin
+  
+  // Sn_IR, Sn_SR and Sn_RX_RSR of the sockets in mask (bit n = socket n) into
+  // status[MAX_SOCK_NUM], one SPI transaction per socket instead of the several
+  // ones of EthernetClient::connected() and available().
+  // Returns the number of sockets read, 0 without hardware
+  uint8_t socketStatusSnapshot(EthernetSocketStatus *status, uint8_t mask = 0xFF);
 
 	// Initialise the Ethernet shield to use the provided MAC address and
 	// gain the rest of the configuration through DHCP.
@@ -121,6 +121,11 @@ uint8_t  W5100Class::ss_pin = SS_PIN_DEFAULT;
 #ifdef ETHERNET_LARGE_BUFFERS
 uint16_t W5100Class::SSIZE = 2048;
 uint16_t W5100Class::SMASK = 0x07FF;
+uint8_t  W5100Class::sockSizeKB[MAX_SOCK_NUM];
+uint16_t W5100Class::sockSize[MAX_SOCK_NUM];
+uint16_t W5100Class::sockBase[MAX_SOCK_NUM];
+uint16_t W5100Class::txHighWater[MAX_SOCK_NUM];
+uint16_t W5100Class::rxHighWater[MAX_SOCK_NUM];
 #endif
 W5100Class W5100;
 
@@ -207,11 +212,12 @@ uint8_t W5100Class::init(uint8_t socketNumbers, uint8_t new_ss_pin)
 		SSIZE = 2048;
 #endif
 		SMASK = SSIZE - 1;
+		setBufferLayout(16, MAX_SOCK_NUM);
 #endif
 		for (i=0; i<MAX_SOCK_NUM; i++) 
 		{
-			writeSnRX_SIZE(i, SSIZE >> 10);
-			writeSnTX_SIZE(i, SSIZE >> 10);
+			writeSnRX_SIZE(i, SSIZE_S(i) >> 10);
+			writeSnTX_SIZE(i, SSIZE_S(i) >> 10);
 		}
 		for (; i<8; i++) 
 		{
@@ -242,10 +248,11 @@ uint8_t W5100Class::init(uint8_t socketNumbers, uint8_t new_ss_pin)
 		SSIZE = 2048;
 #endif
 		SMASK = SSIZE - 1;
+		setBufferLayout(16, MAX_SOCK_NUM);
 		for (i=0; i<MAX_SOCK_NUM; i++) 
 		{
-			writeSnRX_SIZE(i, SSIZE >> 10);
-			writeSnTX_SIZE(i, SSIZE >> 10);
+			writeSnRX_SIZE(i, SSIZE_S(i) >> 10);
+			writeSnTX_SIZE(i, SSIZE_S(i) >> 10);
 		}
 		for (; i<8; i++) 
 		{
@@ -271,18 +278,30 @@ uint8_t W5100Class::init(uint8_t socketNumbers, uint8_t new_ss_pin)
 #ifdef ETHERNET_LARGE_BUFFERS
 #if MAX_SOCK_NUM <= 1
 		SSIZE = 8192;
-		writeTMSR(0x03);
-		writeRMSR(0x03);
 #elif MAX_SOCK_NUM <= 2
 		SSIZE = 4096;
-		writeTMSR(0x0A);
-		writeRMSR(0x0A);
 #else
 		SSIZE = 2048;
-		writeTMSR(0x55);
-		writeRMSR(0x55);
 #endif
 		SMASK = SSIZE - 1;
+		setBufferLayout(8, (MAX_SOCK_NUM < 4) ? MAX_SOCK_NUM : 4);
+		{
+			// 2 bits per socket, 1 << n KB
+			uint8_t msr = 0;
+			
+			for (i=0; (i<MAX_SOCK_NUM) && (i<4); i++) 
+			{
+				uint8_t code = 0;
+				
+				while ((1024U << code) < SSIZE_S(i)) 
+					code++;
+				
+				msr |= code << (2 * i);
+			}
+			
+			writeTMSR(msr);
+			writeRMSR(msr);
+		}
 #else
 		writeTMSR(0x55);
 		writeRMSR(0x55);
@@ -484,20 +503,148 @@ W5100Linkstatus W5100Class::getLinkStatus()
 	}
 }
 
+#ifdef ETHERNET_LARGE_BUFFERS
+// Ask for per-socket buffer sizes in KB (1, 2, 4, 8 or 16), one per socket up
+// to MAX_SOCK_NUM, NULL for the even split. Takes effect in init(), which falls
+// back to the even split if they don't fit the chip (16 KB, W5100 8 KB)
+bool W5100Class::setSocketBufferSizes(const uint8_t * sizesKB)
+{
+	uint16_t sum = 0;
+	uint8_t i;
+	
+	for (i=0; i<MAX_SOCK_NUM; i++) 
+	{
+		uint8_t kb = sizesKB ? sizesKB[i] : 0;
+		
+		if (sizesKB && (!kb || (kb & (kb - 1)) || (kb > 16))) 
+			return false;
+			
+		sum += kb;
+	}
+	
+	if (sum > 16) 
+		return false;
+		
+	for (i=0; i<MAX_SOCK_NUM; i++) 
+	{
+		sockSizeKB[i] = sizesKB ? sizesKB[i] : 0;
+	}
+	
+	return true;
+}
+
+void W5100Class::resetHighWater(void)
+{
+	memset(txHighWater, 0, sizeof(txHighWater));
+	memset(rxHighWater, 0, sizeof(rxHighWater));
+}
+
+// Lay the buffers of the first sockets out back to back, SBASE() / RBASE()
+// and the W5500 block select in read() / write() follow this layout
+void W5100Class::setBufferLayout(uint8_t totalKB, uint8_t sockets)
+{
+	bool custom = true;
+	uint16_t sum = 0;
+	uint16_t base = 0;
+	uint8_t i;
+	
+	for (i=0; i<sockets; i++) 
+	{
+		if (!sockSizeKB[i] || (sockSizeKB[i] > totalKB)) 
+		{
+			custom = false;
+			break;
+		}
+		
+		sum += sockSizeKB[i];
+	}
+	
+	if (sum > totalKB) 
+		custom = false;
+	
+	for (i=0; i<MAX_SOCK_NUM; i++) 
+	{
+		if (i >= sockets) 
+			sockSize[i] = 0;
+		else if (custom) 
+			sockSize[i] = (uint16_t) sockSizeKB[i] << 10;
+		else 
+			sockSize[i] = SSIZE;
+			
+		sockBase[i] = base;
+		base += sockSize[i];
+	}
+}
+
+// W5500: split an address of the SBASE() / RBASE() layout into the socket
+// (block select) and the offset in its buffer
+static uint8_t bufferSocket(uint16_t rel, uint16_t *offset)
+{
+	uint8_t s = MAX_SOCK_NUM - 1;
+	
+	while (s && (W5100Class::sockBase[s] > rel)) 
+		s--;
+	
+	*offset = rel - W5100Class::sockBase[s];
+	
+	return s;
+}
+#endif
+
+// bytes staged per block transfer where SPI.transfer() only works in place
+#ifndef W5100_SPI_CHUNK_SIZE
+	#define W5100_SPI_CHUNK_SIZE    32
+#endif
+
+// W5100 reads as one buffered 4 byte transfer per frame, like write(). Off by default,
+// upstream found it not to work and init() detects the chip with this read, only turn it
+// on for a board and core it has been verified on
+#ifndef W5100_SPI_BUFFERED_READ
+	#define W5100_SPI_BUFFERED_READ    0
+#endif
+
+// Send a block of data in as few SPI transactions as the core allows
+static void writeBlock(const uint8_t *buf, uint16_t len)
+{
+#if defined(SPI_HAS_TRANSFER_BUF)
+	SPI.transfer(buf, NULL, len);
+#elif defined(ESP32) || defined(ESP8266)
+	// FIFO driven, no receive buffer needed
+	SPI.writeBytes(buf, len);
+#else
+	// SPI.transfer(buf, count) overwrites buf with the received bytes,
+	// so copy the data to a scratch buffer and send it a chunk at a time
+	uint8_t chunk[W5100_SPI_CHUNK_SIZE];
+
+	while (len) 
+	{
+		uint16_t n = (len < W5100_SPI_CHUNK_SIZE) ? len : W5100_SPI_CHUNK_SIZE;
+
+		memcpy(chunk, buf, n);
+		SPI.transfer(chunk, n);
+		buf += n;
+		len -= n;
+	}
+#endif
+}
+
 uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 {
 	uint8_t cmd[8];
 
 	if (chip == 51) 
 	{
+		// the W5100 takes one byte per 4 byte frame, but each frame
+		// goes out as a single buffered transfer
 		for (uint16_t i=0; i<len; i++) 
 		{
-			setSS();
-			SPI.transfer(0xF0);
-			SPI.transfer(addr >> 8);
-			SPI.transfer(addr & 0xFF);
+			cmd[0] = 0xF0;
+			cmd[1] = addr >> 8;
+			cmd[2] = addr & 0xFF;
+			cmd[3] = buf[i];
 			addr++;
-			SPI.transfer(buf[i]);
+			setSS();
+			SPI.transfer(cmd, 4);
 			resetSS();
 		}
 	} 
@@ -509,16 +656,7 @@ uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 		cmd[2] = ((len >> 8) & 0x7F) | 0x80;
 		cmd[3] = len & 0xFF;
 		SPI.transfer(cmd, 4);
-		
-#ifdef SPI_HAS_TRANSFER_BUF
-		SPI.transfer(buf, NULL, len);
-#else
-		// TODO: copy 8 bytes at a time to cmd[] and block transfer
-		for (uint16_t i=0; i < len; i++) 
-		{
-			SPI.transfer(buf[i]);
-		}
-#endif
+		writeBlock(buf, len);
 		resetSS();
 	} 
 	else 
@@ -543,30 +681,32 @@ uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 		{
 			// transmit buffers  8000-87FF, 8800-8FFF, 9000-97FF, etc
 			//  10## #nnn nnnn nnnn
+			#if defined(ETHERNET_LARGE_BUFFERS)
+			uint16_t offset;
+			uint8_t  s = bufferSocket(addr - 0x8000, &offset);
+			
+			cmd[0] = offset >> 8;
+			cmd[1] = offset & 0xFF;
+			cmd[2] = (s << 5) | 0x14;
+			#else
 			cmd[0] = addr >> 8;
 			cmd[1] = addr & 0xFF;
-			#if defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 1
-			cmd[2] = 0x14;                       // 16K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 2
-			cmd[2] = ((addr >> 8) & 0x20) | 0x14; // 8K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 4
-			cmd[2] = ((addr >> 7) & 0x60) | 0x14; // 4K buffers
-			#else
 			cmd[2] = ((addr >> 6) & 0xE0) | 0x14; // 2K buffers
 			#endif
 		} 
 		else 
 		{
 			// receive buffers
+			#if defined(ETHERNET_LARGE_BUFFERS)
+			uint16_t offset;
+			uint8_t  s = bufferSocket(addr - 0xC000, &offset);
+			
+			cmd[0] = offset >> 8;
+			cmd[1] = offset & 0xFF;
+			cmd[2] = (s << 5) | 0x1C;
+			#else
 			cmd[0] = addr >> 8;
 			cmd[1] = addr & 0xFF;
-			#if defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 1
-			cmd[2] = 0x1C;                       // 16K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 2
-			cmd[2] = ((addr >> 8) & 0x20) | 0x1C; // 8K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 4
-			cmd[2] = ((addr >> 7) & 0x60) | 0x1C; // 4K buffers
-			#else
 			cmd[2] = ((addr >> 6) & 0xE0) | 0x1C; // 2K buffers
 			#endif
 		}
@@ -583,15 +723,7 @@ uint16_t W5100Class::write(uint16_t addr, const uint8_t *buf, uint16_t len)
 		else 
 		{
 			SPI.transfer(cmd, 3);
-#ifdef SPI_HAS_TRANSFER_BUF
-			SPI.transfer(buf, NULL, len);
-#else
-			// TODO: copy 8 bytes at a time to cmd[] and block transfer
-			for (uint16_t i=0; i < len; i++) 
-			{
-				SPI.transfer(buf[i]);
-			}
-#endif
+			writeBlock(buf, len);
 		}
 		resetSS();
 	}
@@ -607,7 +739,7 @@ uint16_t W5100Class::read(uint16_t addr, uint8_t *buf, uint16_t len)
 		for (uint16_t i=0; i < len; i++) 
 		{
 			setSS();
-			#if 1
+			#if !W5100_SPI_BUFFERED_READ
 			SPI.transfer(0x0F);
 			SPI.transfer(addr >> 8);
 			SPI.transfer(addr & 0xFF);
@@ -660,29 +792,31 @@ uint16_t W5100Class::read(uint16_t addr, uint8_t *buf, uint16_t len)
 		{
 			// transmit buffers  8000-87FF, 8800-8FFF, 9000-97FF, etc
 			//  10## #nnn nnnn nnnn
+			#if defined(ETHERNET_LARGE_BUFFERS)
+			uint16_t offset;
+			uint8_t  s = bufferSocket(addr - 0x8000, &offset);
+			
+			cmd[0] = offset >> 8;
+			cmd[1] = offset & 0xFF;
+			cmd[2] = (s << 5) | 0x10;
+			#else
 			cmd[0] = addr >> 8;
 			cmd[1] = addr & 0xFF;
-			#if defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 1
-			cmd[2] = 0x10;                       // 16K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 2
-			cmd[2] = ((addr >> 8) & 0x20) | 0x10; // 8K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 4
-			cmd[2] = ((addr >> 7) & 0x60) | 0x10; // 4K buffers
-			#else
 			cmd[2] = ((addr >> 6) & 0xE0) | 0x10; // 2K buffers
 			#endif
 		} else 
 		{
 			// receive buffers
+			#if defined(ETHERNET_LARGE_BUFFERS)
+			uint16_t offset;
+			uint8_t  s = bufferSocket(addr - 0xC000, &offset);
+			
+			cmd[0] = offset >> 8;
+			cmd[1] = offset & 0xFF;
+			cmd[2] = (s << 5) | 0x18;
+			#else
 			cmd[0] = addr >> 8;
 			cmd[1] = addr & 0xFF;
-			#if defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 1
-			cmd[2] = 0x18;                       // 16K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 2
-			cmd[2] = ((addr >> 8) & 0x20) | 0x18; // 8K buffers
-			#elif defined(ETHERNET_LARGE_BUFFERS) && MAX_SOCK_NUM <= 4
-			cmd[2] = ((addr >> 7) & 0x60) | 0x18; // 4K buffers
-			#else
 			cmd[2] = ((addr >> 6) & 0xE0) | 0x18; // 2K buffers
 			#endif
 		}
@@ -360,37 +360,100 @@ private:
   static uint8_t isW5200(void);
   static uint8_t isW5500(void);
 
+#ifdef ETHERNET_LARGE_BUFFERS
+  static void setBufferLayout(uint8_t totalKB, uint8_t sockets);
+#endif
+
 public:
   // KH
   static uint8_t softReset(void);
   static uint8_t getChip(void) { return chip; }
+  
+  // Sn_IR, Sn_SR and Sn_RX_RSR of a socket, with Sn_RX_RSR read once instead
+  // of until two reads agree.  Data coming in meanwhile can tear the 16 bit
+  // read, but never into 0, so 0 still means nothing was received:
+  // - W5100, a frame per byte anyway: the low byte of Sn_RX_RSR goes first.
+  //   Sn_RX_RSR only grows, so a high byte of 0 read after it means the low
+  //   byte was read below 256, and as 0 that was nothing received.
+  // - W5200 / W5500: Sn_IR up to Sn_RX_WR in one SPI frame.  The high byte
+  //   comes first, so a 0 can also be Sn_RX_RSR growing from below 256 to a
+  //   multiple of 256 in between.  Sn_RX_WR, read later in the frame, then is
+  //   256 or more past Sn_RX_RD, and rsr reports that distance instead.
+  static void readSnStatus(SOCKET s, uint8_t *ir, uint8_t *sr, uint16_t *rsr) 
+  {
+    uint8_t buf[0x2C - 0x02];
+    
+    if (chip == 51) 
+    {
+      *ir  = readSnIR(s);
+      *sr  = readSnSR(s);
+      *rsr = readSn(s, 0x0027);
+      *rsr |= readSn(s, 0x0026) << 8;
+      return;
+    }
+    
+    readSn(s, 0x0002, buf, sizeof(buf));
+    *ir  = buf[0];
+    *sr  = buf[1];
+    *rsr = (buf[0x26 - 0x02] << 8) | buf[0x27 - 0x02];
+    
+    if (*rsr == 0) 
+    {
+      // Sn_RX_WR - Sn_RX_RD
+      *rsr = ((buf[0x2A - 0x02] << 8) | buf[0x2B - 0x02]) - ((buf[0x28 - 0x02] << 8) | buf[0x29 - 0x02]);
+    }
+  }
+  
 #ifdef ETHERNET_LARGE_BUFFERS
+  // buffer size of the even split for MAX_SOCK_NUM sockets
   static uint16_t SSIZE;
   static uint16_t SMASK;
+
+  // per-socket layout, TX and RX buffer of a socket have the same size.
+  // sockSizeKB[] holds the sizes asked for with setSocketBufferSizes(),
+  // init() applies them, or the even split if they don't fit the chip
+  static uint8_t  sockSizeKB[MAX_SOCK_NUM];
+  static uint16_t sockSize[MAX_SOCK_NUM];
+  static uint16_t sockBase[MAX_SOCK_NUM];
+
+  // highest TX / RX buffer use seen per socket, in bytes
+  static uint16_t txHighWater[MAX_SOCK_NUM];
+  static uint16_t rxHighWater[MAX_SOCK_NUM];
+
+  static bool setSocketBufferSizes(const uint8_t * sizesKB);
+  static void resetHighWater(void);
+
+  static uint16_t SSIZE_S(uint8_t socknum) { return sockSize[socknum]; }
+  static uint16_t SMASK_S(uint8_t socknum) { return sockSize[socknum] - 1; }
+  static uint16_t SOFFSET(uint8_t socknum) { return sockBase[socknum]; }
 #else
   static const uint16_t SSIZE = 2048;
   static const uint16_t SMASK = 0x07FF;
+
+  static uint16_t SSIZE_S(uint8_t socknum) { (void) socknum; return SSIZE; }
+  static uint16_t SMASK_S(uint8_t socknum) { (void) socknum; return SMASK; }
+  static uint16_t SOFFSET(uint8_t socknum) { return socknum * SSIZE; }
 #endif
   static uint16_t SBASE(uint8_t socknum) 
   {
     if (chip == 51) 
     {
-      return socknum * SSIZE + 0x4000;
+      return SOFFSET(socknum) + 0x4000;
     } 
     else 
     {
-      return socknum * SSIZE + 0x8000;
+      return SOFFSET(socknum) + 0x8000;
     }
   }
   
   static uint16_t RBASE(uint8_t socknum) 
   {
     if (chip == 51) {
-      return socknum * SSIZE + 0x6000;
+      return SOFFSET(socknum) + 0x6000;
     } 
     else 
     {
-      return socknum * SSIZE + 0xC000;
+      return SOFFSET(socknum) + 0xC000;
     }
   }
 
@@ -43,9 +43,11 @@ uint8_t ENC28J60ControlCS = ENC28J60_CONTROL_CS;
    #if defined(ARDUINO)
      #if defined(STM32F2)
        #include <SPI.h>
+       #define ENC28J60_SPI_BLOCK 1
      #elif !defined(STM32F3) && !defined(__STM32F4__)
        #include <SPI.h>
        extern SPIClass SPI;
+       #define ENC28J60_SPI_BLOCK 1
      //#elif defined(ARDUINO_ARCH_AMEBA)
        //SPIClass SPI((void *)(&spi_obj), 11, 12, 13, 10);
        //SPI _spi(SPI_MOSI,SPI_MISO,SPI_SCK,ENC28J60ControlCS);
@@ -94,11 +96,17 @@ extern "C" {
 #define waitspi() while(!(SPSR&(1<<SPIF)))
 #endif
 
+// bytes staged per block transfer where SPI.transfer() only works in place, keep it even
+#ifndef ENC28J60_SPI_CHUNK_SIZE
+  #define ENC28J60_SPI_CHUNK_SIZE 32
+#endif
+
 uint16_t Enc28J60Network::nextPacketPtr;
 uint8_t Enc28J60Network::bank=0xff;
 uint8_t Enc28J60Network::erevid=0;
 
 struct memblock Enc28J60Network::receivePkt;
+uint16_t Enc28J60Network::receiveBuffered = 0;
 
 bool Enc28J60Network::broadcast_enabled = false;
 
@@ -358,6 +366,7 @@ Enc28J60Network::receivePacket(void)
       LogObject.uart_send_strln(F("Enc28J60Network::receivePacket(void) ERROR:ENC28j50 Device not found !! Bypass receivePacket function !!"));
       }
   #endif
+  receiveBuffered = 0;
   uint8_t epktcnt=readReg(EPKTCNT);
   if ((erevid!=0) && (epktcnt!=0))
     {
@@ -563,6 +572,9 @@ Enc28J60Network::readPacket(memhandle handle, memaddress position, uint8_t* buff
   #endif
   len = setReadPtr(handle, position, len);
   readBuffer(len, buffer);
+  // the start of a received packet in uip_buf doesn't have to cross the SPI bus again for chksum()
+  if (handle == UIP_RECEIVEBUFFERHANDLE)
+    receiveBuffered = ((position == 0) && (buffer == (uint8_t*)uip_buf)) ? len : 0;
   #if ACTLOGLEVEL>=LOG_DEBUG_V2
     LogObject.uart_send_str(F("Enc28J60Network::readPacket(memhandle handle, memaddress position, uint8_t* buffer, uint16_t len) DEBUG_V2: Read bytes:"));
     LogObject.uart_send_dec(len);
@@ -816,6 +828,7 @@ Enc28J60Network::freePacket(void)
   #if ACTLOGLEVEL>=LOG_DEBUG_V3
     LogObject.uart_send_strln(F("Enc28J60Network::freePacket(void) DEBUG_V3:Function started"));
   #endif
+    receiveBuffered = 0;
     setERXRDPT();
 }
 
@@ -925,6 +938,10 @@ Enc28J60Network::readBuffer(uint16_t len, uint8_t* data)
     SPDR = ENC28J60_READ_BUF_MEM;
     waitspi();
   #endif
+  #if ENC28J60_SPI_BLOCK
+    // one block transfer, the ENC28J60 ignores what is sent while it reads out
+    SPI.transfer(data, len);
+  #else
   while(len)
     {
     len--;
@@ -943,6 +960,7 @@ Enc28J60Network::readBuffer(uint16_t len, uint8_t* data)
     #endif    
     data++;
     }
+  #endif
   //*data='\0';
   CSPASSIVE;
 }
@@ -966,6 +984,26 @@ Enc28J60Network::writeBuffer(uint16_t len, uint8_t* data)
     SPDR = ENC28J60_WRITE_BUF_MEM;
     waitspi();
   #endif
+  #if ENC28J60_SPI_BLOCK
+    #if defined(SPI_HAS_TRANSFER_BUF)
+      SPI.transfer(data, NULL, len);
+    #elif defined(ESP32) || defined(ESP8266)
+      // FIFO driven, no receive buffer needed
+      SPI.writeBytes(data, len);
+    #else
+      // SPI.transfer(buf, count) overwrites buf with the received bytes,
+      // so copy the data to a scratch buffer and send it a chunk at a time
+      uint8_t chunk[ENC28J60_SPI_CHUNK_SIZE];
+      while(len)
+        {
+        uint16_t n = (len < ENC28J60_SPI_CHUNK_SIZE) ? len : ENC28J60_SPI_CHUNK_SIZE;
+        memcpy(chunk, data, n);
+        SPI.transfer(chunk, n);
+        data += n;
+        len -= n;
+        }
+    #endif
+  #else
   while(len)
     {
     len--;
@@ -984,6 +1022,7 @@ Enc28J60Network::writeBuffer(uint16_t len, uint8_t* data)
       waitspi();
     #endif
     }
+  #endif
   CSPASSIVE;
 }
 
@@ -1106,6 +1145,34 @@ Enc28J60Network::clkout(uint8_t clk)
   writeReg(ECOCON, clk & 0x7);
 }
 
+// Add a block to a running checksum, data[0] is taken as the high byte
+static uint16_t
+chksumBlock(uint16_t sum, const uint8_t* data, uint16_t len)
+{
+  uint16_t t;
+  while (len > 1)
+    {
+    t = (data[0] << 8) + data[1];
+    sum += t;
+    if(sum < t)
+      {
+      sum++;            /* carry */
+      }
+    data += 2;
+    len -= 2;
+    }
+  if (len)
+    {
+    t = (data[0] << 8) + 0;
+    sum += t;
+    if(sum < t)
+      {
+      sum++;            /* carry */
+      }
+    }
+  return sum;
+}
+
 uint16_t
 Enc28J60Network::chksum(uint16_t sum, memhandle handle, memaddress pos, uint16_t len)
 {
@@ -1113,7 +1180,24 @@ Enc28J60Network::chksum(uint16_t sum, memhandle handle, memaddress pos, uint16_t
     LogObject.uart_send_strln(F("Enc28J60Network::chksum(uint16_t sum, memhandle handle, memaddress pos, uint16_t len) DEBUG_V3:Function started"));
   #endif
   uint16_t t;
-  len = setReadPtr(handle, pos, len)-1;
+  memblock *packet = handle == UIP_RECEIVEBUFFERHANDLE ? &receivePkt : &blocks[handle];
+  if (len > packet->size - pos)
+    len = packet->size - pos;
+  // the part of a received packet that is in uip_buf already is summed from there
+  if ((handle == UIP_RECEIVEBUFFERHANDLE) && (pos < receiveBuffered))
+    {
+    t = receiveBuffered - pos;
+    if (t >= len)
+      t = len;
+    else
+      t &= ~1;          /* the rest has to start on a high byte */
+    sum = chksumBlock(sum, (uint8_t*)uip_buf + pos, t);
+    pos += t;
+    len -= t;
+    }
+  if (len == 0)
+    return sum;
+  len = setReadPtr(handle, pos, len);
   CSACTIVE;
   // issue read command
   #if ENC28J60_USE_SPILIB
@@ -1127,6 +1211,18 @@ Enc28J60Network::chksum(uint16_t sum, memhandle handle, memaddress pos, uint16_t
     SPDR = ENC28J60_READ_BUF_MEM;
     waitspi();
   #endif
+  #if ENC28J60_SPI_BLOCK
+    // read a chunk at a time and fold it into the sum, chunks are even so no word is split
+    uint8_t chunk[ENC28J60_SPI_CHUNK_SIZE];
+    while (len)
+      {
+      t = (len < ENC28J60_SPI_CHUNK_SIZE) ? len : ENC28J60_SPI_CHUNK_SIZE;
+      SPI.transfer(chunk, t);
+      sum = chksumBlock(sum, chunk, t);
+      len -= t;
+      }
+  #else
+  len--;
   uint16_t i;
   for (i = 0; i < len; i+=2)
     {
@@ -1174,6 +1270,7 @@ Enc28J60Network::chksum(uint16_t sum, memhandle handle, memaddress pos, uint16_t
       sum++;            /* carry */
       }
     }
+  #endif
   CSPASSIVE;
 
   /* Return sum in host byte order. */
@@ -279,6 +279,7 @@ private:
   static uint8_t erevid;
 
   static struct memblock receivePkt;
+  static uint16_t receiveBuffered; //!< Bytes of the received packet readPacket() put in uip_buf, chksum() sums them from there
 
   static bool broadcast_enabled; //!< True if broadcasts enabled (used to allow temporary disable of broadcast for DHCP or other internal functions)
 
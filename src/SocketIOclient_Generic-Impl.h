@@ -165,7 +165,8 @@ bool SocketIOclient::isConnected()
    @param type socketIOmessageType_t
    @param payload uint8_t
    @param length size_t
-   @param headerToPayload bool (see sendFrame for more details)
+   @param headerToPayload bool  set true if the payload has reserved SIO_MAX_HEADER_SIZE Byte at the beginning,
+                                the WebSocket and Engine.IO / Socket.IO headers go there and all is sent with one write
    @return true if ok
 */
 bool SocketIOclient::send(socketIOmessageType_t type, uint8_t * payload, size_t length, bool headerToPayload)
@@ -174,7 +175,7 @@ bool SocketIOclient::send(socketIOmessageType_t type, uint8_t * payload, size_t
 
   if (length == 0)
   {
-    length = strlen((const char *)payload);
+    length = strlen((const char *)(payload + (headerToPayload ? SIO_MAX_HEADER_SIZE : 0)));
   }
 
   if (clientIsConnected(&_client) && _client.status == WSC_CONNECTED)
@@ -200,7 +201,11 @@ bool SocketIOclient::send(socketIOmessageType_t type, uint8_t * payload, size_t
     }
     else
     {
-      // TODO implement
+      // Engine.IO / Socket.IO Header right in front of the payload, the webSocket Header in front of it
+      payload[WEBSOCKETS_MAX_HEADER_SIZE]     = eIOtype_MESSAGE;
+      payload[WEBSOCKETS_MAX_HEADER_SIZE + 1] = type;
+
+      return WebSocketsClient::sendMessage(&_client, WSop_text, payload, length + 2, true);
     }
   }
 
@@ -378,6 +383,7 @@ void SocketIOclient::handleCbEvent(WStype_t type, uint8_t * payload, size_t leng
     case WStype_FRAGMENT_FIN:
     case WStype_PING:
     case WStype_PONG:
+    case WStype_TIMEOUT:
       break;
   }
 }
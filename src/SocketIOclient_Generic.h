@@ -138,7 +138,7 @@ class SocketIOclient : protected WebSocketsClient
     // KH, add v2.5.1
     void setReconnectInterval(unsigned long time)
     {
-      _reconnectInterval = time;
+      WebSocketsClient::setReconnectInterval(time);
     }
     
     void setExtraHeaders(const char * extraHeaders = nullptr)
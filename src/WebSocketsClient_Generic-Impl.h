@@ -60,10 +60,37 @@
 WebSocketsClient::WebSocketsClient()
 {
   _cbEvent             = NULL;
+  _cbBatchEvent        = NULL;
   _client.num          = 0;
   _client.cIsClient    = true;
   _client.extraHeaders = WEBSOCKETS_STRING("Origin: file://");
   _reconnectInterval   = 500;
+  _connectTimeout      = WEBSOCKETS_TCP_TIMEOUT;
+  _handshakeTimeout    = WEBSOCKETS_TCP_TIMEOUT;
+
+  _reconnectMaxInterval = 0;
+  _reconnectStableTime  = 0;
+  _reconnectDelay       = _reconnectInterval;
+  _connectedSince       = 0;
+  _reconnectAttempts    = 0;
+  _reconnectImmediate   = false;
+
+  _connectState         = WSC_CONNECT_IDLE;
+  _connectStart         = 0;
+  _connectByIP          = false;
+
+#if defined(WEBSOCKETS_NONBLOCKING_CONNECT)
+  _connectFd            = -1;
+#endif
+
+#if defined(WEBSOCKETS_ASYNC_DNS)
+  _dnsLookup            = NULL;
+#endif
+
+  _dnsCacheTTL          = WEBSOCKETS_DNS_CACHE_TTL;
+  _dnsCacheTime         = 0;
+  _dnsCacheValid        = false;
+  _dnsGoodValid         = false;
 
   _port                = 0;
   _host                = "";
@@ -72,6 +99,18 @@ WebSocketsClient::WebSocketsClient()
 WebSocketsClient::~WebSocketsClient()
 {
   disconnect();
+
+  batchRelease();
+  relayDetach(&_client);
+
+#if defined(HAS_SSL)
+  // TLS client kept alive between reconnects
+  if (_client.ssl)
+  {
+    delete _client.ssl;
+    _client.ssl = NULL;
+  }
+#endif
 }
 
 /**
@@ -90,6 +129,19 @@ void WebSocketsClient::begin(const char * host, uint16_t port, const char * url,
 
 #endif
 
+#if defined(HAS_SSL)
+  // TLS client kept alive from a previous begin() and not in use anymore
+  if (_client.ssl && !_client.tcp)
+  {
+    delete _client.ssl;
+  }
+
+  #if defined(SSL_BARESSL)
+  // a cached session is only valid for the host it was negotiated with
+  _sslSession = BearSSL::Session();
+  #endif
+#endif
+
   _client.num    = 0;
   _client.status = WSC_NOT_CONNECTED;
   _client.tcp    = NULL;
@@ -127,8 +179,15 @@ void WebSocketsClient::begin(const char * host, uint16_t port, const char * url,
   asyncConnect();
 #endif
 
+  // an attempt still running targets the old host
+  connectAbort();
+  clearDnsCache();
+
   _lastConnectionFail = 0;
   _lastHeaderSent     = 0;
+
+  _reconnectAttempts  = 0;
+  _reconnectDelay     = _reconnectMaxInterval ? 0 : _reconnectInterval;
   
   WSK_LOGINFO(WEBSOCKETS_GENERIC_VERSION);
 }
@@ -323,160 +382,515 @@ void WebSocketsClient::loop()
 
   WEBSOCKETS_YIELD();
 
+  // a connection attempt runs one step per call, the sketch keeps its loop
+  switch (_connectState)
+  {
+    case WSC_CONNECT_RESOLVING:
+      connectResolve();
+      return;
+
+    case WSC_CONNECT_TCP:
+      connectTcp();
+      return;
+
+    case WSC_CONNECT_TLS:
+      connectTls();
+      return;
+
+    default:
+      break;
+  }
+
   if (!clientIsConnected(&_client))
   {
     // do not flood the server
-    if ((millis() - _lastConnectionFail) < _reconnectInterval)
+    if ((millis() - _lastConnectionFail) < _reconnectDelay)
     {
       return;
     }
 
+    if (!connectPrepare())
+    {
+      return;
+    }
+
+    _connectStart = millis();
+    _connectState = WSC_CONNECT_RESOLVING;
+
 #if defined(HAS_SSL)
-  #warning HAS_SSL
-  
     if (_client.isSSL)
     {
-      WSK_LOGWARN("[WS-Client] Connect wss...");
+      // the TLS client looks the name up itself, it needs it for SNI and the certificate check
+      _connectState = WSC_CONNECT_TLS;
+    }
+#endif
+  }
+  else
+  {
+    //WSK_LOGDEBUG("[WS-Client] handleClientData");
+    handleClientData();
+    WEBSOCKETS_YIELD();
+
+    if (_client.status == WSC_CONNECTED)
+    {
+      handleHBPing();
+      handleHBTimeout(&_client);
+      handleBulk(&_client);
 
-      if (_client.ssl)
+      if (_cork)
       {
-        delete _client.ssl;
-        _client.ssl = NULL;
-        _client.tcp = NULL;
+        txFlush(&_client);
       }
-     
-      _client.ssl = new WEBSOCKETS_NETWORK_SSL_CLASS();
-      _client.tcp = _client.ssl;
-     
-      if (_CA_cert)
+
+      // connection is stable, restart the backoff from the beginning
+      if (_reconnectAttempts && ((millis() - _connectedSince) >= _reconnectStableTime))
       {
-        WSK_LOGWARN("[WS-Client] Setting CA certificate");
+        _reconnectAttempts = 0;
+      }
+    }
+  }
+}
+
+/**
+   first step of a connection attempt, (re)creates the network class
+   @return false if it could not be created
+*/
+bool WebSocketsClient::connectPrepare()
+{
+#if defined(HAS_SSL)
+  #warning HAS_SSL
+
+  if (_client.isSSL)
+  {
+    WSK_LOGWARN("[WS-Client] Connect wss...");
+
+    // reuse the TLS client of the last connection (see clientDisconnect),
+    // saves the heap churn and, where supported, resumes the TLS session
+    if (!_client.ssl)
+    {
+      _client.ssl = new WEBSOCKETS_NETWORK_SSL_CLASS();
+    }
+    
+    _client.tcp = _client.ssl;
+
+    if (!_client.ssl)
+    {
+      WSK_LOGERROR("[WS-Client] Creating SSL class failed!");
+      return false;
+    }
+
+#if defined(SSL_BARESSL)
+    // BearSSL offers the cached session id / ticket and updates it after each full handshake
+    _client.ssl->setSession(&_sslSession);
+#endif
+   
+    if (_CA_cert)
+    {
+      WSK_LOGWARN("[WS-Client] Setting CA certificate");
 
 #if defined(ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
   #warning ESP32 or NETWORK_RTL8720DN
-        _client.ssl->setCACert(_CA_cert);
-        
+      _client.ssl->setCACert(_CA_cert);
+      
 #elif defined(ESP8266) && defined(SSL_AXTLS)
   #warning ESP8266 and SSL_AXTLS
-        _client.ssl->setCACert((const uint8_t *)_CA_cert, strlen(_CA_cert) + 1);
-        
+      _client.ssl->setCACert((const uint8_t *)_CA_cert, strlen(_CA_cert) + 1);
+      
 #elif defined(ESP8266) && ( defined(SSL_BARESSL) || defined(SSL_BEARSSL) )
   #warning ESP8266 and SSL_BEARSSL
-        _client.ssl->setTrustAnchors(_CA_cert);
-        
+      _client.ssl->setTrustAnchors(_CA_cert);
+      
 #elif (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)    //defined(SEEED_WIO_TERMINAL)
   #warning NETWORK_RTL8720DN    
-        _client.ssl->setCACert(_CA_cert); 
-   
+      _client.ssl->setCACert(_CA_cert); 
+ 
 #elif (WEBSOCKETS_NETWORK_TYPE == NETWORK_WIFININA)
   // Do something here for WiFiNINA
 
 #elif (WEBSOCKETS_NETWORK_TYPE == NETWORK_WIFI101)
   // Do something here for WiFi101
-          
+        
 #else
   #error setCACert not implemented
 #endif
-      }
+    }
 
 ////////////////////
 #if defined(ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
-      else if (!SSL_FINGERPRINT_IS_SET) 
-      {
-        // ESP32 has setInsecure() now from v1.0.6
-        _client.ssl->setInsecure();    
-      }
+    else if (!SSL_FINGERPRINT_IS_SET) 
+    {
+      // ESP32 has setInsecure() now from v1.0.6
+      _client.ssl->setInsecure();    
+    }
 #elif defined(ESP8266)
-      else if (!SSL_FINGERPRINT_IS_SET) 
-      {
-        _client.ssl->setInsecure();    
-      }
+    else if (!SSL_FINGERPRINT_IS_SET) 
+    {
+      _client.ssl->setInsecure();    
+    }
 ////////////////////
-       
+     
 #elif ( defined(SSL_BARESSL) || defined(SSL_BEARSSL) )
-      else if (SSL_FINGERPRINT_IS_SET)
+    else if (SSL_FINGERPRINT_IS_SET)
+    {
+      _client.ssl->setFingerprint(_fingerprint);
+    }
+    else
+    {
+      #if defined(ESP8266)      
+      // ESP32 has setInsecure() now from v1.0.6
+      _client.ssl->setInsecure();
+      #endif        
+    }
+    
+    if(_client_cert && _client_key) 
+    {
+      _client.ssl->setClientRSACert(_client_cert, _client_key);
+      WSK_LOGWARN("[WS-Client] setting client certificate and key");
+    }  
+#endif    // defined(ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
+  }
+  else
+  {
+    WSK_LOGWARN("[WS-Client] Connect ws...");
+
+    if (_client.tcp)
+    {
+      delete _client.tcp;
+      _client.tcp = NULL;
+    }
+
+    _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
+  }
+
+#else   // HAS_SSL
+    #warning Not HAS_SSL
+  _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
+#endif  // HAS_SSL
+
+  if (!_client.tcp)
+  {
+    WSK_LOGERROR("[WS-Client] Creating Network class failed!");
+    return false;
+  }
+
+  return true;
+}
+
+/**
+   look the host name up, an address given as host is used as is.
+   On ESP32 the lwIP lookup is started here and polled on the following calls,
+   elsewhere WiFi.hostByName() blocks for this one step until it has an answer
+*/
+void WebSocketsClient::connectResolve()
+{
+#if defined(WEBSOCKETS_ASYNC_DNS)
+  if (_dnsLookup)
+  {
+    uint32_t state = __atomic_load_n(&_dnsLookup->state, __ATOMIC_SEQ_CST);
+
+    if (state == WSC_DNS_PENDING)
+    {
+      if ((millis() - _connectStart) >= _connectTimeout)
       {
-        _client.ssl->setFingerprint(_fingerprint);
+        WSK_LOGWARN1("[WS-Client] DNS lookup timed out for", _host);
+
+        connectDone(false);
       }
-      else
+
+      return;
+    }
+
+    _connectIP = _dnsLookup->ip;
+
+    delete _dnsLookup;
+    _dnsLookup = NULL;
+
+    connectResolved(state == WSC_DNS_FOUND);
+    return;
+  }
+#endif
+
+  _connectByIP = _connectIP.fromString(_host.c_str());
+
+#if defined(WEBSOCKETS_HAS_HOSTBYNAME)
+  if (!_connectByIP && _dnsCacheValid && ((millis() - _dnsCacheTime) < _dnsCacheTTL))
+  {
+    WSK_LOGDEBUG1("[WS-Client] Using cached address of", _host);
+
+    _connectIP   = _dnsCacheIP;
+    _connectByIP = true;
+  }
+
+  if (!_connectByIP)
+  {
+    WSK_LOGINFO1("[WS-Client] Resolving", _host);
+
+#if defined(WEBSOCKETS_ASYNC_DNS)
+    ip_addr_t addr;
+
+    _dnsLookup = new WSdnsLookup_t;
+
+    if (!_dnsLookup)
+    {
+      connectResolved(false);
+      return;
+    }
+
+    _dnsLookup->state = WSC_DNS_PENDING;
+
+    LOCK_TCPIP_CORE();
+    err_t err = dns_gethostbyname(_host.c_str(), &addr, &WebSocketsClient::dnsFoundCb, _dnsLookup);
+    UNLOCK_TCPIP_CORE();
+
+    if (err == ERR_INPROGRESS)
+    {
+      // dnsFoundCb() answers, polled on the next calls
+      return;
+    }
+
+    // answered from the lwIP cache, or failed, the callback is not called
+    delete _dnsLookup;
+    _dnsLookup = NULL;
+
+    if (err == ERR_OK)
+    {
+      _connectIP = IPAddress(ip4_addr_get_u32(ip_2_ip4(&addr)));
+    }
+
+    connectResolved(err == ERR_OK);
+#else
+    connectResolved(WiFi.hostByName(_host.c_str(), _connectIP) == 1);
+#endif
+
+    return;
+  }
+#endif
+
+  // without hostByName() the network class resolves the name in connect()
+  _connectState = WSC_CONNECT_TCP;
+}
+
+#if defined(WEBSOCKETS_HAS_HOSTBYNAME)
+/**
+   go on with the looked up address, or the last known-good one if there is none
+   @param found bool  _connectIP holds the looked up address
+*/
+void WebSocketsClient::connectResolved(bool found)
+{
+  if (found)
+  {
+    _dnsCacheIP    = _connectIP;
+    _dnsCacheTime  = millis();
+    _dnsCacheValid = true;
+  }
+  else if (_dnsGoodValid)
+  {
+    WSK_LOGWARN1("[WS-Client] DNS lookup failed, using last known-good address of", _host);
+
+    _connectIP = _dnsGoodIP;
+  }
+  else
+  {
+    WSK_LOGWARN1("[WS-Client] DNS lookup failed for", _host);
+
+    connectDone(false);
+    return;
+  }
+
+  _connectByIP  = true;
+  _connectState = WSC_CONNECT_TCP;
+}
+#endif
+
+#if defined(WEBSOCKETS_ASYNC_DNS)
+/**
+   lwIP callback of dns_gethostbyname(), runs in the lwIP task
+   @param name const char *
+   @param ipaddr const ip_addr_t *  NULL if the name was not found
+   @param arg void *  the WSdnsLookup_t of the lookup
+*/
+void WebSocketsClient::dnsFoundCb(const char * name, const ip_addr_t * ipaddr, void * arg)
+{
+  WSdnsLookup_t * lookup = (WSdnsLookup_t *) arg;
+
+  (void) name;
+
+  if (ipaddr)
+  {
+    lookup->ip = IPAddress(ip4_addr_get_u32(ip_2_ip4(ipaddr)));
+  }
+
+  // the client dropped the attempt meanwhile, nobody else frees the lookup
+  if (__atomic_exchange_n(&lookup->state, (uint32_t) (ipaddr ? WSC_DNS_FOUND : WSC_DNS_FAILED), __ATOMIC_SEQ_CST) == WSC_DNS_ABANDONED)
+  {
+    delete lookup;
+  }
+}
+#endif
+
+/**
+   start, or check on, the TCP connect
+*/
+void WebSocketsClient::connectTcp()
+{
+#if defined(WEBSOCKETS_NONBLOCKING_CONNECT)
+  if (_connectByIP)
+  {
+    if (_connectFd < 0)
+    {
+      struct sockaddr_in addr;
+
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family      = AF_INET;
+      addr.sin_addr.s_addr = (uint32_t) _connectIP;
+      addr.sin_port        = htons(_port);
+
+      _connectFd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+      if (_connectFd < 0)
       {
-        #if defined(ESP8266)      
-        // ESP32 has setInsecure() now from v1.0.6
-        _client.ssl->setInsecure();
-        #endif        
+        WSK_LOGERROR("[WS-Client] Creating socket failed!");
+
+        connectDone(false);
+        return;
       }
-      
-      if(_client_cert && _client_key) 
+
+      ::fcntl(_connectFd, F_SETFL, ::fcntl(_connectFd, F_GETFL, 0) | O_NONBLOCK);
+
+      if ((::connect(_connectFd, (struct sockaddr *) &addr, sizeof(addr)) < 0) && (errno != EINPROGRESS))
       {
-        _client.ssl->setClientRSACert(_client_cert, _client_key);
-        WSK_LOGWARN("[WS-Client] setting client certificate and key");
-      }  
-#endif    // defined(ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
+        connectDone(false);
+      }
+
+      // established, or failed, on a later call
+      return;
     }
-    else
-    {
-      WSK_LOGWARN("[WS-Client] Connect ws...");
 
-      if (_client.tcp)
+    fd_set set;
+    struct timeval tv = { 0, 0 };
+
+    FD_ZERO(&set);
+    FD_SET(_connectFd, &set);
+
+    int ready = ::select(_connectFd + 1, NULL, &set, NULL, &tv);
+
+    if (ready == 0)
+    {
+      if ((millis() - _connectStart) >= _connectTimeout)
       {
-        delete _client.tcp;
-        _client.tcp = NULL;
+        connectDone(false);
       }
 
-      _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
+      return;
     }
 
-#else   // HAS_SSL
-    #warning Not HAS_SSL
-    _client.tcp = new WEBSOCKETS_NETWORK_CLASS();
-#endif  // HAS_SSL
+    int error = 0;
+    socklen_t errorLength = sizeof(error);
 
-    if (!_client.tcp)
+    if ((ready < 0) || (::getsockopt(_connectFd, SOL_SOCKET, SO_ERROR, &error, &errorLength) < 0) || error)
     {
-      WSK_LOGERROR("[WS-Client] Creating Network class failed!");
+      connectDone(false);
       return;
     }
 
-    WEBSOCKETS_YIELD();
-       
+    // WiFiClient works on a blocking socket
+    ::fcntl(_connectFd, F_SETFL, ::fcntl(_connectFd, F_GETFL, 0) & ~O_NONBLOCK);
+
+    *_client.tcp = WEBSOCKETS_NETWORK_CLASS(_connectFd);
+    _connectFd   = -1;
+
+    connectDone(true);
+    return;
+  }
+#endif
+
+  int result;
+
+  WSK_LOGINFO3("[WS-Client] Calling _client.tcp->connect, _host =", _host, ", port =", _port);
+
 #if defined(ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
-    // KH test SSL
-    WSK_LOGINFO3("[WS-Client] Calling _client.tcp->connect, _host =", _host, ", port =", _port); 
-    
-    int _connectResult = _client.tcp->connect(_host.c_str(), _port, WEBSOCKETS_TCP_TIMEOUT);
-    
-    WSK_LOGINFO1("[WS-Client] Calling _client.tcp->connect, _connectResult =", _connectResult);
-    
-    if (_connectResult)
+  if (_connectByIP)
+  {
+    result = _client.tcp->connect(_connectIP, _port, _connectTimeout);
+  }
+  else
+  {
+    result = _client.tcp->connect(_host.c_str(), _port, _connectTimeout);
+  }
+#else
+  if (_connectByIP)
+  {
+    result = _client.tcp->connect(_connectIP, _port);
+  }
+  else
+  {
+    result = _client.tcp->connect(_host.c_str(), _port);
+  }
+#endif
+
+  WSK_LOGINFO1("[WS-Client] Calling _client.tcp->connect, result =", result);
+
+  connectDone(result);
+}
 
+/**
+   TLS connect, the TLS classes connect and handshake in one call
+*/
+void WebSocketsClient::connectTls()
+{
+  int result = 0;
+
+#if defined(HAS_SSL)
+  WSK_LOGINFO3("[WS-Client] Calling _client.ssl->connect, _host =", _host, ", port =", _port);
+
+#if defined(ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
+  result = _client.tcp->connect(_host.c_str(), _port, _connectTimeout);
 #else
-    if (_client.tcp->connect(_host.c_str(), _port))
+  result = _client.tcp->connect(_host.c_str(), _port);
 #endif
+
+  WSK_LOGINFO1("[WS-Client] Calling _client.ssl->connect, result =", result);
+#endif
+
+  connectDone(result);
+}
+
+/**
+   last step of a connection attempt, on success the HTTP upgrade follows
+   @param connected bool
+*/
+void WebSocketsClient::connectDone(bool connected)
+{
+  connectAbort();
+
+  if (connected)
+  {
+    if (_connectByIP)
     {
-      WSK_LOGDEBUG("[WS-Client] connectedCb");
-      connectedCb();
-      _lastConnectionFail = 0;
-    }
-    else
-    {
-      WSK_LOGDEBUG("[WS-Client] connectFailedCb");
-      connectFailedCb();
-      _lastConnectionFail = millis();
+      _dnsGoodIP    = _connectIP;
+      _dnsGoodValid = true;
     }
+
+    WSK_LOGDEBUG("[WS-Client] connectedCb");
+    connectedCb();
+    _lastConnectionFail = 0;
   }
   else
   {
-    //WSK_LOGDEBUG("[WS-Client] handleClientData");
-    handleClientData();
-    WEBSOCKETS_YIELD();
-
-    if (_client.status == WSC_CONNECTED)
+    if ((millis() - _connectStart) >= _connectTimeout)
     {
-      handleHBPing();
-      handleHBTimeout(&_client);
+      timeoutOccurred(&_client, WStimeout_connect);
     }
+
+    // the host may have moved, look it up again on the next attempt
+    _dnsCacheValid = false;
+
+    WSK_LOGDEBUG("[WS-Client] connectFailedCb");
+    connectFailedCb();
+    scheduleReconnect();
   }
 }
+
 #endif    // (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
 
 /**
@@ -488,6 +902,38 @@ void WebSocketsClient::onEvent(WebSocketClientEvent cbEvent)
   _cbEvent = cbEvent;
 }
 
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+/**
+   set the batch callback, the complete text and binary messages read in one loop() go to it
+   with one call instead of one onEvent() call each, the other events stay with onEvent()
+   the messages are copied to one buffer, a message that does not fit is delivered alone
+   @param cbBatchEvent WebSocketClientBatchEvent   NULL = off, the buffer is freed
+   @param bufferSize size_t      payload bytes per batch, each message takes its length + 1
+   @param maxMessages uint16_t   messages per batch
+   @return false if the buffer could not be allocated, batching stays off
+*/
+bool WebSocketsClient::onBatchEvent(WebSocketClientBatchEvent cbBatchEvent, size_t bufferSize, uint16_t maxMessages)
+{
+  batchFlush();
+
+  _cbBatchEvent = cbBatchEvent;
+
+  if (!cbBatchEvent)
+  {
+    batchRelease();
+    return true;
+  }
+
+  if (!batchEnable(bufferSize, maxMessages))
+  {
+    _cbBatchEvent = NULL;
+    return false;
+  }
+
+  return true;
+}
+#endif
+
 /**
    send text data to client
    @param num uint8_t client id
@@ -505,7 +951,7 @@ bool WebSocketsClient::sendTXT(uint8_t * payload, size_t length, bool headerToPa
 
   if (clientIsConnected(&_client))
   {
-    return sendFrame(&_client, WSop_text, payload, length, true, headerToPayload);
+    return sendMessage(&_client, WSop_text, payload, length, headerToPayload);
   }
 
   return false;
@@ -526,41 +972,141 @@ bool WebSocketsClient::sendTXT(const char * payload, size_t length)
   return sendTXT((uint8_t *)payload, length);
 }
 
-bool WebSocketsClient::sendTXT(String & payload)
+bool WebSocketsClient::sendTXT(String & payload)
+{
+  return sendTXT((uint8_t *)payload.c_str(), payload.length());
+}
+
+bool WebSocketsClient::sendTXT(char payload)
+{
+  uint8_t buf[WEBSOCKETS_MAX_HEADER_SIZE + 2] = { 0x00 };
+  buf[WEBSOCKETS_MAX_HEADER_SIZE]             = payload;
+  return sendTXT(buf, 1, true);
+}
+
+/**
+   send binary data to client
+   @param num uint8_t client id
+   @param payload uint8_t
+   @param length size_t
+   @param headerToPayload bool  (see sendFrame for more details)
+   @return true if ok
+*/
+bool WebSocketsClient::sendBIN(uint8_t * payload, size_t length, bool headerToPayload)
+{
+  if (clientIsConnected(&_client))
+  {
+    return sendMessage(&_client, WSop_binary, payload, length, headerToPayload);
+  }
+
+  return false;
+}
+
+bool WebSocketsClient::sendBIN(const uint8_t * payload, size_t length)
+{
+  return sendBIN((uint8_t *)payload, length);
+}
+
+/**
+   queue a text message as bulk data, it is sent in fragments from loop()
+   while ping / pong and sendTXT / sendBIN messages go out in between
+   @param payload const char *   copied
+   @param length size_t
+   @return false if not connected or the queue is full
+*/
+bool WebSocketsClient::queueTXT(const char * payload, size_t length)
+{
+  if (length == 0)
+  {
+    length = strlen(payload);
+  }
+
+  if (clientIsConnected(&_client))
+  {
+    return queueMessage(&_client, WSop_text, (const uint8_t *) payload, length);
+  }
+
+  return false;
+}
+
+/**
+   queue a binary message as bulk data (see queueTXT)
+   @param payload const uint8_t *   copied
+   @param length size_t
+   @return false if not connected or the queue is full
+*/
+bool WebSocketsClient::queueBIN(const uint8_t * payload, size_t length)
 {
-  return sendTXT((uint8_t *)payload.c_str(), payload.length());
+  if (clientIsConnected(&_client))
+  {
+    return queueMessage(&_client, WSop_binary, payload, length);
+  }
+
+  return false;
 }
 
-bool WebSocketsClient::sendTXT(char payload)
+/**
+   start a text message that is sent while it is written, see WebSocketsWriter
+   @param writer WebSocketsWriter &
+   @return true if ok
+*/
+bool WebSocketsClient::beginTXT(WebSocketsWriter & writer)
 {
-  uint8_t buf[WEBSOCKETS_MAX_HEADER_SIZE + 2] = { 0x00 };
-  buf[WEBSOCKETS_MAX_HEADER_SIZE]             = payload;
-  return sendTXT(buf, 1, true);
+  if (clientIsConnected(&_client))
+  {
+    return beginMessage(&_client, WSop_text, writer);
+  }
+
+  return false;
 }
 
 /**
-   send binary data to client
-   @param num uint8_t client id
-   @param payload uint8_t
-   @param length size_t
-   @param headerToPayload bool  (see sendFrame for more details)
+   start a binary message that is sent while it is written, see WebSocketsWriter
+   @param writer WebSocketsWriter &
    @return true if ok
 */
-bool WebSocketsClient::sendBIN(uint8_t * payload, size_t length, bool headerToPayload)
+bool WebSocketsClient::beginBIN(WebSocketsWriter & writer)
 {
   if (clientIsConnected(&_client))
   {
-    return sendFrame(&_client, WSop_binary, payload, length, true, headerToPayload);
+    return beginMessage(&_client, WSop_binary, writer);
   }
 
   return false;
 }
 
-bool WebSocketsClient::sendBIN(const uint8_t * payload, size_t length)
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+/**
+   forward the text and binary messages from the server to the targets of a relay while they
+   come in, they do not reach the event handler, see WebSocketsRelay. kept over reconnects
+   @param relay WebSocketsRelay *   NULL to deliver the messages to the event handler again
+*/
+void WebSocketsClient::setRelay(WebSocketsRelay * relay)
 {
-  return sendBIN((uint8_t *)payload, length);
+  relaySet(&_client, relay);
+}
+
+/**
+   make the connection to the server a target of a relay, kept over reconnects
+   @param relay WebSocketsRelay &
+   @return false if the relay has no room for another target
+*/
+bool WebSocketsClient::addRelayTarget(WebSocketsRelay & relay)
+{
+  return relayAdd(relay, &_client, true);
 }
 
+/**
+   remove the connection to the server from the targets of a relay
+   @param relay WebSocketsRelay &
+   @return false if it was no target
+*/
+bool WebSocketsClient::removeRelayTarget(WebSocketsRelay & relay)
+{
+  return relayRemove(relay, &_client);
+}
+#endif
+
 /**
    sends a WS ping to Server
    @param payload uint8_t
@@ -593,6 +1139,12 @@ bool WebSocketsClient::sendPing(String & payload)
 */
 void WebSocketsClient::disconnect()
 {
+  if (_connectState != WSC_CONNECT_IDLE)
+  {
+    clientDisconnect(&_client);
+    return;
+  }
+
   if (clientIsConnected(&_client))
   {
     WebSockets::clientDisconnect(&_client, 1000);
@@ -646,6 +1198,213 @@ void WebSocketsClient::setExtraHeaders(const char * extraHeaders)
 void WebSocketsClient::setReconnectInterval(unsigned long time)
 {
   _reconnectInterval = time;
+
+  if (!_reconnectMaxInterval)
+  {
+    _reconnectDelay = time;
+  }
+}
+
+/**
+   time a connection attempt may take, passed to connect() where the network class supports it (ESP32, RTL8720DN)
+   @param connectTimeout uint32_t   ms, WEBSOCKETS_TCP_TIMEOUT by default
+*/
+void WebSocketsClient::setConnectTimeout(uint32_t connectTimeout)
+{
+  _connectTimeout = connectTimeout;
+}
+
+/**
+   time the server may take to answer the upgrade request
+   @param handshakeTimeout uint32_t   ms, WEBSOCKETS_TCP_TIMEOUT by default
+*/
+void WebSocketsClient::setHandshakeTimeout(uint32_t handshakeTimeout)
+{
+  _handshakeTimeout = handshakeTimeout;
+}
+
+/**
+   time the server may stall in the middle of a frame (or a handshake line) before the connection is dropped
+   @param readTimeout uint32_t   ms, WEBSOCKETS_TCP_TIMEOUT by default
+*/
+void WebSocketsClient::setReadTimeout(uint32_t readTimeout)
+{
+  _readTimeout = readTimeout;
+}
+
+/**
+   time the network driver may refuse data of a frame before the connection is dropped
+   @param writeTimeout uint32_t   ms, WEBSOCKETS_TCP_TIMEOUT by default
+*/
+void WebSocketsClient::setWriteTimeout(uint32_t writeTimeout)
+{
+  _writeTimeout = writeTimeout;
+}
+
+/**
+   how long the looked up address of the host is reused for plain connections
+   @param ttl uint32_t   ms, 0 looks the host up on every connect
+*/
+void WebSocketsClient::setDnsCacheTTL(uint32_t ttl)
+{
+  _dnsCacheTTL = ttl;
+}
+
+/**
+   forget the cached and the last known-good address of the host
+*/
+void WebSocketsClient::clearDnsCache()
+{
+  _dnsCacheValid = false;
+  _dnsGoodValid  = false;
+}
+
+/**
+   enable exponential reconnect backoff with full jitter
+   the n-th retry waits random(0 .. min(maxInterval, reconnectInterval * 2^n)) ms,
+   a reconnectInterval of 0 counts as 1 ms
+   @param maxInterval unsigned long   cap of the backoff in ms, 0 => back to fixed reconnectInterval
+   @param immediateFirstRetry bool    retry once right away after a connection loss / failure
+   @param stableTime unsigned long    ms a connection has to last to reset the backoff
+*/
+void WebSocketsClient::setReconnectBackoff(unsigned long maxInterval, bool immediateFirstRetry, unsigned long stableTime)
+{
+  _reconnectMaxInterval = maxInterval;
+  _reconnectImmediate   = immediateFirstRetry;
+  _reconnectStableTime  = stableTime;
+  _reconnectAttempts    = 0;
+  _reconnectDelay       = maxInterval ? 0 : _reconnectInterval;
+}
+
+/**
+   state of the reconnect scheduler, for diagnostics
+   @return WSreconnectState_t
+*/
+WSreconnectState_t WebSocketsClient::getReconnectState()
+{
+  WSreconnectState_t state;
+
+  state.backoff       = (_reconnectMaxInterval > 0);
+  state.attempts      = _reconnectAttempts;
+  state.currentDelay  = _reconnectDelay;
+  state.nextAttemptIn = 0;
+
+  unsigned long elapsed = millis() - _lastConnectionFail;
+
+  if (!isConnected() && (elapsed < _reconnectDelay))
+  {
+    state.nextAttemptIn = _reconnectDelay - elapsed;
+  }
+
+  return state;
+}
+
+/**
+   step of the connection attempt in progress, WSC_CONNECT_IDLE while none runs
+   @return WSconnectState_t
+*/
+WSconnectState_t WebSocketsClient::getConnectState()
+{
+  return _connectState;
+}
+
+/**
+   called after a failed connection attempt or the loss of a connection,
+   picks the time to wait before the next attempt
+*/
+void WebSocketsClient::scheduleReconnect()
+{
+  _lastConnectionFail = millis();
+
+  if (!_reconnectMaxInterval)
+  {
+    _reconnectDelay = _reconnectInterval;
+    return;
+  }
+
+  uint16_t exponent = _reconnectAttempts;
+
+  if (_reconnectImmediate)
+  {
+    if (exponent == 0)
+    {
+      // fast path, a transient blip is fixed by one immediate retry
+      _reconnectDelay = 0;
+      _reconnectAttempts++;
+
+      WSK_LOGINFO("[WS-Client] immediate reconnect");
+      return;
+    }
+
+    exponent--;
+  }
+
+  // min(maxInterval, reconnectInterval * 2^exponent), without overflowing.
+  // An interval of 0 backs off from 1 ms, not to retry in a tight loop
+  unsigned long ceiling = _reconnectInterval ? _reconnectInterval : 1;
+
+  while (exponent-- && (ceiling < _reconnectMaxInterval))
+  {
+    if (ceiling > (_reconnectMaxInterval >> 1))
+    {
+      ceiling = _reconnectMaxInterval;
+      break;
+    }
+
+    ceiling <<= 1;
+  }
+
+  if (ceiling > _reconnectMaxInterval)
+  {
+    ceiling = _reconnectMaxInterval;
+  }
+
+  // the range of random(), ceiling + 1 can't wrap to 0 with maxInterval ULONG_MAX
+  if (ceiling > 0x7FFFFFFFUL)
+  {
+    ceiling = 0x7FFFFFFFUL;
+  }
+
+  // full jitter, micros() decorrelates devices seeded alike at boot
+  uint32_t rnd = ((uint32_t) random(0x7FFFFFFF)) ^ ((uint32_t) micros());
+
+  _reconnectDelay = rnd % (ceiling + 1);
+
+  if (_reconnectAttempts < 0xFFFF)
+  {
+    _reconnectAttempts++;
+  }
+
+  WSK_LOGINFO3("[WS-Client] reconnect attempt:", _reconnectAttempts, ", delay (ms):", _reconnectDelay);
+}
+
+/**
+   drop a connection attempt in progress
+*/
+void WebSocketsClient::connectAbort()
+{
+#if defined(WEBSOCKETS_NONBLOCKING_CONNECT)
+  if (_connectFd >= 0)
+  {
+    ::close(_connectFd);
+    _connectFd = -1;
+  }
+#endif
+
+#if defined(WEBSOCKETS_ASYNC_DNS)
+  // a pending lookup is left to its callback, lwIP can't cancel it
+  if (_dnsLookup)
+  {
+    if (__atomic_exchange_n(&_dnsLookup->state, (uint32_t) WSC_DNS_ABANDONED, __ATOMIC_SEQ_CST) != WSC_DNS_PENDING)
+    {
+      delete _dnsLookup;
+    }
+
+    _dnsLookup = NULL;
+  }
+#endif
+
+  _connectState = WSC_CONNECT_IDLE;
 }
 
 bool WebSocketsClient::isConnected()
@@ -669,7 +1428,15 @@ void WebSocketsClient::messageReceived(WSclient_t * client, WSopcode_t opcode,
 {
   WStype_t type = WStype_ERROR;
 
-  UNUSED(client);
+  if (!reassemble(client, &opcode, &payload, &length, &fin))
+  {
+    return;
+  }
+
+  if (batchMessage(client, opcode, payload, length, fin))
+  {
+    return;
+  }
 
   switch (opcode)
   {
@@ -696,6 +1463,37 @@ void WebSocketsClient::messageReceived(WSclient_t * client, WSopcode_t opcode,
   runCbEvent(type, payload, length);
 }
 
+/**
+   report an expired timeout to the application, the connection is closed right after
+   @param client WSclient_t *     ptr to the client struct
+   @param timeout WStimeout_t
+*/
+void WebSocketsClient::timeoutOccurred(WSclient_t * client, WStimeout_t timeout)
+{
+  UNUSED(client);
+
+  uint8_t payload = timeout;
+
+  batchFlush();
+  runCbEvent(WStype_TIMEOUT, &payload, 1);
+}
+
+/**
+   deliver the batched messages
+   @param client WSclient_t *     ptr to the client struct
+   @param messages WSmessage_t *
+   @param count size_t
+*/
+void WebSocketsClient::batchReceived(WSclient_t * client, WSmessage_t * messages, size_t count)
+{
+  UNUSED(client);
+
+  if (_cbBatchEvent)
+  {
+    _cbBatchEvent(messages, count);
+  }
+}
+
 /**
    Disconnect an client
    @param client WSclient_t *  ptr to the client struct
@@ -704,6 +1502,11 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client)
 {
   bool event = false;
 
+  connectAbort();
+
+  // corked frames, the close frame among them, go out first
+  txRelease(client);
+
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) ||   (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)    || \
     (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_WIFININA) || \
     (WEBSOCKETS_NETWORK_TYPE == NETWORK_WIFI101)
@@ -716,8 +1519,8 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client)
     }
 
     event = true;
-    delete client->ssl;
-    client->ssl = NULL;
+
+    // keep client->ssl allocated, loop() reuses it for the next connection
     client->tcp = NULL;
   }
 #endif
@@ -741,6 +1544,13 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client)
     client->tcp = NULL;
   }
 
+  extensionRelease(client);
+  relayRelease(client);
+  writerRelease(client);
+  reassemblyRelease(client);
+  bulkRelease(client);
+  rxRelease(client);
+
   client->cCode        = 0;
   client->cKey         = "";
   client->cAccept      = "";
@@ -749,10 +1559,22 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client)
   client->cIsWebsocket = false;
   client->cSessionId   = "";
 
+  if ((client->status == WSC_CONNECTED) && _reconnectMaxInterval)
+  {
+    if ((millis() - _connectedSince) >= _reconnectStableTime)
+    {
+      _reconnectAttempts = 0;
+    }
+
+    scheduleReconnect();
+  }
+
   client->status = WSC_NOT_CONNECTED;
 
   WSK_LOGDEBUG("[WS-Client] client disconnected.");
 
+  batchFlush();
+
   if (event)
   {
     runCbEvent(WStype_DISCONNECTED, NULL, 0);
@@ -803,15 +1625,16 @@ bool WebSocketsClient::clientIsConnected(WSclient_t * client)
 */
 void WebSocketsClient::handleClientData()
 {
-  if ((_client.status == WSC_HEADER || _client.status == WSC_BODY) && _lastHeaderSent + WEBSOCKETS_TCP_TIMEOUT < millis())
+  if ((_client.status == WSC_HEADER || _client.status == WSC_BODY) && ((millis() - _lastHeaderSent) > _handshakeTimeout))
   {
     WSK_LOGINFO("[WS-Client][handleClientData] Header response timeout.. Disconnecting!");
+    timeoutOccurred(&_client, WStimeout_handshake);
     clientDisconnect(&_client);
     WEBSOCKETS_YIELD();
     return;
   }
 
-  int len = _client.tcp->available();
+  int len = rxAvailable(&_client);
 
   if (len > 0)
   {
@@ -834,7 +1657,7 @@ void WebSocketsClient::handleClientData()
         
         break;  
       case WSC_CONNECTED:
-        WebSockets::handleWebsocket(&_client);
+        WebSockets::handleWebsocketBatch(&_client);
         
         break;
       default:
@@ -910,11 +1733,16 @@ void WebSocketsClient::sendHeader(WSclient_t * client)
       handshake += client->cProtocol + NEW_LINE;
     }
 
-    if (client->cExtensions.length() > 0)
+    String extensions = extensionOffer();
+
+    if (extensions.length() > 0)
     {
       handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
-      handshake += client->cExtensions + NEW_LINE;
+      handshake += extensions + NEW_LINE;
     }
+
+    // filled from the response
+    client->cExtensions = "";
   }
   else
   {
@@ -1107,7 +1935,7 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine)
         WSK_LOGINFO1("[WS-Client][handleHeader] serverCode is not 101 :", client->cCode);
 
         clientDisconnect(client);
-        _lastConnectionFail = millis();
+        scheduleReconnect();
       }  
     }
 
@@ -1131,10 +1959,19 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine)
       }
     }
 
+    if (ok && !extensionConfirm(client))
+    {
+      WSK_LOGINFO("[WS-Client][handleHeader] Sec-WebSocket-Extensions not acceptable");
+
+      ok = false;
+    }
+
     if (ok)
     {
       WSK_LOGINFO("[WS-Client][handleHeader] Websocket connection init done.");
 
+      _connectedSince = millis();
+
       headerDone(client);
 
       runCbEvent(WStype_CONNECTED, (uint8_t *)client->cUrl.c_str(), client->cUrl.length());
@@ -1165,7 +2002,7 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine)
     {
       WSK_LOGDEBUG("[WS-Client][handleHeader] no Websocket connection close.");
 
-      _lastConnectionFail = millis();
+      scheduleReconnect();
 
       if (clientIsConnected(client))
       {
@@ -1200,7 +2037,7 @@ void WebSocketsClient::connectedCb()
 
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
   // set Timeout for readBytesUntil and readStringUntil
-  _client.tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
+  _client.tcp->setTimeout(_readTimeout);
 #endif
 
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || \
@@ -1326,6 +2163,116 @@ void WebSocketsClient::handleHBPing()
   }
 }
 
+/**
+   set how the library waits for the connection while it reads or writes a frame
+   the transport blocks until the socket is ready (FreeRTOS notification, lwIP / poll() on a socket, ...),
+   on ESP32 lwIP select() is the default, elsewhere and with NULL the library polls
+   @param waitCb WSwaitCb   returns false for connections it can't wait for
+*/
+void WebSocketsClient::setWaitStrategy(WSwaitCb waitCb)
+{
+  _waitCb = waitCb;
+}
+
+/**
+   cork mode: frames are gathered in a buffer of one TCP segment (WEBSOCKETS_TX_BUFFER_SIZE)
+   and written at the end of loop(), by flush() or when the buffer is full,
+   many small messages then share a packet instead of taking two writes each
+*/
+void WebSocketsClient::enableCork()
+{
+  _cork = true;
+}
+
+void WebSocketsClient::disableCork()
+{
+  flush();
+  _cork = false;
+}
+
+/**
+   write the corked frames now
+*/
+void WebSocketsClient::flush()
+{
+  if (_client.cTxLength && clientIsConnected(&_client))
+  {
+    txFlush(&_client);
+  }
+}
+
+/**
+   offer permessage-deflate (RFC 7692) on the next connection
+   @param windowBits uint8_t          9..15, LZ77 window, RAM per direction grows with 2^windowBits
+   @param memLevel uint8_t            1..9, encoder hash table of 2^(memLevel + 6) entries
+   @param noContextTakeover bool      every message is compressed on its own, nothing is kept between messages
+   @param minSize size_t              messages shorter than this are sent uncompressed
+*/
+void WebSocketsClient::enableCompression(uint8_t windowBits, uint8_t memLevel, bool noContextTakeover, size_t minSize)
+{
+  _deflate.configure(windowBits, memLevel, noContextTakeover, minSize);
+  addExtension(&_deflate);
+}
+
+/**
+   offer permessage-deflate for received messages only, for clients short on RAM
+   nothing is ever compressed, compressed messages are inflated while they are read through
+   a single window of 2^windowBits bytes, bigger messages arrive as WStype_FRAGMENT_* events
+   @param windowBits uint8_t          9..15, largest window the server may use
+   @param noContextTakeover bool      ask the server to compress every message on its own, the window is freed in between
+*/
+void WebSocketsClient::enableDecompression(uint8_t windowBits, bool noContextTakeover)
+{
+  _deflate.configure(windowBits, WEBSOCKETS_DEFLATE_MIN_MEM_LEVEL, noContextTakeover, 0, true);
+  addExtension(&_deflate);
+}
+
+void WebSocketsClient::disableCompression()
+{
+  removeExtension(&_deflate);
+}
+
+/**
+   negotiate an extension (RFC 6455 9) with the next connections from now on, in the order they were added
+   the extension object has to live as long as this instance
+   @param extension WebSocketsExtension *
+   @return false if there is no room left (WEBSOCKETS_MAX_EXTENSIONS) or one of its RSV bits is taken
+*/
+bool WebSocketsClient::addExtension(WebSocketsExtension * extension)
+{
+  return WebSockets::addExtension(extension);
+}
+
+void WebSocketsClient::removeExtension(WebSocketsExtension * extension)
+{
+  WebSockets::removeExtension(extension);
+}
+
+/**
+   send bigger text and binary messages as a sequence of fragments (RFC 6455 5.4),
+   pings can go out between them and the peer never has to buffer more than one frame
+   @param maxFrameSize size_t   payload bytes per frame, 0 = every message in one frame
+*/
+void WebSocketsClient::setMaxFrameSize(size_t maxFrameSize)
+{
+  _maxFrameSize = maxFrameSize;
+}
+
+/**
+   deliver fragmented messages as one WStype_TEXT / WStype_BIN event instead of WStype_FRAGMENT_* events
+   every connection that receives a fragmented message reserves maxMessageSize + 1 bytes for it
+   @param maxMessageSize size_t   bigger messages fail the connection with 1009
+*/
+void WebSocketsClient::enableReassembly(size_t maxMessageSize)
+{
+  _reassemblySize = maxMessageSize;
+}
+
+void WebSocketsClient::disableReassembly()
+{
+  _reassemblySize = 0;
+}
+
 /**
    enable ping/pong heartbeat process
    @param pingInterval uint32_t how often ping will be sent
@@ -59,6 +59,64 @@
 
 #include "WebSockets_Generic.h"
 
+typedef struct
+{
+  bool backoff;                  ///< exponential backoff enabled, else fixed reconnectInterval
+  uint16_t attempts;             ///< consecutive failed attempts since the last stable connection
+  unsigned long currentDelay;    ///< ms waited after the last failure
+  unsigned long nextAttemptIn;   ///< ms left until the next attempt, 0 if due or connected
+} WSreconnectState_t;
+
+// step of a connection attempt, loop() advances one step per call,
+// the HTTP upgrade that follows is _client.status == WSC_HEADER
+typedef enum
+{
+  WSC_CONNECT_IDLE,         ///< no attempt running
+  WSC_CONNECT_RESOLVING,    ///< looking up the host name
+  WSC_CONNECT_TCP,          ///< TCP connect, non-blocking where the network class allows it
+  WSC_CONNECT_TLS           ///< TLS client connect and handshake
+} WSconnectState_t;
+
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266)  || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)     || \
+    (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_WIFININA) || \
+    (WEBSOCKETS_NETWORK_TYPE == NETWORK_WIFI101)   || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
+  // the lookup runs in its own loop() step, a single blocking WiFi.hostByName() call
+  // except on ESP32, see WEBSOCKETS_ASYNC_DNS
+  #define WEBSOCKETS_HAS_HOSTBYNAME
+#endif
+
+// ms a looked up host address is reused before it is resolved again
+#ifndef WEBSOCKETS_DNS_CACHE_TTL
+  #define WEBSOCKETS_DNS_CACHE_TTL      (300000)
+#endif
+
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH)
+  // non-blocking lwIP connect, the socket is handed to WiFiClient once established
+  #define WEBSOCKETS_NONBLOCKING_CONNECT
+
+  // lwIP dns_gethostbyname() answers in a callback, WSC_CONNECT_RESOLVING polls for it
+  #define WEBSOCKETS_ASYNC_DNS
+#endif
+
+#if defined(WEBSOCKETS_ASYNC_DNS)
+// state of an lwIP host lookup
+typedef enum
+{
+  WSC_DNS_PENDING,          ///< waiting on the lwIP callback
+  WSC_DNS_FOUND,            ///< ip is set
+  WSC_DNS_FAILED,           ///< no address for the name
+  WSC_DNS_ABANDONED         ///< the client gave up on it, the callback frees it
+} WSdnsState_t;
+
+// an lwIP host lookup, shared by the client and the lwIP callback,
+// whichever of them is done with it last frees it
+typedef struct
+{
+  uint32_t state;           ///< WSdnsState_t, changed with __atomic builtins only
+  IPAddress ip;
+} WSdnsLookup_t;
+#endif
+
 class WebSocketsClient : protected WebSockets
 {
   public:
@@ -68,6 +126,12 @@ class WebSocketsClient : protected WebSockets
     typedef std::function<void(WStype_t type, uint8_t * payload, size_t length)> WebSocketClientEvent;
 #endif
 
+#ifdef __AVR__
+    typedef void (*WebSocketClientBatchEvent)(WSmessage_t * messages, size_t count);
+#else
+    typedef std::function<void(WSmessage_t * messages, size_t count)> WebSocketClientBatchEvent;
+#endif
+
     WebSocketsClient();
     virtual ~WebSocketsClient();
 
@@ -142,6 +206,11 @@ class WebSocketsClient : protected WebSockets
 
     void onEvent(WebSocketClientEvent cbEvent);
 
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    bool onBatchEvent(WebSocketClientBatchEvent cbBatchEvent, size_t bufferSize = WEBSOCKETS_BATCH_BUFFER_SIZE,
+                      uint16_t maxMessages = WEBSOCKETS_BATCH_MAX_MESSAGES);
+#endif
+
     bool sendTXT(uint8_t * payload, size_t length = 0, bool headerToPayload = false);
     bool sendTXT(const uint8_t * payload, size_t length = 0);
     bool sendTXT(char * payload, size_t length = 0, bool headerToPayload = false);
@@ -152,6 +221,18 @@ class WebSocketsClient : protected WebSockets
     bool sendBIN(uint8_t * payload, size_t length, bool headerToPayload = false);
     bool sendBIN(const uint8_t * payload, size_t length);
 
+    bool queueTXT(const char * payload, size_t length = 0);
+    bool queueBIN(const uint8_t * payload, size_t length);
+
+    bool beginTXT(WebSocketsWriter & writer);
+    bool beginBIN(WebSocketsWriter & writer);
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    void setRelay(WebSocketsRelay * relay);
+    bool addRelayTarget(WebSocketsRelay & relay);
+    bool removeRelayTarget(WebSocketsRelay & relay);
+#endif
+
     bool sendPing(uint8_t * payload = NULL, size_t length = 0);
     bool sendPing(String & payload);
 
@@ -163,10 +244,37 @@ class WebSocketsClient : protected WebSockets
     void setExtraHeaders(const char * extraHeaders = NULL);
 
     void setReconnectInterval(unsigned long time);
+    void setConnectTimeout(uint32_t connectTimeout);
+    void setHandshakeTimeout(uint32_t handshakeTimeout);
+    void setReadTimeout(uint32_t readTimeout);
+    void setWriteTimeout(uint32_t writeTimeout);
+    void setDnsCacheTTL(uint32_t ttl);
+    void clearDnsCache();
+    void setReconnectBackoff(unsigned long maxInterval, bool immediateFirstRetry = true, unsigned long stableTime = 10000);
+    WSreconnectState_t getReconnectState();
+    WSconnectState_t getConnectState();
 
     void enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
+
+    void setWaitStrategy(WSwaitCb waitCb);
+
+    void enableCork();
+    void disableCork();
+    void flush();
+
+    void enableCompression(uint8_t windowBits = 10, uint8_t memLevel = 2, bool noContextTakeover = true, size_t minSize = 64);
+    void enableDecompression(uint8_t windowBits = 10, bool noContextTakeover = true);
+    void disableCompression();
     void disableHeartbeat();
 
+    bool addExtension(WebSocketsExtension * extension);
+    void removeExtension(WebSocketsExtension * extension);
+
+    void setMaxFrameSize(size_t maxFrameSize);
+
+    void enableReassembly(size_t maxMessageSize = WEBSOCKETS_MAX_DATA_SIZE);
+    void disableReassembly();
+
     bool isConnected();
 
   protected:
@@ -186,6 +294,9 @@ class WebSocketsClient : protected WebSockets
     BearSSL::X509List * _CA_cert;
     BearSSL::X509List * _client_cert;
     BearSSL::PrivateKey * _client_key;
+
+    // TLS session of the last successful handshake, offered for resumption on reconnect
+    BearSSL::Session _sslSession;
     
     #define SSL_FINGERPRINT_IS_SET      (_fingerprint != NULL)    
     #define SSL_FINGERPRINT_NULL        NULL
@@ -196,12 +307,68 @@ class WebSocketsClient : protected WebSockets
     WSclient_t _client;
 
     WebSocketClientEvent _cbEvent;
+    WebSocketClientBatchEvent _cbBatchEvent;
 
     unsigned long _lastConnectionFail;
     unsigned long _reconnectInterval;
     unsigned long _lastHeaderSent;
 
+    uint32_t _connectTimeout;
+    uint32_t _handshakeTimeout;
+
+    // reconnect backoff, disabled while _reconnectMaxInterval == 0
+    unsigned long _reconnectMaxInterval;
+    unsigned long _reconnectStableTime;
+    unsigned long _reconnectDelay;
+    unsigned long _connectedSince;
+    uint16_t _reconnectAttempts;
+    bool _reconnectImmediate;
+
+    void scheduleReconnect();
+
+    // connect state machine
+    WSconnectState_t _connectState;
+    unsigned long _connectStart;
+    IPAddress _connectIP;
+    bool _connectByIP;
+
+#if defined(WEBSOCKETS_NONBLOCKING_CONNECT)
+    int _connectFd;
+#endif
+
+#if defined(WEBSOCKETS_ASYNC_DNS)
+    WSdnsLookup_t * _dnsLookup;
+#endif
+
+    // host lookup cache, plain connections reuse the address until the TTL runs out
+    uint32_t _dnsCacheTTL;
+    unsigned long _dnsCacheTime;
+    IPAddress _dnsCacheIP;
+    bool _dnsCacheValid;
+
+    // address of the last successful connect, used while the lookup fails
+    IPAddress _dnsGoodIP;
+    bool _dnsGoodValid;
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    bool connectPrepare();
+    void connectResolve();
+#if defined(WEBSOCKETS_HAS_HOSTBYNAME)
+    void connectResolved(bool found);
+#endif
+#if defined(WEBSOCKETS_ASYNC_DNS)
+    static void dnsFoundCb(const char * name, const ip_addr_t * ipaddr, void * arg);
+#endif
+    void connectTcp();
+    void connectTls();
+    void connectDone(bool connected);
+#endif
+
+    void connectAbort();
+
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
+    void timeoutOccurred(WSclient_t * client, WStimeout_t timeout);
+    void batchReceived(WSclient_t * client, WSmessage_t * messages, size_t count);
 
     void clientDisconnect(WSclient_t * client);
     bool clientIsConnected(WSclient_t * client);
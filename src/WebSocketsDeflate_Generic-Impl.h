@@ -0,0 +1,1479 @@
+/****************************************************************************************************************************
+  WebSocketsDeflate_Generic-Impl.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  The decoder follows the canonical Huffman decoding of Mark Adler's puff.c (zlib contrib),
+  reworked into a resumable state machine with a circular output window.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_DEFLATE_GENERIC_IMPL_H_
+#define WEBSOCKETS_DEFLATE_GENERIC_IMPL_H_
+
+// RFC 1951 3.2.5, length codes 257..285 and distance codes 0..29
+static const uint16_t WS_deflateLenBase[29] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t WS_deflateLenExtra[29] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t WS_deflateDistBase[30] =
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+  1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t WS_deflateDistExtra[30] =
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// RFC 1951 3.2.7, order of the code length code lengths
+static const uint8_t WS_deflateCodeLenOrder[19] =
+{
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/**
+   @param windowBits uint8_t   largest window the peer may use, 2^windowBits bytes are allocated on first use
+*/
+WebSocketsInflate::WebSocketsInflate(uint8_t windowBits)
+{
+  if (windowBits < WEBSOCKETS_DEFLATE_MIN_WINDOW_BITS)
+  {
+    windowBits = WEBSOCKETS_DEFLATE_MIN_WINDOW_BITS;
+  }
+  else if (windowBits > WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS)
+  {
+    windowBits = WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS;
+  }
+
+  _window     = NULL;
+  _windowSize = (1 << windowBits);
+
+  _lenCode.symbol  = _lenSymbol;
+  _distCode.symbol = _distSymbol;
+
+  release();
+}
+
+WebSocketsInflate::~WebSocketsInflate()
+{
+  if (_window)
+  {
+    free(_window);
+  }
+}
+
+void WebSocketsInflate::reset()
+{
+  _state     = WSinflate_header;
+  _bitBuf    = 0;
+  _bitCnt    = 0;
+  _final     = false;
+  _remaining = 0;
+  _flushPos  = _windowPos;
+}
+
+void WebSocketsInflate::release()
+{
+  if (_window)
+  {
+    free(_window);
+    _window = NULL;
+  }
+
+  _windowPos  = 0;
+  _windowFull = false;
+
+  reset();
+}
+
+/**
+   make sure that at least n bits are in the bit buffer
+   @param bits uint8_t   max 32
+   @return false if the input ran out, the bits read so far are kept
+*/
+bool WebSocketsInflate::need(uint8_t bits)
+{
+  while (_bitCnt < bits)
+  {
+    if (_inLen == 0)
+    {
+      return false;
+    }
+
+    _bitBuf |= ((uint32_t) * _in) << _bitCnt;
+    _in++;
+    _inLen--;
+    _bitCnt += 8;
+  }
+
+  return true;
+}
+
+/**
+   take n bits out of the bit buffer, need() has to be called before
+   @param bits uint8_t   max 16
+*/
+uint16_t WebSocketsInflate::bits(uint8_t bits)
+{
+  uint16_t value = (_bitBuf & ((1UL << bits) - 1));
+
+  _bitBuf >>= bits;
+  _bitCnt -= bits;
+
+  return value;
+}
+
+/**
+   decode one symbol, the bits are only looked at, the caller consumes codeLen bits
+   @return symbol, -1 more input needed, -2 invalid code
+*/
+int WebSocketsInflate::decode(WSHuffman_t * h, uint8_t * codeLen)
+{
+  int code  = 0;    ///< len bits being decoded
+  int first = 0;    ///< first code of length len
+  int index = 0;    ///< index of first code of length len in symbol table
+
+  for (uint8_t len = 1; len < 16; len++)
+  {
+    if (!need(len))
+    {
+      return -1;
+    }
+
+    code |= ((_bitBuf >> (len - 1)) & 1);
+
+    int count = h->count[len];
+
+    if (code - count < first)
+    {
+      *codeLen = len;
+      return h->symbol[index + (code - first)];
+    }
+
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+
+  return -2;
+}
+
+/**
+   build the canonical Huffman table from the code lengths
+   @return false if the code lengths are over-subscribed
+*/
+bool WebSocketsInflate::construct(WSHuffman_t * h, const uint8_t * length, uint16_t n)
+{
+  uint16_t offs[16];
+
+  memset(h->count, 0, sizeof(h->count));
+
+  for (uint16_t symbol = 0; symbol < n; symbol++)
+  {
+    h->count[length[symbol]]++;
+  }
+
+  if (h->count[0] == n)
+  {
+    // no codes, fine as long as nothing gets decoded with it
+    return true;
+  }
+
+  int left = 1;
+
+  for (uint8_t len = 1; len < 16; len++)
+  {
+    left <<= 1;
+    left -= h->count[len];
+
+    if (left < 0)
+    {
+      return false;
+    }
+  }
+
+  offs[1] = 0;
+
+  for (uint8_t len = 1; len < 15; len++)
+  {
+    offs[len + 1] = offs[len] + h->count[len];
+  }
+
+  for (uint16_t symbol = 0; symbol < n; symbol++)
+  {
+    if (length[symbol] != 0)
+    {
+      h->symbol[offs[length[symbol]]++] = symbol;
+    }
+  }
+
+  return true;
+}
+
+/**
+   hand out the data decoded since the last flush, zero terminated like any other payload
+   @param cb WSinflateOutputCb   must not modify the data, later matches may still refer to it
+   @return false if the callback refused the data
+*/
+bool WebSocketsInflate::flush(const WSinflateOutputCb & cb)
+{
+  if (_window && (_windowPos > _flushPos))
+  {
+    uint16_t start = _flushPos;
+    uint8_t saved  = _window[_windowPos];
+    bool ok;
+
+    _flushPos = _windowPos;
+
+    // the byte behind the data is the oldest of the window (or the spare one at its end)
+    _window[_windowPos] = 0x00;
+    ok = cb(&_window[start], _windowPos - start);
+    _window[_windowPos] = saved;
+
+    return ok;
+  }
+
+  return true;
+}
+
+bool WebSocketsInflate::put(uint8_t c, const WSinflateOutputCb & cb)
+{
+  _window[_windowPos++] = c;
+
+  if (_windowPos == _windowSize)
+  {
+    // hand out the window before it wraps
+    if (!flush(cb))
+    {
+      return false;
+    }
+
+    _windowPos  = 0;
+    _flushPos   = 0;
+    _windowFull = true;
+  }
+
+  return true;
+}
+
+/**
+   decode the next piece of the stream
+   @param in const uint8_t *     compressed data
+   @param length size_t
+   @param cb WSinflateOutputCb   receives every full window, return false to stop
+   @return WSinflateResult_t     the rest of the output stays in the window until flush()
+*/
+WSinflateResult_t WebSocketsInflate::inflate(const uint8_t * in, size_t length, WSinflateOutputCb cb)
+{
+  if (!_window)
+  {
+    // one spare byte to zero terminate a full window
+    _window = (uint8_t *) malloc(_windowSize + 1);
+
+    if (!_window)
+    {
+      return WSinflate_noMemory;
+    }
+  }
+
+  _in    = in;
+  _inLen = length;
+
+  int symbol;
+  uint8_t codeLen;
+
+  while (true)
+  {
+    switch (_state)
+    {
+      case WSinflate_header:
+        if (!need(3))
+        {
+          return WSinflate_ok;
+        }
+
+        _final = bits(1);
+
+        switch (bits(2))
+        {
+          case 0:
+            // stored block, skip to the byte boundary
+            bits(_bitCnt & 7);
+            _state = WSinflate_storedLen;
+            break;
+
+          case 1:
+            for (symbol = 0; symbol < 144; symbol++)
+              _lengths[symbol] = 8;
+
+            for (; symbol < 256; symbol++)
+              _lengths[symbol] = 9;
+
+            for (; symbol < 280; symbol++)
+              _lengths[symbol] = 7;
+
+            for (; symbol < 288; symbol++)
+              _lengths[symbol] = 8;
+
+            construct(&_lenCode, _lengths, 288);
+
+            for (symbol = 0; symbol < 30; symbol++)
+              _lengths[symbol] = 5;
+
+            construct(&_distCode, _lengths, 30);
+
+            _state = WSinflate_lenSym;
+            break;
+
+          case 2:
+            _state = WSinflate_tableHeader;
+            break;
+
+          default:
+            return WSinflate_error;
+        }
+
+        break;
+
+      case WSinflate_storedLen:
+        if (!need(32))
+        {
+          return WSinflate_ok;
+        }
+
+        _remaining = bits(16);
+
+        if (bits(16) != (uint16_t) ~_remaining)
+        {
+          return WSinflate_error;
+        }
+
+        _state = WSinflate_stored;
+        break;
+
+      case WSinflate_stored:
+        while (_remaining)
+        {
+          if (!need(8))
+          {
+            return WSinflate_ok;
+          }
+
+          if (!put(bits(8), cb))
+          {
+            return WSinflate_aborted;
+          }
+
+          _remaining--;
+        }
+
+        _state = _final ? WSinflate_done : WSinflate_header;
+        break;
+
+      case WSinflate_tableHeader:
+        if (!need(14))
+        {
+          return WSinflate_ok;
+        }
+
+        _nlen  = bits(5) + 257;
+        _ndist = bits(5) + 1;
+        _ncode = bits(4) + 4;
+
+        if ((_nlen > 286) || (_ndist > 30))
+        {
+          return WSinflate_error;
+        }
+
+        _index = 0;
+        _state = WSinflate_tableCodeLens;
+        break;
+
+      case WSinflate_tableCodeLens:
+        while (_index < _ncode)
+        {
+          if (!need(3))
+          {
+            return WSinflate_ok;
+          }
+
+          _lengths[WS_deflateCodeLenOrder[_index++]] = bits(3);
+        }
+
+        for (; _index < 19; _index++)
+        {
+          _lengths[WS_deflateCodeLenOrder[_index]] = 0;
+        }
+
+        if (!construct(&_lenCode, _lengths, 19))
+        {
+          return WSinflate_error;
+        }
+
+        _index = 0;
+        _state = WSinflate_tableLens;
+        break;
+
+      case WSinflate_tableLens:
+        while (_index < (_nlen + _ndist))
+        {
+          symbol = decode(&_lenCode, &codeLen);
+
+          if (symbol == -1)
+          {
+            return WSinflate_ok;
+          }
+          else if (symbol < 0)
+          {
+            return WSinflate_error;
+          }
+
+          if (symbol < 16)
+          {
+            bits(codeLen);
+            _lengths[_index++] = symbol;
+            continue;
+          }
+
+          // repeat code, take it only together with its extra bits
+          uint8_t extra = (symbol == 16) ? 2 : ((symbol == 17) ? 3 : 7);
+
+          if (!need(codeLen + extra))
+          {
+            return WSinflate_ok;
+          }
+
+          bits(codeLen);
+
+          uint8_t value = 0;
+          uint16_t repeat;
+
+          if (symbol == 16)
+          {
+            if (_index == 0)
+            {
+              return WSinflate_error;
+            }
+
+            value  = _lengths[_index - 1];
+            repeat = 3 + bits(2);
+          }
+          else if (symbol == 17)
+          {
+            repeat = 3 + bits(3);
+          }
+          else
+          {
+            repeat = 11 + bits(7);
+          }
+
+          if ((_index + repeat) > (_nlen + _ndist))
+          {
+            return WSinflate_error;
+          }
+
+          while (repeat--)
+          {
+            _lengths[_index++] = value;
+          }
+        }
+
+        // a block without end of block code can not be decoded
+        if ((_lengths[256] == 0) || !construct(&_lenCode, _lengths, _nlen) || !construct(&_distCode, &_lengths[_nlen], _ndist))
+        {
+          return WSinflate_error;
+        }
+
+        _state = WSinflate_lenSym;
+        break;
+
+      case WSinflate_lenSym:
+        symbol = decode(&_lenCode, &codeLen);
+
+        if (symbol == -1)
+        {
+          return WSinflate_ok;
+        }
+        else if (symbol < 0)
+        {
+          return WSinflate_error;
+        }
+
+        bits(codeLen);
+
+        if (symbol < 256)
+        {
+          if (!put(symbol, cb))
+          {
+            return WSinflate_aborted;
+          }
+        }
+        else if (symbol == 256)
+        {
+          _state = _final ? WSinflate_done : WSinflate_header;
+        }
+        else
+        {
+          symbol -= 257;
+
+          if (symbol >= 29)
+          {
+            return WSinflate_error;
+          }
+
+          _sym   = symbol;
+          _state = WSinflate_lenExtra;
+        }
+
+        break;
+
+      case WSinflate_lenExtra:
+        if (!need(WS_deflateLenExtra[_sym]))
+        {
+          return WSinflate_ok;
+        }
+
+        _remaining = WS_deflateLenBase[_sym] + bits(WS_deflateLenExtra[_sym]);
+        _state     = WSinflate_distSym;
+        break;
+
+      case WSinflate_distSym:
+        symbol = decode(&_distCode, &codeLen);
+
+        if (symbol == -1)
+        {
+          return WSinflate_ok;
+        }
+        else if ((symbol < 0) || (symbol >= 30))
+        {
+          return WSinflate_error;
+        }
+
+        bits(codeLen);
+
+        _sym   = symbol;
+        _state = WSinflate_distExtra;
+        break;
+
+      case WSinflate_distExtra:
+        if (!need(WS_deflateDistExtra[_sym]))
+        {
+          return WSinflate_ok;
+        }
+
+        _dist = WS_deflateDistBase[_sym] + bits(WS_deflateDistExtra[_sym]);
+
+        // distance further back than the window (or than what has been decoded so far)
+        if (_dist > (_windowFull ? _windowSize : _windowPos))
+        {
+          return WSinflate_error;
+        }
+
+        _state = WSinflate_copy;
+        break;
+
+      case WSinflate_copy:
+        while (_remaining)
+        {
+          if (!put(_window[(uint16_t)(_windowPos + _windowSize - _dist) & (_windowSize - 1)], cb))
+          {
+            return WSinflate_aborted;
+          }
+
+          _remaining--;
+        }
+
+        _state = WSinflate_lenSym;
+        break;
+
+      case WSinflate_done:
+      default:
+        // anything after the final block is ignored
+        _inLen = 0;
+
+        return WSinflate_end;
+    }
+  }
+}
+
+/**
+   @param windowBits uint8_t         LZ77 window of the encoder, at most what the peer allows
+   @param memLevel uint8_t           hash table of 2^(memLevel + 6) entries, more = better and slower
+   @param noContextTakeover bool     every message is compressed on its own
+*/
+WebSocketsDeflate::WebSocketsDeflate(uint8_t windowBits, uint8_t memLevel, bool noContextTakeover)
+{
+  // the encoder may use any window up to the negotiated one, 8 bits included
+  if (windowBits < 8)
+  {
+    windowBits = 8;
+  }
+  else if (windowBits > WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS)
+  {
+    windowBits = WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS;
+  }
+
+  if (memLevel < WEBSOCKETS_DEFLATE_MIN_MEM_LEVEL)
+  {
+    memLevel = WEBSOCKETS_DEFLATE_MIN_MEM_LEVEL;
+  }
+  else if (memLevel > WEBSOCKETS_DEFLATE_MAX_MEM_LEVEL)
+  {
+    memLevel = WEBSOCKETS_DEFLATE_MAX_MEM_LEVEL;
+  }
+
+  _windowBits        = windowBits;
+  _hashBits          = memLevel + 6;
+  _noContextTakeover = noContextTakeover;
+
+  _history    = NULL;
+  _historyLen = 0;
+}
+
+WebSocketsDeflate::~WebSocketsDeflate()
+{
+  reset();
+}
+
+void WebSocketsDeflate::reset()
+{
+  if (_history)
+  {
+    free(_history);
+    _history = NULL;
+  }
+
+  _historyLen = 0;
+}
+
+void WebSocketsDeflate::putBits(uint32_t value, uint8_t bits)
+{
+  _bitBuf |= (value << _bitCnt);
+  _bitCnt += bits;
+
+  while (_bitCnt >= 8)
+  {
+    // keep counting past the end, the caller gives up if it does not fit
+    if (_outPos <= _outMax)
+    {
+      _out[_outPos] = (_bitBuf & 0xFF);
+    }
+
+    _outPos++;
+    _bitBuf >>= 8;
+    _bitCnt -= 8;
+  }
+}
+
+/**
+   Huffman codes are packed starting with the most significant bit
+*/
+void WebSocketsDeflate::putCode(uint16_t code, uint8_t bits)
+{
+  uint16_t reversed = 0;
+
+  for (uint8_t i = 0; i < bits; i++)
+  {
+    reversed = (reversed << 1) | ((code >> i) & 1);
+  }
+
+  putBits(reversed, bits);
+}
+
+/**
+   literal / length symbol of the fixed Huffman code (RFC 1951 3.2.6)
+*/
+void WebSocketsDeflate::putLiteral(uint16_t sym)
+{
+  if (sym < 144)
+  {
+    putCode(0x30 + sym, 8);
+  }
+  else if (sym < 256)
+  {
+    putCode(0x190 + (sym - 144), 9);
+  }
+  else if (sym < 280)
+  {
+    putCode(sym - 256, 7);
+  }
+  else
+  {
+    putCode(0xC0 + (sym - 280), 8);
+  }
+}
+
+void WebSocketsDeflate::putMatch(uint16_t length, uint16_t dist)
+{
+  uint8_t code = 28;
+
+  while (WS_deflateLenBase[code] > length)
+  {
+    code--;
+  }
+
+  putLiteral(257 + code);
+  putBits(length - WS_deflateLenBase[code], WS_deflateLenExtra[code]);
+
+  code = 29;
+
+  while (WS_deflateDistBase[code] > dist)
+  {
+    code--;
+  }
+
+  putCode(code, 5);
+  putBits(dist - WS_deflateDistBase[code], WS_deflateDistExtra[code]);
+}
+
+/**
+   compress one message
+   @param in const uint8_t *    message
+   @param length size_t
+   @param headroom size_t       bytes left free in front of the output (for the frame header)
+   @param outLength size_t *    length of the compressed data, without the headroom
+   @return malloc'ed buffer (caller frees), NULL if out of memory or if compression would not save anything
+*/
+uint8_t * WebSocketsDeflate::compress(const uint8_t * in, size_t length, size_t headroom, size_t * outLength)
+{
+  const uint16_t windowSize = (1UL << _windowBits);
+  const uint16_t windowMask = windowSize - 1;
+  const uint16_t historyLen = _noContextTakeover ? 0 : _historyLen;
+  const size_t total        = historyLen + length;
+
+  // positions are kept in 16 bit
+  if ((length == 0) || (total > 0xFFFE))
+  {
+    return NULL;
+  }
+
+  const uint8_t * data = in;
+  uint8_t * work       = NULL;
+
+  if (historyLen)
+  {
+    // the previous messages are part of the window, matches may reach back into them
+    work = (uint8_t *) malloc(total);
+
+    if (!work)
+    {
+      return NULL;
+    }
+
+    memcpy(work, _history, historyLen);
+    memcpy(&work[historyLen], in, length);
+    data = work;
+  }
+
+  uint16_t * head = (uint16_t *) calloc((1UL << _hashBits), sizeof(uint16_t));
+  uint16_t * prev = (uint16_t *) malloc(windowSize * sizeof(uint16_t));
+
+  _out    = (uint8_t *) malloc(headroom + length);
+  _outPos = headroom;
+  _outMax = headroom + length - 1;
+  _bitBuf = 0;
+  _bitCnt = 0;
+
+  if (!head || !prev || !_out)
+  {
+    free(head);
+    free(prev);
+    free(_out);
+    free(work);
+
+    return NULL;
+  }
+
+  const uint8_t shift    = 32 - _hashBits;
+  const uint8_t maxChain = (1 << ((_hashBits - 6) / 2 + 2));
+
+#define WS_DEFLATE_HASH(p)  ((uint16_t)((uint32_t)(((uint32_t) (p)[0] | ((uint32_t) (p)[1] << 8) | ((uint32_t) (p)[2] << 16)) * 2654435761UL) >> shift))
+#define WS_DEFLATE_INSERT(pos) \
+  { \
+    uint16_t h = WS_DEFLATE_HASH(&data[pos]); \
+    prev[(pos) & windowMask] = head[h]; \
+    head[h] = (pos) + 1; \
+  }
+
+  // BFINAL = 0, BTYPE = 01 fixed Huffman
+  putBits(0x02, 3);
+
+  uint16_t pos;
+
+  for (pos = 0; (pos < historyLen) && ((pos + 3U) <= total); pos++)
+  {
+    WS_DEFLATE_INSERT(pos);
+  }
+
+  pos = historyLen;
+
+  while ((pos < total) && (_outPos <= _outMax))
+  {
+    uint16_t bestLen  = 0;
+    uint16_t bestDist = 0;
+
+    if ((pos + 3U) <= total)
+    {
+      uint16_t maxLen  = ((total - pos) < 258) ? (total - pos) : 258;
+      uint16_t cand    = head[WS_DEFLATE_HASH(&data[pos])];
+      uint16_t lastPos = pos;
+      uint8_t chain    = maxChain;
+
+      while (cand && chain--)
+      {
+        uint16_t c = cand - 1;
+
+        // the slot may have been reused by a newer position, or be out of the window
+        if ((c >= lastPos) || ((pos - c) > windowSize))
+        {
+          break;
+        }
+
+        lastPos = c;
+
+        if (data[c + bestLen] == data[pos + bestLen])
+        {
+          uint16_t len = 0;
+
+          while ((len < maxLen) && (data[c + len] == data[pos + len]))
+          {
+            len++;
+          }
+
+          if (len > bestLen)
+          {
+            bestLen  = len;
+            bestDist = pos - c;
+
+            if (len == maxLen)
+            {
+              break;
+            }
+          }
+        }
+
+        cand = prev[c & windowMask];
+      }
+
+      WS_DEFLATE_INSERT(pos);
+    }
+
+    if (bestLen >= 3)
+    {
+      putMatch(bestLen, bestDist);
+
+      for (uint16_t i = 1; i < bestLen; i++)
+      {
+        if ((pos + i + 3U) <= total)
+        {
+          WS_DEFLATE_INSERT(pos + i);
+        }
+      }
+
+      pos += bestLen;
+    }
+    else
+    {
+      putLiteral(data[pos]);
+      pos++;
+    }
+  }
+
+#undef WS_DEFLATE_INSERT
+#undef WS_DEFLATE_HASH
+
+  // end of block, then the empty stored block of a sync flush without its LEN / NLEN
+  putLiteral(256);
+  putBits(0, 3);
+
+  if (_bitCnt)
+  {
+    putBits(0, 8 - _bitCnt);
+  }
+
+  free(head);
+  free(prev);
+
+  uint8_t * out = _out;
+  _out = NULL;
+
+  if (_outPos > _outMax)
+  {
+    // not smaller than the message
+    free(out);
+    free(work);
+
+    return NULL;
+  }
+
+  *outLength = _outPos - headroom;
+
+  if (!_noContextTakeover)
+  {
+    // the peer now has this message in its window
+    uint16_t keep = (total < windowSize) ? total : windowSize;
+
+    if (!_history)
+    {
+      _history = (uint8_t *) malloc(windowSize);
+    }
+
+    if (_history)
+    {
+      memmove(_history, &data[total - keep], keep);
+      _historyLen = keep;
+    }
+    else
+    {
+      _historyLen = 0;
+    }
+  }
+
+  free(work);
+
+  return out;
+}
+
+WebSocketsDeflateSession::WebSocketsDeflateSession(uint8_t txWindowBits, uint8_t rxWindowBits, uint8_t memLevel,
+    bool txNoContextTakeover, bool rxNoContextTakeover, size_t minSize)
+  : tx(txWindowBits, memLevel, txNoContextTakeover), rx(rxWindowBits)
+{
+  this->txWindowBits        = txWindowBits;
+  this->txNoContextTakeover = txNoContextTakeover;
+  this->rxNoContextTakeover = rxNoContextTakeover;
+  this->minSize             = minSize;
+
+  rsv = WEBSOCKETS_RSV1;
+}
+
+/**
+   permessage-deflate takes RSV1 of the frames it compressed
+*/
+bool WebSocketsDeflateSession::encode(WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin,
+                                      uint8_t ** out, size_t * outLength, uint8_t * rsv)
+{
+  // only whole messages are compressed
+  if (!compress || !fin || ((opcode != WSop_text) && (opcode != WSop_binary)) || (length < minSize))
+  {
+    return false;
+  }
+
+  *out = tx.compress(payload, length, WEBSOCKETS_MAX_HEADER_SIZE, outLength);
+
+  if (!*out)
+  {
+    return false;
+  }
+
+  WSK_LOGDEBUG3("[deflate] compressed, length:", length, ", to:", *outLength);
+
+  *rsv |= WEBSOCKETS_RSV1;
+
+  return true;
+}
+
+/**
+   inflate the payload of a frame of a compressed message
+   the output of one message is limited to WEBSOCKETS_MAX_DATA_SIZE
+*/
+bool WebSocketsDeflateSession::decode(WSMessageHeader_t * header, uint8_t ** payload, uint16_t * closeCode)
+{
+  if (header->rsv1)
+  {
+    if (header->opCode == WSop_continuation)
+    {
+      // RSV1 only marks the first frame of a message
+      *closeCode = 1002;
+      return false;
+    }
+
+    rxMessage = true;
+  }
+  else if (!rxMessage || (header->opCode != WSop_continuation))
+  {
+    // not compressed
+    return true;
+  }
+
+  static const uint8_t trailer[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+  uint8_t * out   = NULL;
+  size_t outLen   = 0;
+  size_t outSize  = 0;
+  uint16_t reason = 1007;
+
+  WebSocketsInflate::WSinflateOutputCb output = [&](const uint8_t * data, size_t length) -> bool
+  {
+    if ((outLen + length) > WEBSOCKETS_MAX_DATA_SIZE)
+    {
+      reason = 1009;
+      return false;
+    }
+
+    if ((outLen + length + 1) > outSize)
+    {
+      // +1 for the 0 termination of text
+      size_t newSize = (outSize < 64) ? 128 : (outSize * 2);
+
+      if (newSize < (outLen + length + 1))
+      {
+        newSize = outLen + length + 1;
+      }
+
+      if (newSize > (WEBSOCKETS_MAX_DATA_SIZE + 1))
+      {
+        newSize = WEBSOCKETS_MAX_DATA_SIZE + 1;
+      }
+
+      uint8_t * newOut = (uint8_t *) realloc(out, newSize);
+
+      if (!newOut)
+      {
+        reason = 1011;
+        return false;
+      }
+
+      out     = newOut;
+      outSize = newSize;
+    }
+
+    memcpy(&out[outLen], data, length);
+    outLen += length;
+
+    return true;
+  };
+
+  WSinflateResult_t result = rx.inflate(*payload, header->payloadLen, output);
+
+  if (header->fin && (result == WSinflate_ok))
+  {
+    // the 00 00 ff ff the sender stripped from the end of the message
+    result = rx.inflate(trailer, sizeof(trailer), output);
+  }
+
+  if (((result == WSinflate_ok) || (result == WSinflate_end)) && !rx.flush(output))
+  {
+    result = WSinflate_aborted;
+  }
+
+  if (header->fin)
+  {
+    rxMessage = false;
+
+    if (rxNoContextTakeover)
+    {
+      rx.release();
+    }
+    else
+    {
+      rx.reset();
+    }
+  }
+
+  if ((result != WSinflate_ok) && (result != WSinflate_end))
+  {
+    *closeCode = (result == WSinflate_noMemory) ? 1011 : reason;
+
+    free(out);
+
+    return false;
+  }
+
+  if (out)
+  {
+    out[outLen] = 0x00;
+  }
+
+  free(*payload);
+
+  *payload           = out;
+  header->payloadLen = outLen;
+
+  return true;
+}
+
+/**
+   set up permessage-deflate for the connections opened from now on
+   @param windowBits uint8_t          9..15, LZ77 window of both directions, 2^windowBits bytes per connection and direction
+   @param memLevel uint8_t            1..9, encoder hash table of 2^(memLevel + 6) entries
+   @param noContextTakeover bool      both sides reset the window after each message, no RAM kept between messages
+   @param minSize size_t              messages shorter than this are sent uncompressed
+   @param inflateOnly bool            client: never compress, inflate received messages while they are read
+*/
+void WebSocketsDeflateExtension::configure(uint8_t windowBits, uint8_t memLevel, bool noContextTakeover, size_t minSize, bool inflateOnly)
+{
+  if (windowBits < WEBSOCKETS_DEFLATE_MIN_WINDOW_BITS)
+  {
+    windowBits = WEBSOCKETS_DEFLATE_MIN_WINDOW_BITS;
+  }
+  else if (windowBits > WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS)
+  {
+    windowBits = WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS;
+  }
+
+  if (memLevel < WEBSOCKETS_DEFLATE_MIN_MEM_LEVEL)
+  {
+    memLevel = WEBSOCKETS_DEFLATE_MIN_MEM_LEVEL;
+  }
+  else if (memLevel > WEBSOCKETS_DEFLATE_MAX_MEM_LEVEL)
+  {
+    memLevel = WEBSOCKETS_DEFLATE_MAX_MEM_LEVEL;
+  }
+
+  _config.windowBits        = windowBits;
+  _config.memLevel          = memLevel;
+  _config.noContextTakeover = noContextTakeover;
+  _config.minSize           = minSize;
+  _config.inflateOnly       = inflateOnly;
+}
+
+const char * WebSocketsDeflateExtension::name()
+{
+  return "permessage-deflate";
+}
+
+uint8_t WebSocketsDeflateExtension::rsv()
+{
+  return WEBSOCKETS_RSV1;
+}
+
+/**
+   client side, the permessage-deflate offer
+   @return String
+*/
+String WebSocketsDeflateExtension::offer()
+{
+  String offer = WEBSOCKETS_STRING("permessage-deflate");
+
+  if (_config.inflateOnly)
+  {
+    // we never compress, client_no_context_takeover tells the server it needs no window for us,
+    // client_max_window_bits costs nothing and lets servers with a small window accept the offer
+    offer += WEBSOCKETS_STRING("; client_no_context_takeover");
+
+    if (_config.noContextTakeover)
+    {
+      offer += WEBSOCKETS_STRING("; server_no_context_takeover");
+    }
+
+    offer += WEBSOCKETS_STRING("; server_max_window_bits=");
+    offer += String(_config.windowBits);
+    offer += WEBSOCKETS_STRING("; client_max_window_bits=");
+    offer += String(_config.windowBits);
+
+    return offer;
+  }
+
+  if (_config.noContextTakeover)
+  {
+    offer += WEBSOCKETS_STRING("; server_no_context_takeover; client_no_context_takeover");
+  }
+
+  offer += WEBSOCKETS_STRING("; server_max_window_bits=");
+  offer += String(_config.windowBits);
+  offer += WEBSOCKETS_STRING("; client_max_window_bits=");
+  offer += String(_config.windowBits);
+
+  return offer;
+}
+
+/**
+   client side, check the server's answer to offer()
+   @param response const String &
+   @return WebSocketsExtensionSession *   NULL if the connection has to be failed
+*/
+WebSocketsExtensionSession * WebSocketsDeflateExtension::confirm(const String & response)
+{
+  int pos = 0;
+  bool valid;
+  WSdeflateParams_t params;
+
+  if (!WS_nextDeflateOffer(response, pos, &params, &valid) || !valid)
+  {
+    WSK_LOGINFO1("[deflate] unexpected permessage-deflate response:", response);
+    return NULL;
+  }
+
+  uint8_t txWindowBits = _config.windowBits;
+  uint8_t rxWindowBits = _config.windowBits;
+
+  if (_config.inflateOnly)
+  {
+    // the client_* parameters only concern messages we never compress
+    params.clientMaxWindowBits = -1;
+  }
+
+  if ((params.serverMaxWindowBits > rxWindowBits) || (params.clientMaxWindowBits > txWindowBits) || (params.clientMaxWindowBits == 0))
+  {
+    WSK_LOGINFO1("[deflate] window bits not as offered:", response);
+    return NULL;
+  }
+
+  if (params.serverMaxWindowBits > 0)
+  {
+    rxWindowBits = params.serverMaxWindowBits;
+  }
+
+  if (params.clientMaxWindowBits > 0)
+  {
+    txWindowBits = params.clientMaxWindowBits;
+  }
+
+  WebSocketsDeflateSession * session = new WebSocketsDeflateSession(txWindowBits, rxWindowBits, _config.memLevel,
+                                                                    (_config.noContextTakeover || params.clientNoContextTakeover),
+                                                                    params.serverNoContextTakeover, _config.minSize);
+
+  if (!session)
+  {
+    WSK_LOGERROR("[deflate] No memory for permessage-deflate");
+    return NULL;
+  }
+
+  if (_config.inflateOnly)
+  {
+    session->compress = false;
+    session->stream   = true;
+  }
+
+  return session;
+}
+
+/**
+   server side, accept a permessage-deflate offer of the client if we can live with it
+   @param offer const String &
+   @param response String &   permessage-deflate with the parameters in use
+   @return WebSocketsExtensionSession *   NULL if declined
+*/
+WebSocketsExtensionSession * WebSocketsDeflateExtension::accept(const String & offer, String & response)
+{
+  int pos = 0;
+  bool valid;
+  WSdeflateParams_t params;
+
+  if (!WS_nextDeflateOffer(offer, pos, &params, &valid) || !valid)
+  {
+    return NULL;
+  }
+
+  // without client_max_window_bits the client may use a 32K window
+  if ((params.clientMaxWindowBits < 0) && (_config.windowBits < WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS))
+  {
+    WSK_LOGDEBUG("[deflate] client can not limit its window, declined");
+    return NULL;
+  }
+
+  uint8_t txWindowBits = _config.windowBits;
+  uint8_t rxWindowBits = _config.windowBits;
+
+  if ((params.serverMaxWindowBits > 0) && (params.serverMaxWindowBits < txWindowBits))
+  {
+    txWindowBits = params.serverMaxWindowBits;
+  }
+
+  if ((params.clientMaxWindowBits > 0) && (params.clientMaxWindowBits < rxWindowBits))
+  {
+    rxWindowBits = params.clientMaxWindowBits;
+  }
+
+  bool txNoContextTakeover = (_config.noContextTakeover || params.serverNoContextTakeover);
+  bool rxNoContextTakeover = (_config.noContextTakeover || params.clientNoContextTakeover);
+
+  WebSocketsDeflateSession * session = new WebSocketsDeflateSession(txWindowBits, rxWindowBits, _config.memLevel,
+                                                                    txNoContextTakeover, rxNoContextTakeover, _config.minSize);
+
+  if (!session)
+  {
+    WSK_LOGERROR("[deflate] No memory for permessage-deflate");
+    return NULL;
+  }
+
+  response = WEBSOCKETS_STRING("permessage-deflate");
+
+  if (txNoContextTakeover)
+  {
+    response += WEBSOCKETS_STRING("; server_no_context_takeover");
+  }
+
+  if (rxNoContextTakeover)
+  {
+    response += WEBSOCKETS_STRING("; client_no_context_takeover");
+  }
+
+  response += WEBSOCKETS_STRING("; server_max_window_bits=");
+  response += String(txWindowBits);
+
+  if (params.clientMaxWindowBits >= 0)
+  {
+    response += WEBSOCKETS_STRING("; client_max_window_bits=");
+    response += String(rxWindowBits);
+  }
+
+  return session;
+}
+
+/**
+   find the next permessage-deflate element of a Sec-WebSocket-Extensions value
+   @param extensions const String &
+   @param pos int &                      where to start, moved behind the element
+   @param params WSdeflateParams_t *     parameters of the element
+   @param valid bool *                   false if a parameter is unknown, duplicated or out of range
+   @return false if there is no element left
+*/
+bool WS_nextDeflateOffer(const String & extensions, int & pos, WSdeflateParams_t * params, bool * valid)
+{
+  int length = extensions.length();
+
+  while (pos < length)
+  {
+    int end = extensions.indexOf(',', pos);
+
+    if (end < 0)
+    {
+      end = length;
+    }
+
+    String element = extensions.substring(pos, end);
+    pos = end + 1;
+
+    int semicolon = element.indexOf(';');
+    String name   = (semicolon < 0) ? element : element.substring(0, semicolon);
+
+    name.trim();
+
+    if (!name.equalsIgnoreCase(WEBSOCKETS_STRING("permessage-deflate")))
+    {
+      continue;
+    }
+
+    *params = WSdeflateParams_t();
+    *valid  = true;
+
+    while (semicolon >= 0)
+    {
+      int next     = element.indexOf(';', semicolon + 1);
+      String param = element.substring(semicolon + 1, (next < 0) ? element.length() : next);
+      String value;
+
+      semicolon = next;
+
+      int equal = param.indexOf('=');
+
+      if (equal >= 0)
+      {
+        value = param.substring(equal + 1);
+        param = param.substring(0, equal);
+        value.trim();
+
+        // quoted-string form of the value, RFC 7692 7.1
+        if ((value.length() >= 2) && (value[0] == '"') && (value[value.length() - 1] == '"'))
+        {
+          value = value.substring(1, value.length() - 1);
+        }
+      }
+
+      param.trim();
+
+      int8_t * windowBits = NULL;
+      bool * noContextTakeover = NULL;
+
+      if (param.equalsIgnoreCase(WEBSOCKETS_STRING("server_no_context_takeover")))
+      {
+        noContextTakeover = &params->serverNoContextTakeover;
+      }
+      else if (param.equalsIgnoreCase(WEBSOCKETS_STRING("client_no_context_takeover")))
+      {
+        noContextTakeover = &params->clientNoContextTakeover;
+      }
+      else if (param.equalsIgnoreCase(WEBSOCKETS_STRING("server_max_window_bits")))
+      {
+        windowBits = &params->serverMaxWindowBits;
+      }
+      else if (param.equalsIgnoreCase(WEBSOCKETS_STRING("client_max_window_bits")))
+      {
+        windowBits = &params->clientMaxWindowBits;
+      }
+      else
+      {
+        *valid = false;
+        continue;
+      }
+
+      if (noContextTakeover)
+      {
+        if (*noContextTakeover || (equal >= 0))
+        {
+          *valid = false;
+        }
+
+        *noContextTakeover = true;
+      }
+      else
+      {
+        if (*windowBits >= 0)
+        {
+          *valid = false;
+        }
+
+        if (equal < 0)
+        {
+          // only client_max_window_bits may come without a value
+          *windowBits = 0;
+
+          if (windowBits == &params->serverMaxWindowBits)
+          {
+            *valid = false;
+          }
+        }
+        else
+        {
+          long bits = value.toInt();
+
+          if ((value.length() < 1) || (value.length() > 2) || (bits < 8) || (bits > 15))
+          {
+            *valid = false;
+          }
+          else
+          {
+            *windowBits = bits;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+#endif    // WEBSOCKETS_DEFLATE_GENERIC_IMPL_H_
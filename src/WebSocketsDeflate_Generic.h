@@ -0,0 +1,241 @@
+/****************************************************************************************************************************
+  WebSocketsDeflate_Generic.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  permessage-deflate (RFC 7692) support with bounded memory:
+  a streaming raw DEFLATE (RFC 1951) decoder with a fixed size window and a small
+  LZ77 + fixed Huffman encoder, sized by windowBits / memLevel.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_DEFLATE_GENERIC_H_
+#define WEBSOCKETS_DEFLATE_GENERIC_H_
+
+// compressed payload read per step when a message is inflated while it is read
+#ifndef WEBSOCKETS_INFLATE_CHUNK_SIZE
+  #define WEBSOCKETS_INFLATE_CHUNK_SIZE       (128)
+#endif
+
+// LZ77 window limits, RFC 7692 allows 8..15 but zlib never produces less than a 9 bit window
+#define WEBSOCKETS_DEFLATE_MIN_WINDOW_BITS    (9)
+#define WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS    (15)
+
+#define WEBSOCKETS_DEFLATE_MIN_MEM_LEVEL      (1)
+#define WEBSOCKETS_DEFLATE_MAX_MEM_LEVEL      (9)
+
+typedef struct
+{
+  uint8_t windowBits        = 10;      ///< LZ77 window, for our encoder and the max accepted from the peer
+  uint8_t memLevel          = 2;       ///< encoder hash table of 2^(memLevel + 6) entries
+  bool noContextTakeover    = true;    ///< both sides start every message with an empty window
+  size_t minSize            = 64;      ///< smaller messages are sent uncompressed
+  bool inflateOnly          = false;   ///< client: never compress, inflate received messages while they are read
+} WSdeflateConfig_t;
+
+typedef struct
+{
+  bool serverNoContextTakeover = false;
+  bool clientNoContextTakeover = false;
+  int8_t serverMaxWindowBits   = -1;    ///< -1 not present, 0 present without value
+  int8_t clientMaxWindowBits   = -1;    ///< -1 not present, 0 present without value
+} WSdeflateParams_t;
+
+typedef enum
+{
+  WSinflate_ok,          ///< all input consumed
+  WSinflate_end,         ///< final block seen, the rest of the input is ignored
+  WSinflate_error,       ///< invalid deflate data
+  WSinflate_aborted,     ///< the output callback refused the data
+  WSinflate_noMemory
+} WSinflateResult_t;
+
+/**
+   streaming raw DEFLATE decoder
+   input can be fed in pieces of any size, the output is handed to the callback
+   in chunks of at most 2^windowBits bytes: whenever the window wraps and on flush()
+*/
+class WebSocketsInflate
+{
+  public:
+#ifdef __AVR__
+    typedef bool (*WSinflateOutputCb)(const uint8_t * data, size_t length);
+#else
+    typedef std::function<bool(const uint8_t * data, size_t length)> WSinflateOutputCb;
+#endif
+
+    WebSocketsInflate(uint8_t windowBits = WEBSOCKETS_DEFLATE_MAX_WINDOW_BITS);
+    ~WebSocketsInflate();
+
+    WSinflateResult_t inflate(const uint8_t * in, size_t length, WSinflateOutputCb cb);
+    bool flush(const WSinflateOutputCb & cb);
+
+    void reset();       // start a new stream but keep the window (context takeover)
+    void release();     // start a new stream and free the window
+
+  private:
+    typedef struct
+    {
+      uint16_t count[16];    ///< number of codes of each length
+      uint16_t * symbol;     ///< canonically ordered symbols
+    } WSHuffman_t;
+
+    enum
+    {
+      WSinflate_header,
+      WSinflate_storedLen,
+      WSinflate_stored,
+      WSinflate_tableHeader,
+      WSinflate_tableCodeLens,
+      WSinflate_tableLens,
+      WSinflate_lenSym,
+      WSinflate_lenExtra,
+      WSinflate_distSym,
+      WSinflate_distExtra,
+      WSinflate_copy,
+      WSinflate_done
+    } _state;
+
+    uint8_t * _window;
+    uint16_t _windowSize;
+    uint16_t _windowPos;
+    uint16_t _flushPos;
+    bool _windowFull;
+
+    const uint8_t * _in;
+    size_t _inLen;
+    uint32_t _bitBuf;
+    uint8_t _bitCnt;
+
+    bool _final;
+    uint16_t _remaining;    ///< stored bytes / match length left
+    uint16_t _dist;
+    uint16_t _sym;
+    uint16_t _nlen;
+    uint16_t _ndist;
+    uint16_t _ncode;
+    uint16_t _index;
+
+    uint16_t _lenCount[16];
+    uint16_t _lenSymbol[288];
+    uint16_t _distCount[16];
+    uint16_t _distSymbol[30];
+    uint8_t _lengths[288 + 30];
+
+    WSHuffman_t _lenCode;
+    WSHuffman_t _distCode;
+
+    bool need(uint8_t bits);
+    uint16_t bits(uint8_t bits);
+    int decode(WSHuffman_t * h, uint8_t * codeLen);
+    bool construct(WSHuffman_t * h, const uint8_t * length, uint16_t n);
+    bool put(uint8_t c, const WSinflateOutputCb & cb);
+};
+
+/**
+   raw DEFLATE encoder, LZ77 with hash chains and the fixed Huffman code,
+   every message is closed with a sync flush and the trailing 00 00 ff ff is stripped (RFC 7692 7.2.1)
+*/
+class WebSocketsDeflate
+{
+  public:
+    WebSocketsDeflate(uint8_t windowBits = 10, uint8_t memLevel = 2, bool noContextTakeover = true);
+    ~WebSocketsDeflate();
+
+    uint8_t * compress(const uint8_t * in, size_t length, size_t headroom, size_t * outLength);
+
+    void reset();    // forget the history of the previous messages
+
+  private:
+    uint8_t _windowBits;
+    uint8_t _hashBits;
+    bool _noContextTakeover;
+
+    uint8_t * _history;     ///< last bytes of the previous messages, only with context takeover
+    uint16_t _historyLen;
+
+    uint8_t * _out;
+    size_t _outPos;
+    size_t _outMax;
+    uint32_t _bitBuf;
+    uint8_t _bitCnt;
+
+    void putBits(uint32_t value, uint8_t bits);
+    void putCode(uint16_t code, uint8_t bits);
+    void putLiteral(uint16_t sym);
+    void putMatch(uint16_t length, uint16_t dist);
+};
+
+/**
+   negotiated permessage-deflate state of one connection
+*/
+class WebSocketsDeflateSession : public WebSocketsExtensionSession
+{
+  public:
+    WebSocketsDeflateSession(uint8_t txWindowBits, uint8_t rxWindowBits, uint8_t memLevel,
+                             bool txNoContextTakeover, bool rxNoContextTakeover, size_t minSize);
+
+    bool encode(WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin,
+                uint8_t ** out, size_t * outLength, uint8_t * rsv);
+    bool decode(WSMessageHeader_t * header, uint8_t ** payload, uint16_t * closeCode);
+
+    WebSocketsDeflate tx;
+    WebSocketsInflate rx;
+
+    uint8_t txWindowBits;
+    bool txNoContextTakeover;
+    bool rxNoContextTakeover;
+    bool rxMessage = false;    ///< inside a compressed message (RSV1 on its first frame)
+    size_t minSize;
+
+    bool compress       = true;                 ///< false = inflate only, everything is sent uncompressed
+    bool stream         = false;                ///< inflate while reading and hand out the window as fragments
+    WSopcode_t rxOpcode = WSop_continuation;    ///< text or binary, opcode of the streamed message
+    bool rxStarted      = false;                ///< first part of the streamed message has been handed out
+};
+
+/**
+   permessage-deflate (RFC 7692) as an extension of a server or client
+*/
+class WebSocketsDeflateExtension : public WebSocketsExtension
+{
+  public:
+    void configure(uint8_t windowBits, uint8_t memLevel, bool noContextTakeover, size_t minSize, bool inflateOnly = false);
+
+    const char * name();
+    uint8_t rsv();
+
+    String offer();
+    WebSocketsExtensionSession * confirm(const String & response);
+    WebSocketsExtensionSession * accept(const String & offer, String & response);
+
+  private:
+    WSdeflateConfig_t _config;
+};
+
+bool WS_nextDeflateOffer(const String & extensions, int & pos, WSdeflateParams_t * params, bool * valid);
+
+#include "WebSocketsDeflate_Generic-Impl.h"
+
+#endif    // WEBSOCKETS_DEFLATE_GENERIC_H_
@@ -0,0 +1,81 @@
+/****************************************************************************************************************************
+  WebSocketsExtension_Generic-Impl.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_EXTENSION_GENERIC_IMPL_H_
+#define WEBSOCKETS_EXTENSION_GENERIC_IMPL_H_
+
+/**
+   split the next element off a Sec-WebSocket-Extensions value
+   @param extensions const String &
+   @param pos int &          where to start, moved behind the element
+   @param element String &   the element, trimmed
+   @param name String &      its extension token
+   @return false if there is no element left
+*/
+bool WS_nextExtension(const String & extensions, int & pos, String & element, String & name)
+{
+  int length = extensions.length();
+
+  while (pos < length)
+  {
+    bool quoted = false;
+    int end     = pos;
+
+    // a quoted parameter value may contain a comma
+    while ((end < length) && (quoted || (extensions[end] != ',')))
+    {
+      if (extensions[end] == '"')
+      {
+        quoted = !quoted;
+      }
+
+      end++;
+    }
+
+    element = extensions.substring(pos, end);
+    pos     = end + 1;
+
+    element.trim();
+
+    if (element.length() == 0)
+    {
+      continue;
+    }
+
+    int semicolon = element.indexOf(';');
+
+    name = (semicolon < 0) ? element : element.substring(0, semicolon);
+    name.trim();
+
+    return true;
+  }
+
+  return false;
+}
+
+#endif    // WEBSOCKETS_EXTENSION_GENERIC_IMPL_H_
@@ -0,0 +1,151 @@
+/****************************************************************************************************************************
+  WebSocketsExtension_Generic.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  WebSocket extensions (RFC 6455 9): handshake negotiation, RSV bit ownership and
+  payload transforms of the data frames, applied in the negotiated order.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_EXTENSION_GENERIC_H_
+#define WEBSOCKETS_EXTENSION_GENERIC_H_
+
+// extensions a server or client can register
+#ifndef WEBSOCKETS_MAX_EXTENSIONS
+  #define WEBSOCKETS_MAX_EXTENSIONS     (4)
+#endif
+
+#define WEBSOCKETS_RSV1     (0x40)
+#define WEBSOCKETS_RSV2     (0x20)
+#define WEBSOCKETS_RSV3     (0x10)
+
+/**
+   state of a negotiated extension on one connection
+   the connection keeps them in a list in the negotiated order, outgoing frames pass it from the first
+   to the last one, incoming frames the other way round
+*/
+class WebSocketsExtensionSession
+{
+  public:
+    virtual ~WebSocketsExtensionSession() {}
+
+    /**
+       transform an outgoing data frame
+       @param opcode WSopcode_t           WSop_text, WSop_binary or WSop_continuation
+       @param payload const uint8_t *
+       @param length size_t
+       @param fin bool
+       @param out uint8_t **              new payload, malloc'ed with WEBSOCKETS_MAX_HEADER_SIZE bytes in front of the data
+       @param outLength size_t *
+       @param rsv uint8_t *               add the RSV bits of the extension when the payload is replaced
+       @return true if *out replaces the payload
+    */
+    virtual bool encode(WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin,
+                        uint8_t ** out, size_t * outLength, uint8_t * rsv)
+    {
+      (void) opcode;
+      (void) payload;
+      (void) length;
+      (void) fin;
+      (void) out;
+      (void) outLength;
+      (void) rsv;
+
+      return false;
+    }
+
+    /**
+       transform an incoming data frame, already unmasked
+       @param header WSMessageHeader_t *   RSV bits, opcode and fin of the frame, payloadLen has to follow the payload
+       @param payload uint8_t **          may be replaced by a malloc'ed, zero terminated buffer, the extension frees the old one
+       @param closeCode uint16_t *        status code to fail the connection with
+       @return false to fail the connection
+    */
+    virtual bool decode(WSMessageHeader_t * header, uint8_t ** payload, uint16_t * closeCode)
+    {
+      (void) header;
+      (void) payload;
+      (void) closeCode;
+
+      return true;
+    }
+
+    uint8_t rsv = 0x00;                                  ///< RSV bits the extension uses on this connection
+    WebSocketsExtensionSession * next = nullptr;         ///< next extension in the negotiated order
+};
+
+/**
+   an extension as registered with a server or a client
+   creates a WebSocketsExtensionSession for every connection that negotiated it
+*/
+class WebSocketsExtension
+{
+  public:
+    virtual ~WebSocketsExtension() {}
+
+    /**
+       @return const char *   extension token in Sec-WebSocket-Extensions
+    */
+    virtual const char * name() = 0;
+
+    /**
+       @return uint8_t   WEBSOCKETS_RSV1 / WEBSOCKETS_RSV2 / WEBSOCKETS_RSV3 the extension may set,
+                         two registered extensions can not share a bit
+    */
+    virtual uint8_t rsv()
+    {
+      return 0x00;
+    }
+
+    /**
+       client side, element for the Sec-WebSocket-Extensions request header
+       @return String, empty to offer nothing
+    */
+    virtual String offer()
+    {
+      return String(name());
+    }
+
+    /**
+       client side, the server accepted the offer
+       @param response const String &   element of the Sec-WebSocket-Extensions response
+       @return WebSocketsExtensionSession *   new session, NULL fails the connection
+    */
+    virtual WebSocketsExtensionSession * confirm(const String & response) = 0;
+
+    /**
+       server side, one element of the client's Sec-WebSocket-Extensions
+       @param offer const String &
+       @param response String &   element for the response
+       @return WebSocketsExtensionSession *   new session, NULL declines this offer
+    */
+    virtual WebSocketsExtensionSession * accept(const String & offer, String & response) = 0;
+};
+
+bool WS_nextExtension(const String & extensions, int & pos, String & element, String & name);
+
+#include "WebSocketsExtension_Generic-Impl.h"
+
+#endif    // WEBSOCKETS_EXTENSION_GENERIC_H_
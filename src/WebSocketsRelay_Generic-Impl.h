@@ -0,0 +1,218 @@
+/****************************************************************************************************************************
+  WebSocketsRelay_Generic-Impl.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_RELAY_GENERIC_IMPL_H_
+#define WEBSOCKETS_RELAY_GENERIC_IMPL_H_
+
+WebSocketsRelay::WebSocketsRelay()
+{
+  _next    = relays();
+  relays() = this;
+}
+
+WebSocketsRelay::~WebSocketsRelay()
+{
+  // the sources stop relaying, targets in the middle of one of their messages get its end
+  while (_sources)
+  {
+    WSclient_t * source = _sources;
+
+    finish(source);
+
+    _sources           = (WSclient_t *) source->cRelayNext;
+    source->cRelay     = NULL;
+    source->cRelayNext = NULL;
+    source->cRelaying  = false;
+  }
+
+  _count = 0;
+
+  for (WebSocketsRelay ** relay = &relays(); *relay; relay = &(*relay)->_next)
+  {
+    if (*relay == this)
+    {
+      *relay = _next;
+      break;
+    }
+  }
+}
+
+/**
+   remove all targets, a target in the middle of a relayed message gets an empty final fragment
+*/
+void WebSocketsRelay::clear()
+{
+  while (_count)
+  {
+    removeAt(_count - 1);
+  }
+}
+
+/**
+   add a target connection, called by WebSockets::relayAdd()
+   @param ws WebSockets *       server or client the connection belongs to
+   @param client WSclient_t *   ptr to the client struct
+   @param slot bool             keep the target when its connection goes, for the next one of the slot
+   @return false if WEBSOCKETS_RELAY_TARGETS_MAX targets are set already
+*/
+bool WebSocketsRelay::add(WebSockets * ws, WSclient_t * client, bool slot)
+{
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if (_clients[i] == client)
+    {
+      _slot[i] = _slot[i] || slot;
+
+      return true;
+    }
+  }
+
+  if (_count >= WEBSOCKETS_RELAY_TARGETS_MAX)
+  {
+    WSK_LOGERROR("[WebSocketsRelay] Too many targets");
+
+    return false;
+  }
+
+  _ws[_count]      = ws;
+  _clients[_count] = client;
+  _slot[_count]    = slot;
+  _count++;
+
+  return true;
+}
+
+/**
+   remove a target connection, called by WebSockets::relayRemove()
+   @param client WSclient_t *   ptr to the client struct
+   @return false if it is no target
+*/
+bool WebSocketsRelay::remove(WSclient_t * client)
+{
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if (_clients[i] == client)
+    {
+      removeAt(i);
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+   remove the i-th target, in the middle of a message from a source of this relay it gets an empty final fragment
+   @param i uint8_t   index in _clients
+*/
+void WebSocketsRelay::removeAt(uint8_t i)
+{
+  WSclient_t * target = _clients[i];
+  WSclient_t * owner  = (WSclient_t *) target->cRelayOwner;
+
+  if (owner && (owner->cRelay == this))
+  {
+    target->cRelayOwner = NULL;
+    _ws[i]->sendFrame(target, WSop_continuation, NULL, 0, true, false, true);
+  }
+
+  _count--;
+
+  for (uint8_t x = i; x < _count; x++)
+  {
+    _ws[x]      = _ws[x + 1];
+    _clients[x] = _clients[x + 1];
+    _slot[x]    = _slot[x + 1];
+  }
+}
+
+/**
+   a connection goes away, called by WebSockets::relayRelease() for all relays
+   @param client WSclient_t *   ptr to the client struct
+   @param all bool              also if it is kept for the next connection of the slot
+*/
+void WebSocketsRelay::release(WSclient_t * client, bool all)
+{
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if ((_clients[i] == client) && (all || !_slot[i]))
+    {
+      removeAt(i);
+
+      return;
+    }
+  }
+}
+
+/**
+   a fragmented message of a source breaks off, its targets get an empty final fragment
+   @param source WSclient_t *   ptr to the client struct of the source
+*/
+void WebSocketsRelay::finish(WSclient_t * source)
+{
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    WSclient_t * target = _clients[i];
+
+    if (target->cRelayOwner == source)
+    {
+      target->cRelayOwner = NULL;
+      _ws[i]->sendFrame(target, WSop_continuation, NULL, 0, true, false, true);
+    }
+  }
+}
+
+/**
+   a connection relays to this relay
+   @param source WSclient_t *   ptr to the client struct
+*/
+void WebSocketsRelay::link(WSclient_t * source)
+{
+  source->cRelayNext = _sources;
+  _sources           = source;
+}
+
+/**
+   a connection no longer relays to this relay
+   @param source WSclient_t *   ptr to the client struct
+*/
+void WebSocketsRelay::unlink(WSclient_t * source)
+{
+  for (WSclient_t ** client = &_sources; *client; client = (WSclient_t **) &(*client)->cRelayNext)
+  {
+    if (*client == source)
+    {
+      *client            = (WSclient_t *) source->cRelayNext;
+      source->cRelayNext = NULL;
+      break;
+    }
+  }
+}
+
+#endif    // WEBSOCKETS_RELAY_GENERIC_IMPL_H_
@@ -0,0 +1,109 @@
+/****************************************************************************************************************************
+  WebSocketsRelay_Generic.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  Frame relay: messages of one connection are forwarded to others while they come in,
+  only the frame header and the masking are redone.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_RELAY_GENERIC_H_
+#define WEBSOCKETS_RELAY_GENERIC_H_
+
+// connections a relay forwards to
+#ifndef WEBSOCKETS_RELAY_TARGETS_MAX
+  #define WEBSOCKETS_RELAY_TARGETS_MAX      (8)
+#endif
+
+// payload bytes moved per read while a frame is relayed, twice on the stack of loop()
+#ifndef WEBSOCKETS_RELAY_CHUNK_SIZE
+  #define WEBSOCKETS_RELAY_CHUNK_SIZE       (256)
+#endif
+
+/**
+   forwards the text and binary messages received on its source connections to its targets
+   while they come in, WEBSOCKETS_RELAY_CHUNK_SIZE bytes at a time, the fragments keep their size
+   sources are set with setRelay(), targets added with addRelayTarget() of the server or the client
+   relayed messages do not reach the event handler, control frames stay with their connection,
+   messages an extension transformed (RSV bits set, e.g. compressed) are not relayed.
+   a target in the middle of a fragmented message from another source or a writer misses the message,
+   while a fragmented message is relayed to a target sendTXT() / sendBIN() to it return false and its bulk messages wait.
+   a target added for one server client is removed when that client disconnects, the ones added for all clients of
+   a server and the connection of a client stay with the slot over reconnects. sources and targets are dropped when
+   their server or client is destroyed, the sources stop relaying when the relay is
+*/
+class WebSocketsRelay
+{
+  public:
+    WebSocketsRelay();
+    ~WebSocketsRelay();
+
+    // sources and targets know a relay by its address
+    WebSocketsRelay(const WebSocketsRelay &) = delete;
+    WebSocketsRelay & operator=(const WebSocketsRelay &) = delete;
+
+    void clear();
+
+    /**
+       @return uint8_t   number of target connections
+    */
+    uint8_t targets()
+    {
+      return _count;
+    }
+
+  protected:
+    friend class WebSockets;
+
+    bool add(WebSockets * ws, WSclient_t * client, bool slot);
+    bool remove(WSclient_t * client);
+    void removeAt(uint8_t i);
+    void release(WSclient_t * client, bool all);
+    void finish(WSclient_t * source);
+    void link(WSclient_t * source);
+    void unlink(WSclient_t * source);
+
+    /**
+       @return WebSocketsRelay *&   first of all relays, linked through _next
+    */
+    static WebSocketsRelay *& relays()
+    {
+      static WebSocketsRelay * first = nullptr;
+
+      return first;
+    }
+
+    WebSockets * _ws[WEBSOCKETS_RELAY_TARGETS_MAX];          ///< owner of each target, its write() and cork mode are used
+    WSclient_t * _clients[WEBSOCKETS_RELAY_TARGETS_MAX];
+    bool _slot[WEBSOCKETS_RELAY_TARGETS_MAX];                ///< target kept when its connection goes, for the next one of the slot
+    uint8_t _count = 0;
+
+    WSclient_t * _sources   = nullptr;    ///< connections with cRelay set to this relay, linked through cRelayNext
+    WebSocketsRelay * _next = nullptr;
+};
+
+#include "WebSocketsRelay_Generic-Impl.h"
+
+#endif    // WEBSOCKETS_RELAY_GENERIC_H_
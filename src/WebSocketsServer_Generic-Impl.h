@@ -66,11 +66,20 @@ WebSocketsServerCore::WebSocketsServerCore(const String & origin, const String &
     _pongTimeout            = 0;
     _disconnectTimeoutCount = 0;
 
-    _cbEvent = NULL;
+    _handshakeTimeout       = WEBSOCKETS_SERVER_HANDSHAKE_TIMEOUT;
+    _nextHandshakeExpiry    = 0;
+    _handshakePending       = false;
+
+    memset(&_stats, 0, sizeof(_stats));
+
+    _cbEvent      = NULL;
+    _cbBatchEvent = NULL;
 
     _httpHeaderValidationFunc = NULL;
     _mandatoryHttpHeaders     = NULL;
     _mandatoryHttpHeaderCount = 0;
+
+    buildHttpHeaderTable();
 }
 
 //WebSocketsServer::WebSocketsServer(uint16_t port, String origin, String protocol)
@@ -95,6 +104,8 @@ WebSocketsServerCore::~WebSocketsServerCore()
   // disconnect all clients
   close();
 
+  batchRelease();
+
   if(_mandatoryHttpHeaders)
     delete[] _mandatoryHttpHeaders;
 
@@ -144,6 +155,7 @@ void WebSocketsServerCore::close()
   // before next call to ::begin()
   for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) 
   {
+    relayDetach(&_clients[i]);
     _clients[i] = WSclient_t();
   }
 }
@@ -157,6 +169,38 @@ void WebSocketsServerCore::onEvent(WebSocketServerEvent cbEvent)
   _cbEvent = cbEvent;
 }
 
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+/**
+   set the batch callback, the complete text and binary messages of a client read in one loop()
+   go to it with one call instead of one onEvent() call each, the other events stay with onEvent()
+   the messages are copied to one buffer, a message that does not fit is delivered alone
+   @param cbBatchEvent WebSocketServerBatchEvent   NULL = off, the buffer is freed
+   @param bufferSize size_t      payload bytes per batch, each message takes its length + 1
+   @param maxMessages uint16_t   messages per batch
+   @return false if the buffer could not be allocated, batching stays off
+*/
+bool WebSocketsServerCore::onBatchEvent(WebSocketServerBatchEvent cbBatchEvent, size_t bufferSize, uint16_t maxMessages)
+{
+  batchFlush();
+
+  _cbBatchEvent = cbBatchEvent;
+
+  if (!cbBatchEvent)
+  {
+    batchRelease();
+    return true;
+  }
+
+  if (!batchEnable(bufferSize, maxMessages))
+  {
+    _cbBatchEvent = NULL;
+    return false;
+  }
+
+  return true;
+}
+#endif
+
 /*
    Sets the custom http header validator function
    @param httpHeaderValidationFunc WebSocketServerHttpHeaderValFunc ///< pointer to the custom http header validation function
@@ -178,6 +222,8 @@ void WebSocketsServerCore::onValidateHttpHeader(WebSocketServerHttpHeaderValFunc
   {
     _mandatoryHttpHeaders[i] = mandatoryHttpHeaders[i];
   }
+
+  buildHttpHeaderTable();
 }
 
 /*
@@ -204,7 +250,7 @@ bool WebSocketsServerCore::sendTXT(uint8_t num, uint8_t * payload, size_t length
 
   if (clientIsConnected(client))
   {
-    return sendFrame(client, WSop_text, payload, length, true, headerToPayload);
+    return sendMessage(client, WSop_text, payload, length, headerToPayload);
   }
 
   return false;
@@ -239,30 +285,12 @@ bool WebSocketsServerCore::sendTXT(uint8_t num, String & payload)
 */
 bool WebSocketsServerCore::broadcastTXT(uint8_t * payload, size_t length, bool headerToPayload)
 {
-  WSclient_t * client;
-  bool ret = true;
-
   if (length == 0)
   {
     length = strlen((const char *)payload);
   }
 
-  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
-  {
-    client = &_clients[i];
-
-    if (clientIsConnected(client))
-    {
-      if (!sendFrame(client, WSop_text, payload, length, true, headerToPayload))
-      {
-        ret = false;
-      }
-    }
-
-    WEBSOCKETS_YIELD();
-  }
-
-  return ret;
+  return broadcastFrame(WSop_text, payload, length, headerToPayload);
 }
 
 bool WebSocketsServerCore::broadcastTXT(const uint8_t * payload, size_t length)
@@ -304,7 +332,7 @@ bool WebSocketsServerCore::sendBIN(uint8_t num, uint8_t * payload, size_t length
 
   if (clientIsConnected(client))
   {
-    return sendFrame(client, WSop_binary, payload, length, true, headerToPayload);
+    return sendMessage(client, WSop_binary, payload, length, headerToPayload);
   }
 
   return false;
@@ -315,6 +343,168 @@ bool WebSocketsServerCore::sendBIN(uint8_t num, const uint8_t * payload, size_t
   return sendBIN(num, (uint8_t *)payload, length);
 }
 
+/**
+   queue a text message to a client as bulk data, it is sent in fragments from loop()
+   while ping / pong and sendTXT / sendBIN messages go out in between
+   @param num uint8_t client id
+   @param payload const char *   copied
+   @param length size_t
+   @return false if the client is not connected or its queue is full
+*/
+bool WebSocketsServerCore::queueTXT(uint8_t num, const char * payload, size_t length)
+{
+  if (length == 0)
+  {
+    length = strlen(payload);
+  }
+
+  if ((num < WEBSOCKETS_SERVER_CLIENT_MAX) && clientIsConnected(&_clients[num]))
+  {
+    return queueMessage(&_clients[num], WSop_text, (const uint8_t *) payload, length);
+  }
+
+  return false;
+}
+
+/**
+   queue a binary message to a client as bulk data (see queueTXT)
+   @param num uint8_t client id
+   @param payload const uint8_t *   copied
+   @param length size_t
+   @return false if the client is not connected or its queue is full
+*/
+bool WebSocketsServerCore::queueBIN(uint8_t num, const uint8_t * payload, size_t length)
+{
+  if ((num < WEBSOCKETS_SERVER_CLIENT_MAX) && clientIsConnected(&_clients[num]))
+  {
+    return queueMessage(&_clients[num], WSop_binary, payload, length);
+  }
+
+  return false;
+}
+
+/**
+   start a text message to a client that is sent while it is written, see WebSocketsWriter
+   @param num uint8_t client id
+   @param writer WebSocketsWriter &
+   @return true if ok
+*/
+bool WebSocketsServerCore::beginTXT(uint8_t num, WebSocketsWriter & writer)
+{
+  if ((num < WEBSOCKETS_SERVER_CLIENT_MAX) && clientIsConnected(&_clients[num]))
+  {
+    return beginMessage(&_clients[num], WSop_text, writer);
+  }
+
+  return false;
+}
+
+/**
+   start a binary message to a client that is sent while it is written, see WebSocketsWriter
+   @param num uint8_t client id
+   @param writer WebSocketsWriter &
+   @return true if ok
+*/
+bool WebSocketsServerCore::beginBIN(uint8_t num, WebSocketsWriter & writer)
+{
+  if ((num < WEBSOCKETS_SERVER_CLIENT_MAX) && clientIsConnected(&_clients[num]))
+  {
+    return beginMessage(&_clients[num], WSop_binary, writer);
+  }
+
+  return false;
+}
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+/**
+   forward the text and binary messages of all clients to the targets of a relay while they
+   come in, they do not reach the event handler, see WebSocketsRelay
+   @param relay WebSocketsRelay *   NULL to deliver the messages to the event handler again
+*/
+void WebSocketsServerCore::setRelay(WebSocketsRelay * relay)
+{
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+  {
+    relaySet(&_clients[i], relay);
+  }
+}
+
+/**
+   relay the messages of one client, the setting stays with the client slot
+   @param num uint8_t client id
+   @param relay WebSocketsRelay *   NULL to deliver the messages to the event handler again
+*/
+void WebSocketsServerCore::setRelay(uint8_t num, WebSocketsRelay * relay)
+{
+  if (num < WEBSOCKETS_SERVER_CLIENT_MAX)
+  {
+    relaySet(&_clients[num], relay);
+  }
+}
+
+/**
+   make all clients targets of a relay, the ones connected at the time a message starts get it,
+   the client slots stay targets over disconnects
+   @param relay WebSocketsRelay &
+   @return false if the relay has no room for all of them
+*/
+bool WebSocketsServerCore::addRelayTarget(WebSocketsRelay & relay)
+{
+  bool ret = true;
+
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+  {
+    ret = relayAdd(relay, &_clients[i], true) && ret;
+  }
+
+  return ret;
+}
+
+/**
+   make one client a target of a relay, until it disconnects
+   @param relay WebSocketsRelay &
+   @param num uint8_t client id
+   @return false if num is invalid or the relay has no room for another target
+*/
+bool WebSocketsServerCore::addRelayTarget(WebSocketsRelay & relay, uint8_t num)
+{
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+  {
+    return false;
+  }
+
+  return relayAdd(relay, &_clients[num], false);
+}
+
+/**
+   remove all clients from the targets of a relay
+   @param relay WebSocketsRelay &
+*/
+void WebSocketsServerCore::removeRelayTarget(WebSocketsRelay & relay)
+{
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+  {
+    relayRemove(relay, &_clients[i]);
+  }
+}
+
+/**
+   remove one client from the targets of a relay, in the middle of a relayed message it gets its end
+   @param relay WebSocketsRelay &
+   @param num uint8_t client id
+   @return false if num is invalid or no target of the relay
+*/
+bool WebSocketsServerCore::removeRelayTarget(WebSocketsRelay & relay, uint8_t num)
+{
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+  {
+    return false;
+  }
+
+  return relayRemove(relay, &_clients[num]);
+}
+#endif
+
 /**
    send binary data to client all
    @param payload uint8_t
@@ -323,17 +513,71 @@ bool WebSocketsServerCore::sendBIN(uint8_t num, const uint8_t * payload, size_t
    @return true if ok
 */
 bool WebSocketsServerCore::broadcastBIN(uint8_t * payload, size_t length, bool headerToPayload)
+{
+  return broadcastFrame(WSop_binary, payload, length, headerToPayload);
+}
+
+bool WebSocketsServerCore::broadcastBIN(const uint8_t * payload, size_t length)
+{
+  return broadcastBIN((uint8_t *)payload, length);
+}
+
+/**
+   send a message to all clients
+   with permessage-deflate and no context takeover the compressed frame only depends on the window,
+   so it is built once and sent to every client with the same window
+   @param opcode WSopcode_t     WSop_text or WSop_binary
+   @param payload uint8_t *
+   @param length size_t
+   @param headerToPayload bool  (see sendFrame for more details)
+   @return true if ok
+*/
+bool WebSocketsServerCore::broadcastFrame(WSopcode_t opcode, uint8_t * payload, size_t length, bool headerToPayload)
 {
   WSclient_t * client;
   bool ret = true;
 
+  uint8_t * shared    = NULL;    ///< compressed frame with WEBSOCKETS_MAX_HEADER_SIZE headroom, NULL if it did not pay off
+  size_t sharedLength = 0;
+  uint8_t sharedBits  = 0;       ///< window it was compressed with, 0 = not compressed yet
+
   for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
   {
     client = &_clients[i];
 
     if (clientIsConnected(client))
     {
-      if (!sendFrame(client, WSop_binary, payload, length, true, headerToPayload))
+      WebSocketsDeflateSession * session = client->cDeflate;
+      bool sent;
+
+      // only when permessage-deflate is the one extension of the connection
+      if (session && (client->cExtensionList == session) && !session->next && session->compress && session->txNoContextTakeover && (length >= session->minSize) &&
+          ((sharedBits == 0) || (session->txWindowBits == sharedBits)))
+      {
+        if (sharedBits == 0)
+        {
+          sharedBits = session->txWindowBits;
+          shared     = session->tx.compress((payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length,
+                                            WEBSOCKETS_MAX_HEADER_SIZE, &sharedLength);
+        }
+
+        if (shared)
+        {
+          // the server does not mask, only the header in front of the data is (re)written
+          sent = sendMessage(client, opcode, shared, sharedLength, true, true, WEBSOCKETS_RSV1);
+        }
+        else
+        {
+          // not smaller compressed, don't try again for every client
+          sent = sendMessage(client, opcode, payload, length, headerToPayload, true);
+        }
+      }
+      else
+      {
+        sent = sendMessage(client, opcode, payload, length, headerToPayload);
+      }
+
+      if (!sent)
       {
         ret = false;
       }
@@ -342,12 +586,12 @@ bool WebSocketsServerCore::broadcastBIN(uint8_t * payload, size_t length, bool h
     WEBSOCKETS_YIELD();
   }
 
-  return ret;
-}
+  if (shared)
+  {
+    free(shared);
+  }
 
-bool WebSocketsServerCore::broadcastBIN(const uint8_t * payload, size_t length)
-{
-  return broadcastBIN((uint8_t *)payload, length);
+  return ret;
 }
 
 /**
@@ -553,6 +797,9 @@ WSclient_t * WebSocketsServerCore::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclien
 {
   WSclient_t * client;
 
+  // a stalled handshake may still hold the slot we need
+  expireHandshakes();
+
   // search free list entry for client
   for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
   {
@@ -575,7 +822,7 @@ WSclient_t * WebSocketsServerCore::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclien
 
 #if (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
       // set Timeout for readBytesUntil and readStringUntil
-      client->tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
+      client->tcp->setTimeout(_readTimeout);
 #endif
 
       client->status = WSC_HEADER;
@@ -625,14 +872,82 @@ WSclient_t * WebSocketsServerCore::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclien
       client->lastPing               = millis();
       client->pongReceived           = false;
 
+      client->cHandshakeStart        = millis();
+
+      if (_handshakeTimeout)
+      {
+        uint32_t deadline = client->cHandshakeStart + _handshakeTimeout;
+
+        if (!_handshakePending || ((int32_t) (deadline - _nextHandshakeExpiry) < 0))
+        {
+          _nextHandshakeExpiry = deadline;
+        }
+
+        _handshakePending = true;
+      }
+
+      _stats.clientsAccepted++;
+
       return client;
       break;
     }
   }
 
+  _stats.clientsRejected++;
+
   return nullptr;
 }
 
+/**
+   disconnect clients still in WSC_HEADER after _handshakeTimeout.
+   Only scans the slots once the earliest pending deadline has passed.
+*/
+void WebSocketsServerCore::expireHandshakes()
+{
+  if (!_handshakePending || !_handshakeTimeout)
+  {
+    return;
+  }
+
+  uint32_t now = millis();
+
+  if ((int32_t) (now - _nextHandshakeExpiry) < 0)
+  {
+    return;
+  }
+
+  WSclient_t * client;
+
+  _handshakePending = false;
+
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+  {
+    client = &_clients[i];
+
+    if (client->status != WSC_HEADER || !client->tcp)
+    {
+      continue;
+    }
+
+    uint32_t deadline = client->cHandshakeStart + _handshakeTimeout;
+
+    if ((int32_t) (now - deadline) >= 0)
+    {
+      WSK_LOGINFO3("[WS-Server] Handshake timeout. Client:", client->num, ", ms:", now - client->cHandshakeStart);
+
+      _stats.handshakeTimeouts++;
+      timeoutOccurred(client, WStimeout_handshake);
+      clientDisconnect(client);
+    }
+    else if (!_handshakePending || ((int32_t) (deadline - _nextHandshakeExpiry) < 0))
+    {
+      // still pending, track the earliest remaining deadline
+      _nextHandshakeExpiry = deadline;
+      _handshakePending    = true;
+    }
+  }
+}
+
 /**
 
    @param client WSclient_t *  ptr to the client struct
@@ -644,6 +959,16 @@ void WebSocketsServerCore::messageReceived(WSclient_t * client, WSopcode_t opcod
 {
   WStype_t type = WStype_ERROR;
 
+  if (!reassemble(client, &opcode, &payload, &length, &fin))
+  {
+    return;
+  }
+
+  if (batchMessage(client, opcode, payload, length, fin))
+  {
+    return;
+  }
+
   switch (opcode)
   {
     case WSop_text:
@@ -669,6 +994,33 @@ void WebSocketsServerCore::messageReceived(WSclient_t * client, WSopcode_t opcod
   runCbEvent(client->num, type, payload, length);
 }
 
+/**
+   report an expired timeout to the application, the connection is closed right after
+   @param client WSclient_t *     ptr to the client struct
+   @param timeout WStimeout_t
+*/
+void WebSocketsServerCore::timeoutOccurred(WSclient_t * client, WStimeout_t timeout)
+{
+  uint8_t payload = timeout;
+
+  batchFlush();
+  runCbEvent(client->num, WStype_TIMEOUT, &payload, 1);
+}
+
+/**
+   deliver the messages batched for a client
+   @param client WSclient_t *     ptr to the client struct
+   @param messages WSmessage_t *
+   @param count size_t
+*/
+void WebSocketsServerCore::batchReceived(WSclient_t * client, WSmessage_t * messages, size_t count)
+{
+  if (_cbBatchEvent)
+  {
+    _cbBatchEvent(client->num, messages, count);
+  }
+}
+
 /**
    Discard a native client
    @param client WSclient_t *  ptr to the client struct contaning the native client "->tcp"
@@ -700,6 +1052,9 @@ void WebSocketsServerCore::dropNativeClient(WSclient_t * client)
 */
 void WebSocketsServerCore::clientDisconnect(WSclient_t * client)
 {
+  // corked frames, the close frame among them, go out first
+  txRelease(client);
+
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || \
     (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
   if (client->isSSL && client->ssl)
@@ -718,9 +1073,17 @@ void WebSocketsServerCore::clientDisconnect(WSclient_t * client)
 
   dropNativeClient(client);
 
+  extensionRelease(client);
+  relayRelease(client);
+  writerRelease(client);
+  reassemblyRelease(client);
+  bulkRelease(client);
+  rxRelease(client);
+
   client->cUrl         = "";
   client->cKey         = "";
   client->cProtocol    = "";
+  client->cExtensions  = "";
   client->cVersion     = 0;
   client->cIsUpgrade   = false;
   client->cIsWebsocket = false;
@@ -737,6 +1100,7 @@ void WebSocketsServerCore::clientDisconnect(WSclient_t * client)
   WSK_LOGDEBUG1("Disconnected Client :", client->num);
   //WSK_LOGINFO1("Disconnected Client :", client->num);
 
+  batchFlush();
   runCbEvent(client->num, WStype_DISCONNECTED, NULL, 0);
 }
 
@@ -839,6 +1203,29 @@ void WebSocketsServer::handleNewClients()
 #endif
 }
 
+#if WEBSOCKETS_SOCKET_SNAPSHOT
+/*
+   established connection with nothing received according to the socket snapshot,
+   connected() is true and available() 0 for it without asking the chip again
+   @param client WSclient_t *
+   @param sockets const EthernetSocketStatus *   Ethernet.socketStatusSnapshot()
+   @param socketMask uint8_t   sockets in the snapshot
+*/
+static bool WS_SocketIdle(WSclient_t * client, const EthernetSocketStatus * sockets, uint8_t socketMask)
+{
+  if (!client->tcp || (client->status == WSC_NOT_CONNECTED) || (client->cRxPos != client->cRxLength))
+  {
+    return false;
+  }
+
+  uint8_t sock = client->tcp->getSocketNumber();
+
+  // 0x17 SnSR::ESTABLISHED
+  return (sock < MAX_SOCK_NUM) && (socketMask & (1 << sock)) && (sockets[sock].sr == 0x17) &&
+         (sockets[sock].rxSize == 0);
+}
+#endif
+
 /**
    Handel incomming data from Client
 */
@@ -848,6 +1235,29 @@ void WebSocketsServerCore::handleClientData()
   
   //static uint8_t currentActiveClient = 0xFF;
 
+  expireHandshakes();
+
+#if WEBSOCKETS_SOCKET_SNAPSHOT
+  // Sn_SR / Sn_RX_RSR of all client sockets up front, idle ones skip connected() and available()
+  EthernetSocketStatus sockets[MAX_SOCK_NUM];
+  uint8_t socketMask = 0;
+
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+  {
+    client = &_clients[i];
+
+    if (client->tcp && (client->status != WSC_NOT_CONNECTED) && (client->tcp->getSocketNumber() < MAX_SOCK_NUM))
+    {
+      socketMask |= (1 << client->tcp->getSocketNumber());
+    }
+  }
+
+  if (socketMask && (Ethernet.socketStatusSnapshot(sockets, socketMask) == 0))
+  {
+    socketMask = 0;
+  }
+#endif
+
   for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
   {
     client = &_clients[i];
@@ -855,11 +1265,17 @@ void WebSocketsServerCore::handleClientData()
     // KH New debug
     //displayClientData(client);
 
-    if (clientIsConnected(client))
+    bool idle = false;
+
+#if WEBSOCKETS_SOCKET_SNAPSHOT
+    idle = WS_SocketIdle(client, sockets, socketMask);
+#endif
+
+    if (idle || clientIsConnected(client))
     // KH Debug
     //if ( clientIsConnected(client) && client->cHttpHeadersValid )
     {
-      int len = client->tcp->available();
+      int len = idle ? 0 : rxAvailable(client);
 
       if (len > 0)
       {
@@ -896,7 +1312,7 @@ void WebSocketsServerCore::handleClientData()
             // KH New
             WSK_LOGINFO1("[handleClientData] Status WSC_CONNECTED. handleWebsocket. Client:", client->num);
 
-            WebSockets::handleWebsocket(client);
+            WebSockets::handleWebsocketBatch(client);
             
             break;
             
@@ -915,6 +1331,7 @@ void WebSocketsServerCore::handleClientData()
 
       handleHBPing(client);
       handleHBTimeout(client);
+      handleBulk(client);
     }
 
     WEBSOCKETS_YIELD();
@@ -923,20 +1340,132 @@ void WebSocketsServerCore::handleClientData()
 #endif    // #if (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
 
 /*
-   returns an indicator whether the given named header exists in the configured _mandatoryHttpHeaders collection
-   @param headerName String ///< the name of the header being checked
+   case-insensitive FNV-1a hash of a http header name, folded to 16 bit
+   @param headerName const char * ///< the name of the header, not null terminated
+   @param headerNameLen size_t
 */
-bool WebSocketsServerCore::hasMandatoryHeader(String headerName)
+static uint16_t WS_HeaderHash(const char * headerName, size_t headerNameLen)
 {
-  for (size_t i = 0; i < _mandatoryHttpHeaderCount; i++)
+  uint32_t hash = 2166136261UL;
+
+  for (size_t i = 0; i < headerNameLen; i++)
+  {
+    hash ^= (uint8_t) tolower(headerName[i]);
+    hash *= 16777619UL;
+  }
+
+  return (uint16_t) ((hash >> 16) ^ hash);
+}
+
+/*
+   adds one header name to _httpHeaderTable (open addressing, linear probing)
+   @param headerName const char *
+   @param id uint8_t ///< WSheaderId_t
+   @return false if the table is full
+*/
+bool WebSocketsServerCore::insertHttpHeader(const char * headerName, uint8_t id)
+{
+  uint16_t hash = WS_HeaderHash(headerName, strlen(headerName));
+
+  for (uint16_t n = 0; n < (WEBSOCKETS_SERVER_HEADER_HASH_SIZE - 1); n++)
   {
-    if (_mandatoryHttpHeaders[i].equalsIgnoreCase(headerName))
+    WSheaderSlot_t * slot = &_httpHeaderTable[(hash + n) & (WEBSOCKETS_SERVER_HEADER_HASH_SIZE - 1)];
+
+    if (slot->id == WSheader_none)
+    {
+      slot->hash = hash;
+      slot->id   = id;
+
       return true;
+    }
   }
 
+  // keep at least one empty slot, so a failed lookup always terminates
   return false;
 }
 
+/*
+   (re)builds _httpHeaderTable from the websocket headers and the configured _mandatoryHttpHeaders
+*/
+void WebSocketsServerCore::buildHttpHeaderTable()
+{
+  memset(_httpHeaderTable, 0, sizeof(_httpHeaderTable));
+  _httpHeaderTableFull = false;
+
+  insertHttpHeader("Connection",               WSheader_connection);
+  insertHttpHeader("Upgrade",                  WSheader_upgrade);
+  insertHttpHeader("Sec-WebSocket-Version",    WSheader_version);
+  insertHttpHeader("Sec-WebSocket-Key",        WSheader_key);
+  insertHttpHeader("Sec-WebSocket-Protocol",   WSheader_protocol);
+  insertHttpHeader("Sec-WebSocket-Extensions", WSheader_extensions);
+  insertHttpHeader("Authorization",            WSheader_authorization);
+
+  for (size_t i = 0; i < _mandatoryHttpHeaderCount; i++)
+  {
+    if ( ((WSheader_mandatory + i) > 0xFF) || !insertHttpHeader(_mandatoryHttpHeaders[i].c_str(), WSheader_mandatory + i) )
+    {
+      WSK_LOGWARN1("[WS-Server] http header table full, linear search from mandatory header", i);
+
+      _httpHeaderTableFull = true;
+      break;
+    }
+  }
+}
+
+/*
+   returns the WSheaderId_t of the given header name, WSheader_none if the server does not watch it
+   @param headerName const char * ///< the name of the header being checked, not null terminated
+   @param headerNameLen size_t
+*/
+uint8_t WebSocketsServerCore::lookupHttpHeader(const char * headerName, size_t headerNameLen)
+{
+  static const char * const WS_HEADER_NAMES[WSheader_mandatory] =
+  {
+    NULL, "Connection", "Upgrade", "Sec-WebSocket-Version", "Sec-WebSocket-Key",
+    "Sec-WebSocket-Protocol", "Sec-WebSocket-Extensions", "Authorization"
+  };
+
+  uint16_t hash = WS_HeaderHash(headerName, headerNameLen);
+
+  for (uint16_t n = 0; n < WEBSOCKETS_SERVER_HEADER_HASH_SIZE; n++)
+  {
+    WSheaderSlot_t * slot = &_httpHeaderTable[(hash + n) & (WEBSOCKETS_SERVER_HEADER_HASH_SIZE - 1)];
+
+    if (slot->id == WSheader_none)
+    {
+      break;
+    }
+
+    if (slot->hash != hash)
+    {
+      continue;
+    }
+
+    // same hash, verify the name itself
+    const char * name = (slot->id < WSheader_mandatory) ? WS_HEADER_NAMES[slot->id] :
+                        _mandatoryHttpHeaders[slot->id - WSheader_mandatory].c_str();
+
+    if ( (strlen(name) == headerNameLen) && (strncasecmp(name, headerName, headerNameLen) == 0) )
+    {
+      return slot->id;
+    }
+  }
+
+  if (_httpHeaderTableFull)
+  {
+    for (size_t i = 0; i < _mandatoryHttpHeaderCount; i++)
+    {
+      if ( (_mandatoryHttpHeaders[i].length() == headerNameLen) &&
+           (strncasecmp(_mandatoryHttpHeaders[i].c_str(), headerName, headerNameLen) == 0) )
+      {
+        return WSheader_mandatory;
+      }
+    }
+  }
+
+  return WSheader_none;
+}
+
 /**
    handles http header reading for WebSocket upgrade
    @param client WSclient_t * ///< pointer to the client struct
@@ -975,8 +1504,11 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
     }
     else if (headerLine->indexOf(':') >= 0)
     {
-      String headerName  = headerLine->substring(0, headerLine->indexOf(':'));
-      String headerValue = headerLine->substring(headerLine->indexOf(':') + 1);
+      int colon = headerLine->indexOf(':');
+
+      uint8_t headerId = lookupHttpHeader(headerLine->c_str(), colon);
+
+      String headerValue = headerLine->substring(colon + 1);
 
       // remove space in the beginning (RFC2616)
       if (headerValue[0] == ' ')
@@ -984,51 +1516,60 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
         headerValue.remove(0, 1);
       }
 
-      if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Connection")))
-      {
-        headerValue.toLowerCase();
+      // the line itself is not needed anymore, keep only the name in it
+      headerLine->remove(colon);
+      const String & headerName = *headerLine;
 
-        if (headerValue.indexOf(WEBSOCKETS_STRING("upgrade")) >= 0)
-        {
-          client->cIsUpgrade = true;
-        }
-      }
-      else if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Upgrade")))
-      {
-        if (headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("websocket")))
-        {
-          client->cIsWebsocket = true;
-        }
-      }
-      else if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Version")))
-      {
-        client->cVersion = headerValue.toInt();
-      }
-      else if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Key")))
+      switch (headerId)
       {
-        client->cKey = headerValue;
-        client->cKey.trim();    // see rfc6455
-      }
-      else if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Protocol")))
-      {
-        client->cProtocol = headerValue;
-      }
-      else if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Extensions")))
-      {
-        client->cExtensions = headerValue;
-      }
-      else if (headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Authorization")))
-      {
-        client->base64Authorization = headerValue;
-      }
-      else
-      {
-        client->cHttpHeadersValid &= execHttpHeaderValidation(headerName, headerValue);
+        case WSheader_connection:
+          headerValue.toLowerCase();
 
-        if (_mandatoryHttpHeaderCount > 0 && hasMandatoryHeader(headerName))
-        {
-          client->cMandatoryHeadersCount++;
-        }
+          if (headerValue.indexOf(WEBSOCKETS_STRING("upgrade")) >= 0)
+          {
+            client->cIsUpgrade = true;
+          }
+
+          break;
+
+        case WSheader_upgrade:
+          if (headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("websocket")))
+          {
+            client->cIsWebsocket = true;
+          }
+
+          break;
+
+        case WSheader_version:
+          client->cVersion = headerValue.toInt();
+          break;
+
+        case WSheader_key:
+          client->cKey = headerValue;
+          client->cKey.trim();    // see rfc6455
+          break;
+
+        case WSheader_protocol:
+          client->cProtocol = headerValue;
+          break;
+
+        case WSheader_extensions:
+          client->cExtensions = headerValue;
+          break;
+
+        case WSheader_authorization:
+          client->base64Authorization = headerValue;
+          break;
+
+        default:
+          client->cHttpHeadersValid &= execHttpHeaderValidation(headerName, headerValue);
+
+          if (headerId >= WSheader_mandatory)
+          {
+            client->cMandatoryHeadersCount++;
+          }
+
+          break;
       }
     }
     else
@@ -1132,6 +1673,14 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
         handshake += _protocol + NEW_LINE;
       }
 
+      String extensions;
+
+      if (extensionAccept(client, extensions))
+      {
+        handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
+        handshake += extensions + NEW_LINE;
+      }
+
       // header end
       handshake += NEW_LINE;
 
@@ -1176,6 +1725,106 @@ void WebSocketsServerCore::handleHBPing(WSclient_t * client)
   }
 }
 
+/**
+   set how the library waits for the connection while it reads or writes a frame
+   the transport blocks until the socket is ready (FreeRTOS notification, lwIP / poll() on a socket, ...),
+   on ESP32 lwIP select() is the default, elsewhere and with NULL the library polls
+   @param waitCb WSwaitCb   returns false for connections it can't wait for
+*/
+void WebSocketsServerCore::setWaitStrategy(WSwaitCb waitCb)
+{
+  _waitCb = waitCb;
+}
+
+/**
+   cork mode: frames to a client are gathered in a buffer of one TCP segment (WEBSOCKETS_TX_BUFFER_SIZE)
+   and written at the end of loop(), by flush() or when the buffer is full,
+   many small messages then share a packet instead of taking two writes each
+*/
+void WebSocketsServerCore::enableCork()
+{
+  _cork = true;
+}
+
+void WebSocketsServerCore::disableCork()
+{
+  flush();
+  _cork = false;
+}
+
+/**
+   write the corked frames of all clients now
+*/
+void WebSocketsServerCore::flush()
+{
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+  {
+    if (_clients[i].cTxLength && clientIsConnected(&_clients[i]))
+    {
+      txFlush(&_clients[i]);
+    }
+  }
+}
+
+/**
+   negotiate permessage-deflate (RFC 7692) with the clients connecting from now on
+   @param windowBits uint8_t          9..15, LZ77 window, RAM per compressing connection grows with 2^windowBits
+   @param memLevel uint8_t            1..9, encoder hash table of 2^(memLevel + 6) entries
+   @param noContextTakeover bool      every message is compressed on its own, nothing is kept between messages
+   @param minSize size_t              messages shorter than this are sent uncompressed
+*/
+void WebSocketsServerCore::enableCompression(uint8_t windowBits, uint8_t memLevel, bool noContextTakeover, size_t minSize)
+{
+  _deflate.configure(windowBits, memLevel, noContextTakeover, minSize);
+  addExtension(&_deflate);
+}
+
+void WebSocketsServerCore::disableCompression()
+{
+  removeExtension(&_deflate);
+}
+
+/**
+   negotiate an extension (RFC 6455 9) with the clients connecting from now on, in the order they were added
+   the extension object has to live as long as this instance
+   @param extension WebSocketsExtension *
+   @return false if there is no room left (WEBSOCKETS_MAX_EXTENSIONS) or one of its RSV bits is taken
+*/
+bool WebSocketsServerCore::addExtension(WebSocketsExtension * extension)
+{
+  return WebSockets::addExtension(extension);
+}
+
+void WebSocketsServerCore::removeExtension(WebSocketsExtension * extension)
+{
+  WebSockets::removeExtension(extension);
+}
+
+/**
+   send bigger text and binary messages as a sequence of fragments (RFC 6455 5.4),
+   pings can go out between them and the peer never has to buffer more than one frame
+   @param maxFrameSize size_t   payload bytes per frame, 0 = every message in one frame
+*/
+void WebSocketsServerCore::setMaxFrameSize(size_t maxFrameSize)
+{
+  _maxFrameSize = maxFrameSize;
+}
+
+/**
+   deliver fragmented messages as one WStype_TEXT / WStype_BIN event instead of WStype_FRAGMENT_* events
+   every connection that receives a fragmented message reserves maxMessageSize + 1 bytes for it
+   @param maxMessageSize size_t   bigger messages fail the connection with 1009
+*/
+void WebSocketsServerCore::enableReassembly(size_t maxMessageSize)
+{
+  _reassemblySize = maxMessageSize;
+}
+
+void WebSocketsServerCore::disableReassembly()
+{
+  _reassemblySize = 0;
+}
+
 /**
    enable ping/pong heartbeat process
    @param pingInterval uint32_t how often ping will be sent
@@ -1197,6 +1846,34 @@ void WebSocketsServerCore::enableHeartbeat(uint32_t pingInterval, uint32_t pongT
   }
 }
 
+/**
+   set the max time from tcp accept to a complete upgrade request
+   clients exceeding it are disconnected and counted in getStats().handshakeTimeouts
+   @param handshakeTimeout uint32_t in ms, 0 => no deadline
+*/
+void WebSocketsServerCore::setHandshakeTimeout(uint32_t handshakeTimeout)
+{
+  _handshakeTimeout = handshakeTimeout;
+}
+
+/**
+   time a client may stall in the middle of a frame (or a handshake line) before it is dropped
+   @param readTimeout uint32_t   ms, WEBSOCKETS_TCP_TIMEOUT by default
+*/
+void WebSocketsServerCore::setReadTimeout(uint32_t readTimeout)
+{
+  _readTimeout = readTimeout;
+}
+
+/**
+   time the network driver may refuse data of a frame before the client is dropped
+   @param writeTimeout uint32_t   ms, WEBSOCKETS_TCP_TIMEOUT by default
+*/
+void WebSocketsServerCore::setWriteTimeout(uint32_t writeTimeout)
+{
+  _writeTimeout = writeTimeout;
+}
+
 /**
    disable ping/pong heartbeat process
 */
@@ -1252,6 +1929,11 @@ void WebSocketsServerCore::loop()
   {
     WEBSOCKETS_YIELD();
     handleClientData();
+
+    if (_cork)
+    {
+      flush();
+    }
   }
 }
 
@@ -63,6 +63,42 @@
   #define WEBSOCKETS_SERVER_CLIENT_MAX (5)
 #endif
 
+// slots of the case-insensitive http header lookup table, must be a power of 2
+#ifndef WEBSOCKETS_SERVER_HEADER_HASH_SIZE
+  #define WEBSOCKETS_SERVER_HEADER_HASH_SIZE (32)
+#endif
+
+// max time a client may take from tcp accept to a complete upgrade request, 0 means "no deadline"
+#ifndef WEBSOCKETS_SERVER_HANDSHAKE_TIMEOUT
+  #define WEBSOCKETS_SERVER_HANDSHAKE_TIMEOUT (2 * WEBSOCKETS_TCP_TIMEOUT)
+#endif
+
+typedef struct
+{
+  uint32_t clientsAccepted;      ///< tcp connections given a slot
+  uint32_t clientsRejected;      ///< tcp connections dropped because all slots were in use
+  uint32_t handshakeTimeouts;    ///< slots freed because the upgrade request did not complete in time
+} WSserverStats_t;
+
+typedef enum
+{
+  WSheader_none = 0,           ///< header not watched by the server
+  WSheader_connection,
+  WSheader_upgrade,
+  WSheader_version,
+  WSheader_key,
+  WSheader_protocol,
+  WSheader_extensions,
+  WSheader_authorization,
+  WSheader_mandatory           ///< first mandatory header, WSheader_mandatory + n for _mandatoryHttpHeaders[n]
+} WSheaderId_t;
+
+typedef struct
+{
+  uint16_t hash;
+  uint8_t id;    ///< WSheaderId_t, WSheader_none marks an empty slot
+} WSheaderSlot_t;
+
 class WebSocketsServerCore : protected WebSockets 
 {
   public:
@@ -77,10 +113,21 @@ class WebSocketsServerCore : protected WebSockets
     typedef bool (*WebSocketServerHttpHeaderValFunc)(String headerName, String headerValue);
 #else
     typedef std::function<void(uint8_t num, WStype_t type, uint8_t * payload, size_t length)> WebSocketServerEvent;
-    typedef std::function<bool(String headerName, String headerValue)> WebSocketServerHttpHeaderValFunc;
+    typedef std::function<bool(const String & headerName, const String & headerValue)> WebSocketServerHttpHeaderValFunc;
+#endif
+
+#ifdef __AVR__
+    typedef void (*WebSocketServerBatchEvent)(uint8_t num, WSmessage_t * messages, size_t count);
+#else
+    typedef std::function<void(uint8_t num, WSmessage_t * messages, size_t count)> WebSocketServerBatchEvent;
 #endif
 
     void onEvent(WebSocketServerEvent cbEvent);
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    bool onBatchEvent(WebSocketServerBatchEvent cbBatchEvent, size_t bufferSize = WEBSOCKETS_BATCH_BUFFER_SIZE,
+                      uint16_t maxMessages = WEBSOCKETS_BATCH_MAX_MESSAGES);
+#endif
     void onValidateHttpHeader(
         WebSocketServerHttpHeaderValFunc validationFunc,
         const char * mandatoryHttpHeaders[],
@@ -101,6 +148,21 @@ class WebSocketsServerCore : protected WebSockets
     bool sendBIN(uint8_t num, uint8_t * payload, size_t length, bool headerToPayload = false);
     bool sendBIN(uint8_t num, const uint8_t * payload, size_t length);
 
+    bool queueTXT(uint8_t num, const char * payload, size_t length = 0);
+    bool queueBIN(uint8_t num, const uint8_t * payload, size_t length);
+
+    bool beginTXT(uint8_t num, WebSocketsWriter & writer);
+    bool beginBIN(uint8_t num, WebSocketsWriter & writer);
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    void setRelay(WebSocketsRelay * relay);
+    void setRelay(uint8_t num, WebSocketsRelay * relay);
+    bool addRelayTarget(WebSocketsRelay & relay);
+    bool addRelayTarget(WebSocketsRelay & relay, uint8_t num);
+    void removeRelayTarget(WebSocketsRelay & relay);
+    bool removeRelayTarget(WebSocketsRelay & relay, uint8_t num);
+#endif
+
     bool broadcastBIN(uint8_t * payload, size_t length, bool headerToPayload = false);
     bool broadcastBIN(const uint8_t * payload, size_t length);
 
@@ -123,6 +185,32 @@ class WebSocketsServerCore : protected WebSockets
     void enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void disableHeartbeat();
 
+    void setHandshakeTimeout(uint32_t handshakeTimeout);
+    void setReadTimeout(uint32_t readTimeout);
+    void setWriteTimeout(uint32_t writeTimeout);
+
+    void setWaitStrategy(WSwaitCb waitCb);
+
+    void enableCork();
+    void disableCork();
+    void flush();
+
+    void enableCompression(uint8_t windowBits = 10, uint8_t memLevel = 2, bool noContextTakeover = true, size_t minSize = 64);
+    void disableCompression();
+
+    bool addExtension(WebSocketsExtension * extension);
+    void removeExtension(WebSocketsExtension * extension);
+
+    void setMaxFrameSize(size_t maxFrameSize);
+
+    void enableReassembly(size_t maxMessageSize = WEBSOCKETS_MAX_DATA_SIZE);
+    void disableReassembly();
+
+    const WSserverStats_t & getStats()
+    {
+      return _stats;
+    }
+
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)\
      || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RTL8720DN)
     IPAddress remoteIP(uint8_t num);
@@ -149,15 +237,27 @@ class WebSocketsServerCore : protected WebSockets
     WSclient_t _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
 
     WebSocketServerEvent _cbEvent;
+    WebSocketServerBatchEvent _cbBatchEvent;
     WebSocketServerHttpHeaderValFunc _httpHeaderValidationFunc;
 
+    WSheaderSlot_t _httpHeaderTable[WEBSOCKETS_SERVER_HEADER_HASH_SIZE];
+    bool _httpHeaderTableFull;    ///< some mandatory headers did not fit, fall back to a linear search
+
     bool _runnning;
 
     uint32_t _pingInterval;
     uint32_t _pongTimeout;
     uint8_t _disconnectTimeoutCount;
 
+    uint32_t _handshakeTimeout;
+    uint32_t _nextHandshakeExpiry;    ///< earliest deadline of a pending handshake
+    bool _handshakePending;
+
+    WSserverStats_t _stats;
+
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
+    void timeoutOccurred(WSclient_t * client, WStimeout_t timeout);
+    void batchReceived(WSclient_t * client, WSmessage_t * messages, size_t count);
 
     void clientDisconnect(WSclient_t * client);
     bool clientIsConnected(WSclient_t * client);
@@ -166,10 +266,14 @@ class WebSocketsServerCore : protected WebSockets
     void handleClientData();
 #endif
 
+    void expireHandshakes();    // free slots whose upgrade request did not complete in time
+
     void handleHeader(WSclient_t * client, String * headerLine);
 
     void handleHBPing(WSclient_t * client);    // send ping in specified intervals
 
+    bool broadcastFrame(WSopcode_t opcode, uint8_t * payload, size_t length, bool headerToPayload);
+
     /**
          * called if a non Websocket connection is coming in.
          * Note: can be override
@@ -234,6 +338,7 @@ class WebSocketsServerCore : protected WebSockets
          * socket negotiation is considered invalid and the upgrade to websockets request is denied / rejected
          * This mechanism can be used to enable custom authentication schemes e.g. test the value
          * of a session cookie to determine if a user is logged on / authenticated
+         * Note: can be override, the Strings are passed by value as before
          */
     virtual bool execHttpHeaderValidation(String headerName, String headerValue) 
     {
@@ -258,10 +363,18 @@ class WebSocketsServerCore : protected WebSockets
 
   private:
     /*
-         * returns an indicator whether the given named header exists in the configured _mandatoryHttpHeaders collection
-         * @param headerName String ///< the name of the header being checked
+         * (re)builds _httpHeaderTable from the websocket headers and the configured _mandatoryHttpHeaders
          */
-    bool hasMandatoryHeader(String headerName);
+    void buildHttpHeaderTable();
+
+    bool insertHttpHeader(const char * headerName, uint8_t id);
+
+    /*
+         * returns the WSheaderId_t of the given header name, WSheader_none if the server does not watch it
+         * @param headerName const char * ///< the name of the header being checked, not null terminated
+         * @param headerNameLen size_t
+         */
+    uint8_t lookupHttpHeader(const char * headerName, size_t headerNameLen);
 };
 
 class WebSocketsServer : public WebSocketsServerCore 
@@ -0,0 +1,171 @@
+/****************************************************************************************************************************
+  WebSocketsWriter_Generic-Impl.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_WRITER_GENERIC_IMPL_H_
+#define WEBSOCKETS_WRITER_GENERIC_IMPL_H_
+
+/**
+   @param bufferSize size_t   payload bytes per fragment, reserved at the first begin
+*/
+WebSocketsWriter::WebSocketsWriter(size_t bufferSize)
+{
+  _size = (bufferSize > 0) ? bufferSize : 1;
+}
+
+/**
+   a message that is still open is ended
+*/
+WebSocketsWriter::~WebSocketsWriter()
+{
+  end();
+
+  if (_buffer)
+  {
+    free(_buffer);
+    _buffer = NULL;
+  }
+}
+
+/**
+   start a message, called by WebSockets::beginMessage()
+   @param ws WebSockets *
+   @param client WSclient_t *   ptr to the client struct
+   @param opcode WSopcode_t     WSop_text or WSop_binary
+   @return true if ok
+*/
+bool WebSocketsWriter::begin(WebSockets * ws, WSclient_t * client, WSopcode_t opcode)
+{
+  if (_ws)
+  {
+    WSK_LOGERROR("[WebSocketsWriter] Message not ended");
+    return false;
+  }
+
+  if (!_buffer)
+  {
+    _buffer = (uint8_t *) malloc(_size + WEBSOCKETS_MAX_HEADER_SIZE);
+
+    if (!_buffer)
+    {
+      WSK_LOGERROR1("[WebSocketsWriter] Can't malloc buffer. Size:", _size + WEBSOCKETS_MAX_HEADER_SIZE);
+      return false;
+    }
+  }
+
+  _ws     = ws;
+  _client = client;
+  _opcode = opcode;
+  _length = 0;
+
+  // other messages wait until end()
+  client->cWriter = this;
+
+  return true;
+}
+
+/**
+   send what is in the buffer as the next frame
+   @param fin bool   last frame of the message
+   @return true if ok, the writer is closed otherwise
+*/
+bool WebSocketsWriter::sendBuffer(bool fin)
+{
+  bool ret = (_client->status == WSC_CONNECTED) &&
+             _ws->sendFrame(_client, _opcode, _buffer, _length, fin, true);
+
+  _opcode = WSop_continuation;
+  _length = 0;
+
+  if (!ret || fin)
+  {
+    _client->cWriter = NULL;
+
+    _ws     = NULL;
+    _client = NULL;
+  }
+
+  return ret;
+}
+
+size_t WebSocketsWriter::write(uint8_t data)
+{
+  return write(&data, 1);
+}
+
+/**
+   add to the message, a full buffer is sent as a fragment
+   @param data const uint8_t *
+   @param length size_t
+   @return size_t   bytes taken, less than length if the connection failed
+*/
+size_t WebSocketsWriter::write(const uint8_t * data, size_t length)
+{
+  size_t written = 0;
+
+  while (_ws && (written < length))
+  {
+    if (_length == _size)
+    {
+      // more is coming, so this can't be the last frame
+      if (!sendBuffer(false))
+      {
+        break;
+      }
+    }
+
+    size_t n = (length - written);
+
+    if (n > (_size - _length))
+    {
+      n = (_size - _length);
+    }
+
+    memcpy((_buffer + WEBSOCKETS_MAX_HEADER_SIZE + _length), (data + written), n);
+
+    _length += n;
+    written += n;
+  }
+
+  return written;
+}
+
+/**
+   send the rest of the message as its last frame
+   @return true if the whole message was sent
+*/
+bool WebSocketsWriter::end()
+{
+  if (!_ws)
+  {
+    return false;
+  }
+
+  return sendBuffer(true);
+}
+
+#endif    // WEBSOCKETS_WRITER_GENERIC_IMPL_H_
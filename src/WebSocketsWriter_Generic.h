@@ -0,0 +1,84 @@
+/****************************************************************************************************************************
+  WebSocketsWriter_Generic.h - WebSockets Library for boards
+
+  Based on and modified from WebSockets libarary https://github.com/Links2004/arduinoWebSockets
+  to support other boards such as  SAMD21, SAMD51, Adafruit's nRF52 boards, etc.
+
+  Built by Khoi Hoang https://github.com/khoih-prog/WebSockets_Generic
+  Licensed under MIT license
+
+  Streaming writer: a message is sent in fragments while it is written, only the
+  writer's buffer is held in RAM.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Version: 2.8.0
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef WEBSOCKETS_WRITER_GENERIC_H_
+#define WEBSOCKETS_WRITER_GENERIC_H_
+
+// payload bytes a writer gathers before they go out as a fragment
+#ifndef WEBSOCKETS_WRITER_BUFFER_SIZE
+  #define WEBSOCKETS_WRITER_BUFFER_SIZE     (256)
+#endif
+
+/**
+   writes one text or binary message of any length
+   opened with beginTXT() / beginBIN() of the server or the client, everything written goes out
+   as a fragment whenever the buffer is full, end() sends the last one
+   until end() no other text or binary message goes to the same connection, sendTXT() / sendBIN()
+   return false and queued bulk messages wait
+*/
+class WebSocketsWriter : public Print
+{
+  public:
+    WebSocketsWriter(size_t bufferSize = WEBSOCKETS_WRITER_BUFFER_SIZE);
+    virtual ~WebSocketsWriter();
+
+    size_t write(uint8_t data);
+    size_t write(const uint8_t * data, size_t length);
+    using Print::write;
+
+    bool end();
+
+    /**
+       @return true between begin and end() as long as nothing failed
+    */
+    bool isOpen()
+    {
+      return (_ws != NULL);
+    }
+
+  protected:
+    friend class WebSockets;
+
+    bool begin(WebSockets * ws, WSclient_t * client, WSopcode_t opcode);
+    bool sendBuffer(bool fin);
+
+    WebSockets * _ws     = NULL;
+    WSclient_t * _client = NULL;
+    WSopcode_t _opcode   = WSop_text;    ///< opcode of the next frame, WSop_continuation after the first one
+
+    uint8_t * _buffer = NULL;    ///< WEBSOCKETS_MAX_HEADER_SIZE bytes in front of the payload, kept for the next message
+    size_t _size;
+    size_t _length = 0;
+};
+
+#include "WebSocketsWriter_Generic-Impl.h"
+
+#endif    // WEBSOCKETS_WRITER_GENERIC_H_
@@ -138,8 +138,9 @@ void WebSockets::clientDisconnect(WSclient_t * client, uint16_t code, char * rea
    @param mask bool             add dummy mask to the frame (needed for web browser)
    @param maskkey uint8_t[4]    key used for payload
    @param fin bool              can be used to send data in more then one frame (set fin on the last frame)
+   @param rsv uint8_t           RSV1..3 bits (bit 6..4) owned by a negotiated extension
 */
-uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin) 
+uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin, uint8_t rsv) 
 {
   uint8_t headerSize;
 
@@ -172,7 +173,8 @@ uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t
     *headerPtr |= bit(7);    ///< set Fin
   }
 
-  *headerPtr |= opcode;    ///< set opcode
+  *headerPtr |= (rsv & 0x70);    ///< set RSV1..3
+  *headerPtr |= opcode;          ///< set opcode
   headerPtr++;
 
   // byte 1
@@ -267,9 +269,12 @@ bool WebSockets::sendFrameHeader(WSclient_t * client, WSopcode_t opcode, size_t
    @param fin bool              can be used to send data in more then one frame (set fin on the last frame)
    @param headerToPayload bool  set true if the payload has reserved 14 Byte at the beginning to dynamically 
                                 add the Header (payload neet to be in RAM!)
+   @param encoded bool          the payload already went through the extensions of the connection, it is sent as it is
+   @param rsv uint8_t           RSV bits the extensions set on the encoded payload
    @return true if ok
 */
-bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin, bool headerToPayload)
+bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin, bool headerToPayload,
+                           bool encoded, uint8_t rsv)
 {
   if (client->tcp && !client->tcp->connected())
   {
@@ -309,6 +314,22 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
   bool useInternBuffer = false;
   bool ret             = true;
 
+  if (!encoded && client->cExtensionList && ((opcode == WSop_text) || (opcode == WSop_binary) || (opcode == WSop_continuation)))
+  {
+    uint8_t * buffer;
+    size_t bufferLength;
+
+    if (extensionEncode(client, opcode, (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length, fin,
+                        &buffer, &bufferLength, &rsv))
+    {
+      // our own copy, room for the header and free to be masked
+      payloadPtr      = buffer;
+      length          = bufferLength;
+      headerToPayload = true;
+      useInternBuffer = true;
+    }
+  }
+
   // calculate header Size
   if (length < 126)
   {
@@ -368,7 +389,7 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     }
   }
 
-  createHeader(headerPtr, opcode, length, client->cIsClient, maskKey, fin);
+  createHeader(headerPtr, opcode, length, client->cIsClient, maskKey, fin, rsv);
 
   if (client->cIsClient && useInternBuffer)
   {
@@ -425,611 +446,2193 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
   WSK_LOGDEBUG3("[handleWebsocketWaitFor] Sending Frame Done. Client: ", client->num, ", (us):", (micros() - start)); 
 #endif  
 
-#ifdef WEBSOCKETS_USE_BIG_MEM
   if (useInternBuffer && payloadPtr)
   {
     free(payloadPtr);
   }
-#endif
 
   return ret;
 }
 
 /**
-   callen when HTTP header is done
-   @param client WSclient_t *  ptr to the client struct
+   send a text or binary message, split into frames of at most _maxFrameSize bytes
+   the message goes through the extensions as a whole before it is split (RFC 7692 6.1),
+   a heartbeat ping that falls due meanwhile is sent between the fragments
+   @param client WSclient_t *   ptr to the client struct
+   @param opcode WSopcode_t     WSop_text or WSop_binary
+   @param payload uint8_t *
+   @param length size_t
+   @param headerToPayload bool  (see sendFrame for more details)
+   @param encoded bool          (see sendFrame for more details)
+   @param rsv uint8_t
+   @return true if ok
 */
-void WebSockets::headerDone(WSclient_t * client)
+bool WebSockets::sendMessage(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool headerToPayload,
+                             bool encoded, uint8_t rsv)
 {
-  client->status    = WSC_CONNECTED;
-  client->cWsRXsize = 0;
-  
-  WSK_LOGDEBUG1("[headerDone] Header Handling Done. Client:", client->num);
+  if (messageBlocked(client))
+  {
+    WSK_LOGDEBUG1("[sendMessage] Another message is open. Client:", client->num);
+    return false;
+  }
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-  client->cHttpLine = "";
-  handleWebsocket(client);
-#endif
+  // a bulk message that is half sent can't be interrupted by another data message
+  bulkFinish(client);
+
+  if ((_maxFrameSize == 0) || (length <= _maxFrameSize))
+  {
+    return sendFrame(client, opcode, payload, length, true, headerToPayload, encoded, rsv);
+  }
+
+  uint8_t * data   = (payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0));
+  uint8_t * buffer = NULL;
+  size_t bufferLength;
+
+  if (!encoded && client->cExtensionList && extensionEncode(client, opcode, data, length, true, &buffer, &bufferLength, &rsv))
+  {
+    data   = (buffer + WEBSOCKETS_MAX_HEADER_SIZE);
+    length = bufferLength;
+  }
+
+  size_t offset = 0;
+  bool ret      = true;
+
+  while (ret)
+  {
+    size_t n = length - offset;
+
+    if (n > _maxFrameSize)
+    {
+      n = _maxFrameSize;
+    }
+
+    bool fin = ((offset + n) == length);
+
+    ret = sendFrame(client, (offset == 0) ? opcode : WSop_continuation, (data + offset), n, fin, false, true, (offset == 0) ? rsv : 0x00);
+
+    if (fin)
+    {
+      break;
+    }
+
+    offset += n;
+
+    // control frames may go between the fragments of a message
+    if (ret && client->pingInterval && ((millis() - client->lastPing) > client->pingInterval))
+    {
+      WSK_LOGDEBUG1("[sendMessage] Sending HB ping between fragments. Client:", client->num);
+
+      if (sendFrame(client, WSop_ping))
+      {
+        client->lastPing     = millis();
+        client->pongReceived = false;
+      }
+    }
+
+    WEBSOCKETS_YIELD();
+  }
+
+  if (buffer)
+  {
+    free(buffer);
+  }
+
+  return ret;
 }
 
 /**
-   handle the WebSocket stream
-   @param client WSclient_t *  ptr to the client struct
+   open a writer for a message that is sent in fragments while it is written
+   @param client WSclient_t *         ptr to the client struct
+   @param opcode WSopcode_t           WSop_text or WSop_binary
+   @param writer WebSocketsWriter &
+   @return true if ok
 */
-void WebSockets::handleWebsocket(WSclient_t * client)
+bool WebSockets::beginMessage(WSclient_t * client, WSopcode_t opcode, WebSocketsWriter & writer)
 {
-  if (client->cWsRXsize == 0) 
+  if (messageBlocked(client))
   {
-    handleWebsocketCb(client);
+    WSK_LOGDEBUG1("[beginMessage] Another message is open. Client:", client->num);
+    return false;
   }
+
+  bulkFinish(client);
+
+  return writer.begin(this, client, opcode);
 }
 
 /**
-   wait for
-   @param client
-   @param size
+   a text or binary message can't go in between the fragments of a message a writer
+   or a relay has open on the connection (RFC 6455 5.4)
+   @param client WSclient_t *   ptr to the client struct
+   @return true if a new message has to wait
 */
-bool WebSockets::handleWebsocketWaitFor(WSclient_t * client, size_t size)
+bool WebSockets::messageBlocked(WSclient_t * client)
 {
-  if (!client->tcp || !client->tcp->connected())
+  return (client->cWriter || client->cRelayOwner);
+}
+
+/**
+   close the writer that has a message open on a connection that goes away
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::writerRelease(WSclient_t * client)
+{
+  if (client->cWriter)
+  {
+    client->cWriter->_ws     = NULL;
+    client->cWriter->_client = NULL;
+    client->cWriter          = NULL;
+  }
+}
+
+/**
+   queue a bulk message, it is sent one fragment per loop()
+   control frames and interactive messages (sendTXT / sendBIN) go out in between,
+   so the heartbeat does not wait for the bulk transfer
+   @param client WSclient_t *   ptr to the client struct
+   @param opcode WSopcode_t     WSop_text or WSop_binary
+   @param payload const uint8_t *   copied
+   @param length size_t
+   @return false if the queue is full (WEBSOCKETS_BULK_QUEUE_MAX) or there is no RAM
+*/
+bool WebSockets::queueMessage(WSclient_t * client, WSopcode_t opcode, const uint8_t * payload, size_t length)
+{
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+  // no loop() to send it from
+  return sendMessage(client, opcode, (uint8_t *) payload, length);
+#else
+
+  if (client->cBulkCount >= WEBSOCKETS_BULK_QUEUE_MAX)
   {
+    WSK_LOGDEBUG1("[queueMessage] Bulk queue full. Client:", client->num);
     return false;
   }
 
-  if (size > WEBSOCKETS_MAX_HEADER_SIZE)
+  WSbulkMessage_t * message = (WSbulkMessage_t *) malloc(sizeof(WSbulkMessage_t));
+
+  if (!message)
   {
-    WSK_LOGDEBUG3("[handleWebsocketWaitFor] Client: ", client->num, ", size too big:", size);
-    
     return false;
   }
 
-  if (client->cWsRXsize >= size)
+  message->payload = (uint8_t *) malloc(length + WEBSOCKETS_MAX_HEADER_SIZE);
+
+  if (!message->payload)
   {
-    return true;
+    WSK_LOGERROR1("[queueMessage] Can't malloc buffer. Size:", length + WEBSOCKETS_MAX_HEADER_SIZE);
+
+    free(message);
+    return false;
   }
 
-  WSK_LOGDEBUG3("[handleWebsocketWaitFor] Client: ", client->num, ", size:", size);
-  WSK_LOGDEBUG1("cWsRXsize:", client->cWsRXsize);                  
-                    
-                    
-  readCb(client, &client->cWsHeader[client->cWsRXsize], (size - client->cWsRXsize), 
-      std::bind([](WebSockets * server, size_t size, WSclient_t * client, bool ok)
+  if (length)
   {
-    WSK_LOGDEBUG3("[handleWebsocketWaitFor][readCb] Client: ", client->num, ", size:", size);
-    WSK_LOGDEBUG1("ok:", ok);   
+    memcpy((message->payload + WEBSOCKETS_MAX_HEADER_SIZE), payload, length);
+  }
 
-    if (ok)
-    {
-      client->cWsRXsize = size;
-      server->handleWebsocketCb(client);
-    }
-    else
-    {
-      WSK_LOGDEBUG1("[readCb] failed. Client:", client->num);
-      
-      client->cWsRXsize = 0;
-      // timeout or error
-      server->clientDisconnect(client, 1002);
-    }
-  },
-  this, size, std::placeholders::_1, std::placeholders::_2));
-  return false;
-}
+  message->length  = length;
+  message->offset  = 0;
+  message->opcode  = opcode;
+  message->rsv     = 0x00;
+  message->encoded = false;
+  message->next    = NULL;
 
-void WebSockets::handleWebsocketCb(WSclient_t * client)
-{
-  if (!client->tcp || !client->tcp->connected())
+  WSbulkMessage_t ** last = &client->cBulkQueue;
+
+  while (*last)
   {
-    return;
+    last = &((*last)->next);
   }
 
-  uint8_t * buffer = client->cWsHeader;
+  *last = message;
+  client->cBulkCount++;
 
-  WSMessageHeader_t * header = &client->cWsHeaderDecode;
-  uint8_t * payload          = NULL;
+  return true;
+#endif
+}
 
-  uint8_t headerLen = 2;
+/**
+   send the next fragment of the first bulk message, called from loop()
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::handleBulk(WSclient_t * client)
+{
+  WSbulkMessage_t * message = client->cBulkQueue;
 
-  if (!handleWebsocketWaitFor(client, headerLen))
+  if (!message || (client->status != WSC_CONNECTED))
   {
     return;
   }
 
-  // split first 2 bytes in the data
-  header->fin    = ((*buffer >> 7) & 0x01);
-  header->rsv1   = ((*buffer >> 6) & 0x01);
-  header->rsv2   = ((*buffer >> 5) & 0x01);
-  header->rsv3   = ((*buffer >> 4) & 0x01);
-  header->opCode = (WSopcode_t)(*buffer & 0x0F);
-  buffer++;
-
-  header->mask       = ((*buffer >> 7) & 0x01);
-  header->payloadLen = (WSopcode_t)(*buffer & 0x7F);
-  buffer++;
+  if ((message->offset == 0) && messageBlocked(client))
+  {
+    // starts when the open message is done
+    return;
+  }
 
-  if (header->payloadLen == 126)
+  if (!message->encoded)
   {
-    headerLen += 2;
+    // the extensions see the messages in the order they are sent (context takeover)
+    uint8_t * buffer;
+    size_t bufferLength;
 
-    if (!handleWebsocketWaitFor(client, headerLen))
+    if (client->cExtensionList &&
+        extensionEncode(client, message->opcode, (message->payload + WEBSOCKETS_MAX_HEADER_SIZE), message->length, true,
+                        &buffer, &bufferLength, &message->rsv))
     {
-      return;
+      free(message->payload);
+
+      message->payload = buffer;
+      message->length  = bufferLength;
     }
 
-    header->payloadLen = buffer[0] << 8 | buffer[1];
-    buffer += 2;
+    message->encoded = true;
   }
-  else if (header->payloadLen == 127)
-  {
-    headerLen += 8;
-
-    // read 64bit integer as length
-    if (!handleWebsocketWaitFor(client, headerLen))
-    {
-      return;
-    }
 
-    if (buffer[0] != 0 || buffer[1] != 0 || buffer[2] != 0 || buffer[3] != 0)
-    {
-      // really too big!
-      header->payloadLen = 0xFFFFFFFF;
-    }
-    else
-    {
-      header->payloadLen = buffer[4] << 24 | buffer[5] << 16 | buffer[6] << 8 | buffer[7];
-    }
+  size_t n = message->length - message->offset;
+  size_t fragmentSize = (_maxFrameSize ? _maxFrameSize : WEBSOCKETS_BULK_FRAGMENT_SIZE);
 
-    buffer += 8;
+  if (n > fragmentSize)
+  {
+    n = fragmentSize;
   }
 
-  WSK_LOGDEBUG1("[handleWebsocket] ------- read massage frame ------- Client:", client->num);
+  bool first = (message->offset == 0);
+  bool fin   = ((message->offset + n) == message->length);
 
-  WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", fin:", header->fin); 
-  WSK_LOGDEBUG1("rsv1:",    header->rsv1);
-  WSK_LOGDEBUG1("rsv2:",    header->rsv2);  
-  WSK_LOGDEBUG1("rsv3:",    header->rsv3);  
-  WSK_LOGDEBUG1("opCode:",  header->opCode);               
-                    
-  WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", mask:", header->mask);
-  WSK_LOGDEBUG1("payloadLen:", header->payloadLen);
-  
-  
-  if (header->payloadLen > WEBSOCKETS_MAX_DATA_SIZE)
+  // the bytes in front of the fragment are sent already, the header takes their place
+  if (!sendFrame(client, first ? message->opcode : WSop_continuation, (message->payload + message->offset), n, fin, true, true,
+                 first ? message->rsv : 0x00))
   {
-    WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", payload too big:", header->payloadLen); 
-    
-    clientDisconnect(client, 1009);
+    bulkRelease(client);
     return;
   }
 
-  if (header->mask)
+  message->offset += n;
+
+  if (fin)
   {
-    headerLen += 4;
-    if (!handleWebsocketWaitFor(client, headerLen))
-    {
-      return;
-    }
+    client->cBulkQueue = message->next;
+    client->cBulkCount--;
 
-    header->maskKey = buffer;
-    buffer += 4;
+    free(message->payload);
+    free(message);
   }
+}
 
-  if (header->payloadLen > 0)
+/**
+   send the rest of a bulk message that is half sent
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::bulkFinish(WSclient_t * client)
+{
+  while (client->cBulkQueue && client->cBulkQueue->offset && (client->status == WSC_CONNECTED))
   {
-    // if text data we need one more
-    payload = (uint8_t *) malloc(header->payloadLen + 1);
-
-    if (!payload)
-    {
-      WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", No memory to handle payload", header->payloadLen);
-      
-      clientDisconnect(client, 1011);
-      return;
-    }
-
-    readCb(client, payload, header->payloadLen, std::bind(&WebSockets::handleWebsocketPayloadCb, 
-            this, std::placeholders::_1, std::placeholders::_2, payload));
+    handleBulk(client);
   }
-  else
+}
+
+/**
+   drop the bulk messages of a connection
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::bulkRelease(WSclient_t * client)
+{
+  while (client->cBulkQueue)
   {
-    handleWebsocketPayloadCb(client, true, NULL);
+    WSbulkMessage_t * message = client->cBulkQueue;
+
+    client->cBulkQueue = message->next;
+
+    free(message->payload);
+    free(message);
   }
+
+  client->cBulkCount = 0;
 }
 
-void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload)
+/**
+   make a connection a target of a relay
+   @param relay WebSocketsRelay &
+   @param client WSclient_t *   ptr to the client struct
+   @param slot bool             stay a target when the connection goes, for the next one of the slot
+   @return false if the relay has no room for it
+*/
+bool WebSockets::relayAdd(WebSocketsRelay & relay, WSclient_t * client, bool slot)
 {
-  WSMessageHeader_t * header = &client->cWsHeaderDecode;
-
-  if (ok)
-  {
-    if (header->payloadLen > 0)
-    {
-      payload[header->payloadLen] = 0x00;
+  return relay.add(this, client, slot);
+}
 
-      if (header->mask)
-      {
-        //decode XOR
+/**
+   a connection is no target of a relay any more, in the middle of a relayed message it gets its end
+   @param relay WebSocketsRelay &
+   @param client WSclient_t *   ptr to the client struct
+   @return false if it was no target
+*/
+bool WebSockets::relayRemove(WebSocketsRelay & relay, WSclient_t * client)
+{
+  return relay.remove(client);
+}
+
+/**
+   relay the text and binary messages a connection receives, a relayed message that is
+   half through is ended first
+   @param client WSclient_t *   ptr to the client struct
+   @param relay WebSocketsRelay *   NULL to hand the messages to the event handler again
+*/
+void WebSockets::relaySet(WSclient_t * client, WebSocketsRelay * relay)
+{
+  if (client->cRelay != relay)
+  {
+    relayFinish(client);
+
+    if (client->cRelay)
+    {
+      client->cRelay->unlink(client);
+    }
+
+    client->cRelay = relay;
+
+    if (relay)
+    {
+      relay->link(client);
+    }
+  }
+}
+
+/**
+   a fragmented message a connection relays breaks off, its targets get an empty final fragment
+   @param client WSclient_t *   ptr to the client struct of the source
+*/
+void WebSockets::relayFinish(WSclient_t * client)
+{
+  if (client->cRelaying && client->cRelay)
+  {
+    client->cRelay->finish(client);
+  }
+
+  client->cRelaying = false;
+}
+
+/**
+   relay state of a connection that goes away, as a source and as a target
+   a target added for the connection only is removed from its relays, one added for the slot stays
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::relayRelease(WSclient_t * client)
+{
+  relayFinish(client);
+
+  client->cRelayOwner = NULL;
+
+  for (WebSocketsRelay * relay = WebSocketsRelay::relays(); relay; relay = relay->_next)
+  {
+    relay->release(client, false);
+  }
+}
+
+/**
+   the client struct goes away or back to its initial state, no relay may point to it any more
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::relayDetach(WSclient_t * client)
+{
+  relaySet(client, NULL);
+
+  client->cRelayOwner = NULL;
+
+  for (WebSocketsRelay * relay = WebSocketsRelay::relays(); relay; relay = relay->_next)
+  {
+    relay->release(client, true);
+  }
+}
+
+/**
+   gather the fragments of a text or binary message when reassembly is enabled
+   the buffer is reserved at the first fragment for the largest allowed message and kept for the
+   following messages of the connection, nothing is reallocated while the fragments come in
+   @param client WSclient_t *   ptr to the client struct
+   @param opcode WSopcode_t *   replaced by WSop_text / WSop_binary when the message is complete
+   @param payload uint8_t **    replaced by the reassembled, zero terminated message
+   @param length size_t *
+   @param fin bool *
+   @return true if the event has to be delivered, false if the fragment was taken or the connection failed
+*/
+bool WebSockets::reassemble(WSclient_t * client, WSopcode_t * opcode, uint8_t ** payload, size_t * length, bool * fin)
+{
+  if ((_reassemblySize == 0) || (*opcode > WSop_binary))
+  {
+    return true;
+  }
+
+  if (*opcode != WSop_continuation)
+  {
+    if (*fin)
+    {
+      // not fragmented
+      return true;
+    }
+
+    if (client->cReassembly && (client->cReassemblySize != _reassemblySize))
+    {
+      // the limit was changed
+      reassemblyRelease(client);
+    }
+
+    if (!client->cReassembly)
+    {
+      client->cReassembly = (uint8_t *) malloc(_reassemblySize + 1);
+
+      if (!client->cReassembly)
+      {
+        WSK_LOGERROR1("[reassemble] Can't malloc buffer. Size:", _reassemblySize + 1);
+
+        clientDisconnect(client, 1011);
+        return false;
+      }
+
+      client->cReassemblySize = _reassemblySize;
+    }
+
+    client->cReassemblyOpcode = *opcode;
+    client->cReassemblyLength = 0;
+  }
+  else if (client->cReassemblyOpcode == WSop_continuation)
+  {
+    // the message started before reassembly was enabled
+    return true;
+  }
+
+  if ((client->cReassemblyLength + *length) > client->cReassemblySize)
+  {
+    WSK_LOGDEBUG1("[reassemble] Message too big. Client:", client->num);
+
+    clientDisconnect(client, 1009);
+    return false;
+  }
+
+  if (*length)
+  {
+    memcpy(client->cReassembly + client->cReassemblyLength, *payload, *length);
+    client->cReassemblyLength += *length;
+  }
+
+  if (!*fin)
+  {
+    return false;
+  }
+
+  client->cReassembly[client->cReassemblyLength] = 0x00;
+
+  *opcode  = client->cReassemblyOpcode;
+  *payload = client->cReassembly;
+  *length  = client->cReassemblyLength;
+
+  client->cReassemblyOpcode = WSop_continuation;
+
+  return true;
+}
+
+/**
+   free the reassembly buffer of a connection
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::reassemblyRelease(WSclient_t * client)
+{
+  if (client->cReassembly)
+  {
+    free(client->cReassembly);
+    client->cReassembly = NULL;
+  }
+
+  client->cReassemblySize   = 0;
+  client->cReassemblyLength = 0;
+  client->cReassemblyOpcode = WSop_continuation;
+}
+
+/**
+   allocate the batch buffer and the message views, batching is off if it fails
+   @param bufferSize size_t      payload bytes, each message takes its length + 1
+   @param maxMessages uint16_t   messages per batch
+   @return true if ok
+*/
+bool WebSockets::batchEnable(size_t bufferSize, uint16_t maxMessages)
+{
+  batchRelease();
+
+  if ((bufferSize == 0) || (maxMessages == 0))
+  {
+    return false;
+  }
+
+  _batchBuffer   = (uint8_t *) malloc(bufferSize);
+  _batchMessages = (WSmessage_t *) malloc(maxMessages * sizeof(WSmessage_t));
+
+  if (!_batchBuffer || !_batchMessages)
+  {
+    WSK_LOGERROR1("[batchEnable] Can't malloc buffer. Size:", bufferSize);
+
+    batchRelease();
+    return false;
+  }
+
+  _batchSize = bufferSize;
+  _batchMax  = maxMessages;
+
+  return true;
+}
+
+/**
+   free the batch buffer, gathered messages are dropped
+*/
+void WebSockets::batchRelease()
+{
+  if (_batchBuffer)
+  {
+    free(_batchBuffer);
+    _batchBuffer = NULL;
+  }
+
+  if (_batchMessages)
+  {
+    free(_batchMessages);
+    _batchMessages = NULL;
+  }
+
+  _batchSize   = 0;
+  _batchUsed   = 0;
+  _batchMax    = 0;
+  _batchCount  = 0;
+  _batchClient = NULL;
+}
+
+/**
+   room in the batch buffer for the payload of the frame in client->cWsHeaderDecode,
+   a complete text or binary message is read there instead of a buffer of its own
+   @param client WSclient_t *   ptr to the client struct
+   @return uint8_t *   NULL if the frame can't go to the batch as it is read
+*/
+uint8_t * WebSockets::batchReserve(WSclient_t * client)
+{
+  WSMessageHeader_t * header = &client->cWsHeaderDecode;
+
+  // extensions replace the payload while they decode it
+  if (!_batchBuffer || !header->fin || client->cExtensionList || ((header->opCode != WSop_text) && (header->opCode != WSop_binary)))
+  {
+    return NULL;
+  }
+
+  if (((_batchCount > 0) && (_batchClient != client)) || (_batchCount >= _batchMax) ||
+      ((header->payloadLen + 1) > (_batchSize - _batchUsed)))
+  {
+    return NULL;
+  }
+
+  return (_batchBuffer + _batchUsed);
+}
+
+/**
+   @param payload uint8_t *
+   @return true if the payload lies in the batch buffer and must not be freed
+*/
+bool WebSockets::batchOwns(uint8_t * payload)
+{
+  return (_batchBuffer && (payload >= _batchBuffer) && (payload < (_batchBuffer + _batchSize)));
+}
+
+/**
+   hand a received message to the batch when batching is on,
+   the messages gathered so far are delivered before any other event
+   @param client WSclient_t *   ptr to the client struct
+   @param opcode WSopcode_t
+   @param payload uint8_t *
+   @param length size_t
+   @param fin bool
+   @return true if the batch callback took the message
+*/
+bool WebSockets::batchMessage(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin)
+{
+  if (!_batchBuffer || !fin || ((opcode != WSop_text) && (opcode != WSop_binary)))
+  {
+    batchFlush();
+    return false;
+  }
+
+  WStype_t type = (opcode == WSop_text) ? WStype_TEXT : WStype_BIN;
+
+  if (batchAdd(client, type, payload, length))
+  {
+    return true;
+  }
+
+  batchFlush();
+
+  if (!batchAdd(client, type, payload, length))
+  {
+    // bigger than the batch buffer, delivered alone
+    WSmessage_t message = { type, payload, length };
+
+    batchReceived(client, &message, 1);
+  }
+
+  return true;
+}
+
+/**
+   add a message to the batch, a payload read into the room batchReserve() gave is not copied
+   @param client WSclient_t *   ptr to the client struct
+   @param type WStype_t
+   @param payload uint8_t *
+   @param length size_t
+   @return false if the batch has no room for it
+*/
+bool WebSockets::batchAdd(WSclient_t * client, WStype_t type, uint8_t * payload, size_t length)
+{
+  uint8_t * data = _batchBuffer + _batchUsed;
+
+  if (((_batchCount > 0) && (_batchClient != client)) || (_batchCount >= _batchMax))
+  {
+    return false;
+  }
+
+  if (payload != data)
+  {
+    if ((length + 1) > (_batchSize - _batchUsed))
+    {
+      return false;
+    }
+
+    if (length)
+    {
+      memcpy(data, payload, length);
+    }
+
+    data[length] = 0x00;
+  }
+
+  WSmessage_t * message = &_batchMessages[_batchCount++];
+
+  message->type    = type;
+  message->payload = data;
+  message->length  = length;
+
+  _batchUsed  += length + 1;
+  _batchClient = client;
+
+  return true;
+}
+
+/**
+   deliver the gathered messages with one call of the batch callback
+*/
+void WebSockets::batchFlush()
+{
+  uint16_t count = _batchCount;
+
+  if (count == 0)
+  {
+    return;
+  }
+
+  // the views stay valid while the callback runs, a disconnect from there finds the batch empty
+  _batchCount = 0;
+  _batchUsed  = 0;
+
+  batchReceived(_batchClient, _batchMessages, count);
+}
+
+/**
+   callen when HTTP header is done
+   @param client WSclient_t *  ptr to the client struct
+*/
+void WebSockets::headerDone(WSclient_t * client)
+{
+  client->status    = WSC_CONNECTED;
+  client->cWsRXsize = 0;
+  
+  WSK_LOGDEBUG1("[headerDone] Header Handling Done. Client:", client->num);
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+  client->cHttpLine = "";
+  handleWebsocket(client);
+#endif
+}
+
+/**
+   handle the WebSocket stream
+   @param client WSclient_t *  ptr to the client struct
+*/
+void WebSockets::handleWebsocket(WSclient_t * client)
+{
+  if (client->cWsRXsize == 0) 
+  {
+    handleWebsocketCb(client);
+  }
+}
+
+/**
+   wait for
+   @param client
+   @param size
+*/
+bool WebSockets::handleWebsocketWaitFor(WSclient_t * client, size_t size)
+{
+  if (!client->tcp || !client->tcp->connected())
+  {
+    return false;
+  }
+
+  if (size > WEBSOCKETS_MAX_HEADER_SIZE)
+  {
+    WSK_LOGDEBUG3("[handleWebsocketWaitFor] Client: ", client->num, ", size too big:", size);
+    
+    return false;
+  }
+
+  if (client->cWsRXsize >= size)
+  {
+    return true;
+  }
+
+  WSK_LOGDEBUG3("[handleWebsocketWaitFor] Client: ", client->num, ", size:", size);
+  WSK_LOGDEBUG1("cWsRXsize:", client->cWsRXsize);                  
+                    
+                    
+  readCb(client, &client->cWsHeader[client->cWsRXsize], (size - client->cWsRXsize), 
+      std::bind([](WebSockets * server, size_t size, WSclient_t * client, bool ok)
+  {
+    WSK_LOGDEBUG3("[handleWebsocketWaitFor][readCb] Client: ", client->num, ", size:", size);
+    WSK_LOGDEBUG1("ok:", ok);   
+
+    if (ok)
+    {
+      client->cWsRXsize = size;
+      server->handleWebsocketCb(client);
+    }
+    else
+    {
+      WSK_LOGDEBUG1("[readCb] failed. Client:", client->num);
+      
+      client->cWsRXsize = 0;
+      // timeout or error
+      server->clientDisconnect(client, 1002);
+    }
+  },
+  this, size, std::placeholders::_1, std::placeholders::_2));
+  return false;
+}
+
+void WebSockets::handleWebsocketCb(WSclient_t * client)
+{
+  if (!client->tcp || !client->tcp->connected())
+  {
+    return;
+  }
+
+  uint8_t * buffer = client->cWsHeader;
+
+  WSMessageHeader_t * header = &client->cWsHeaderDecode;
+  uint8_t * payload          = NULL;
+
+  uint8_t headerLen = 2;
+
+  if (!handleWebsocketWaitFor(client, headerLen))
+  {
+    return;
+  }
+
+  // split first 2 bytes in the data
+  header->fin    = ((*buffer >> 7) & 0x01);
+  header->rsv1   = ((*buffer >> 6) & 0x01);
+  header->rsv2   = ((*buffer >> 5) & 0x01);
+  header->rsv3   = ((*buffer >> 4) & 0x01);
+  header->opCode = (WSopcode_t)(*buffer & 0x0F);
+  buffer++;
+
+  header->mask       = ((*buffer >> 7) & 0x01);
+  header->payloadLen = (WSopcode_t)(*buffer & 0x7F);
+  buffer++;
+
+  if (header->payloadLen == 126)
+  {
+    headerLen += 2;
+
+    if (!handleWebsocketWaitFor(client, headerLen))
+    {
+      return;
+    }
+
+    header->payloadLen = buffer[0] << 8 | buffer[1];
+    buffer += 2;
+  }
+  else if (header->payloadLen == 127)
+  {
+    headerLen += 8;
+
+    // read 64bit integer as length
+    if (!handleWebsocketWaitFor(client, headerLen))
+    {
+      return;
+    }
+
+    if (buffer[0] != 0 || buffer[1] != 0 || buffer[2] != 0 || buffer[3] != 0)
+    {
+      // really too big!
+      header->payloadLen = 0xFFFFFFFF;
+    }
+    else
+    {
+      header->payloadLen = buffer[4] << 24 | buffer[5] << 16 | buffer[6] << 8 | buffer[7];
+    }
+
+    buffer += 8;
+  }
+
+  WSK_LOGDEBUG1("[handleWebsocket] ------- read massage frame ------- Client:", client->num);
+
+  WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", fin:", header->fin); 
+  WSK_LOGDEBUG1("rsv1:",    header->rsv1);
+  WSK_LOGDEBUG1("rsv2:",    header->rsv2);  
+  WSK_LOGDEBUG1("rsv3:",    header->rsv3);  
+  WSK_LOGDEBUG1("opCode:",  header->opCode);               
+                    
+  WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", mask:", header->mask);
+  WSK_LOGDEBUG1("payloadLen:", header->payloadLen);
+  
+  uint8_t rsv = ((header->rsv1 ? WEBSOCKETS_RSV1 : 0) | (header->rsv2 ? WEBSOCKETS_RSV2 : 0) | (header->rsv3 ? WEBSOCKETS_RSV3 : 0));
+
+  // RSV bits need a negotiated extension that gave them a meaning, none of ours uses them on control frames
+  if (rsv && ((rsv & ~client->cExtensionRsv) || (header->opCode >= WSop_close)))
+  {
+    WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", unexpected RSV bits, opCode:", header->opCode);
+
+    clientDisconnect(client, 1002);
+    return;
+  }
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+  // compressed frames of a streaming session never need the whole payload in memory
+  bool streamed = (client->cDeflate && client->cDeflate->stream && (client->cExtensionList == client->cDeflate) && !client->cDeflate->next &&
+                   (header->rsv1 || (client->cDeflate->rxMessage && (header->opCode == WSop_continuation))));
+#else
+  bool streamed = false;
+#endif
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+  // data frames of a relay source go to the targets as they come in, see WebSocketsRelay
+  bool relayed = (client->cRelay && (header->opCode == WSop_continuation ? client->cRelaying :
+                                     (((header->opCode == WSop_text) || (header->opCode == WSop_binary)) && !rsv)));
+
+  if (client->cRelaying && ((header->opCode == WSop_text) || (header->opCode == WSop_binary)))
+  {
+    WSK_LOGDEBUG1("[handleWebsocket] New message in the middle of a relayed one. Client:", client->num);
+
+    clientDisconnect(client, 1002);
+    return;
+  }
+#else
+  bool relayed = false;
+#endif
+
+  if (!streamed && !relayed && (header->payloadLen > WEBSOCKETS_MAX_DATA_SIZE))
+  {
+    WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", payload too big:", header->payloadLen); 
+    
+    clientDisconnect(client, 1009);
+    return;
+  }
+
+  if (header->mask)
+  {
+    headerLen += 4;
+    if (!handleWebsocketWaitFor(client, headerLen))
+    {
+      return;
+    }
+
+    header->maskKey = buffer;
+    buffer += 4;
+  }
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+  if (streamed)
+  {
+    handleWebsocketStream(client);
+    return;
+  }
+
+  if (relayed)
+  {
+    handleWebsocketRelay(client);
+    return;
+  }
+#endif
+
+  if (header->payloadLen > 0)
+  {
+    // if text data we need one more
+    payload = batchReserve(client);
+
+    if (!payload)
+    {
+      payload = (uint8_t *) malloc(header->payloadLen + 1);
+    }
+
+    if (!payload)
+    {
+      WSK_LOGDEBUG3("[handleWebsocket] Client: ", client->num, ", No memory to handle payload", header->payloadLen);
+      
+      clientDisconnect(client, 1011);
+      return;
+    }
+
+    readCb(client, payload, header->payloadLen, std::bind(&WebSockets::handleWebsocketPayloadCb, 
+            this, std::placeholders::_1, std::placeholders::_2, payload));
+  }
+  else
+  {
+    handleWebsocketPayloadCb(client, true, NULL);
+  }
+}
+
+void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload)
+{
+  WSMessageHeader_t * header = &client->cWsHeaderDecode;
+
+  if (ok)
+  {
+    if (header->payloadLen > 0)
+    {
+      payload[header->payloadLen] = 0x00;
+
+      if (header->mask)
+      {
+        //decode XOR
         for (size_t i = 0; i < header->payloadLen; i++)
         {
-          payload[i] = (payload[i] ^ header->maskKey[i % 4]);
+          payload[i] = (payload[i] ^ header->maskKey[i % 4]);
+        }
+      }
+    }
+
+    if (client->cExtensionList && ((header->opCode == WSop_text) || (header->opCode == WSop_binary) || (header->opCode == WSop_continuation)) &&
+        !extensionDecode(client, &payload))
+    {
+      // connection failed and is closed
+      return;
+    }
+   
+    switch (header->opCode)
+    {
+      case WSop_text:
+        WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Client: ", client->num, ", text:", (char *) payload);
+        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
+        break;
+
+      case WSop_binary:
+      case WSop_continuation:
+        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
+        break;
+        
+      case WSop_ping:
+        // send pong back
+        WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Client: ", client->num, ", ping received", payload ? (const char *)payload : "");               
+                          
+        sendFrame(client, WSop_pong, payload, header->payloadLen);
+        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
+        break;
+        
+      case WSop_pong:
+        WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Client: ", client->num, ", get pong", payload ? (const char *)payload : "");             
+                          
+        client->pongReceived = true;
+        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
+        break;
+        
+      case WSop_close:
+        {
+          uint16_t reasonCode = 1000;
+
+          if (header->payloadLen >= 2)
+          {
+            reasonCode = payload[0] << 8 | payload[1];
+          }
+
+          WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Get ask for close. Client Num:", client->num, ", Code:", reasonCode);
+          
+          if (header->payloadLen > 2)
+          {
+            WSK_LOGDEBUG1("Payload =", (char *) (payload + 2));
+          }
+
+          clientDisconnect(client, 1000);
+        } 
+        break;
+        
+      default:
+        WSK_LOGDEBUG3("[WS][handleWebsocket] Got unknown opcode: Client =", client->num, ", opcode =", header->opCode);
+        clientDisconnect(client, 1002);
+        break;
+    }
+
+    if (payload && !batchOwns(payload))
+    {
+      free(payload);
+    }
+
+    // reset input
+    client->cWsRXsize = 0;
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    //register callback for next message
+    handleWebsocketWaitFor(client, 2);
+#endif
+
+  }
+  else
+  {
+    WSK_LOGDEBUG1("[handleWebsocket] Missing data!. Client:", client->num);
+    
+    if (!batchOwns(payload))
+    {
+      free(payload);
+    }
+
+    clientDisconnect(client, 1002);
+  }
+}
+
+/**
+   generate the key for Sec-WebSocket-Accept
+   @param clientKey String
+   @return String Accept Key
+*/
+String WebSockets::acceptKey(String & clientKey)
+{
+  uint8_t sha1HashBin[20] = { 0 };
+
+#ifdef ESP8266
+  sha1(clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", &sha1HashBin[0]);
+#elif defined(ESP32)
+  String data = clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  esp_sha(SHA1, (unsigned char *)data.c_str(), data.length(), &sha1HashBin[0]);
+#else
+  clientKey += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  SHA1_CTX ctx;
+  SHA1Init(&ctx);
+  SHA1Update(&ctx, (const unsigned char *)clientKey.c_str(), clientKey.length());
+  SHA1Final(&sha1HashBin[0], &ctx);
+#endif
+
+  String key = base64_encode(sha1HashBin, 20);
+  key.trim();
+
+  return key;
+}
+
+
+/**
+   base64_encode
+   @param data uint8_t
+   @param length size_t
+   @return base64 encoded String
+*/
+String WebSockets::base64_encode(uint8_t * data, size_t length)
+{
+  size_t size   = ((length * 1.6f) + 1);
+  char * buffer = (char *) malloc(size);
+  
+  //WSK_LOGDEBUG3("[base64_encode] length:", length, ", size:", size);
+
+  if (buffer)
+  {
+    base64_encodestate _state;
+    
+    base64_init_encodestate(&_state);
+    
+    int len = base64_encode_block((const char *)&data[0], length, &buffer[0], &_state);
+
+    //WSK_LOGDEBUG1("[base64_encode] #1 len:", len);
+    
+    len = base64_encode_blockend((buffer + len), &_state);
+    //WSK_LOGDEBUG1("[base64_encode] #2 len:", len);
+    
+    String base64 = String(buffer);
+    
+    //WSK_LOGDEBUG3("[base64_encode] base64:", base64, ", buffer:", buffer);
+    
+    free(buffer);
+    return base64;
+  }
+  
+  return String("-FAIL-");
+}
+
+/**
+   read x byte from tcp or get timeout
+   @param client WSclient_t
+   @param out  uint8_t * data buffer
+   @param n size_t byte count
+   @return true if ok
+*/
+bool WebSockets::readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWaitCb cb)
+{
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+  if (!client->tcp || !client->tcp->connected())
+  {
+    return false;
+  }
+
+  client->tcp->readBytes(out, n, std::bind([](WSclient_t * client, bool ok, WSreadWaitCb cb)
+  {
+    if (cb)
+    {
+      cb(client, ok);
+    }
+  }, client, std::placeholders::_1, cb));
+
+#else
+  unsigned long t = millis();
+  ssize_t len;
+
+  WSK_LOGDEBUG3("[readCb] n:", n, ", t:", t);
+
+  while (n > 0)
+  {
+    if (client->tcp == NULL)
+    {
+      WSK_LOGDEBUG("[readCb] Null tcp!");
+
+      if (cb)
+      {
+        cb(client, false);
+      }
+      
+      return false;
+    }
+
+    if (client->cRxPos < client->cRxLength)
+    {
+      // what was read ahead comes first
+      len = std::min(n, (size_t) (client->cRxLength - client->cRxPos));
+
+      memcpy(out, (client->cRxBuffer + client->cRxPos), len);
+
+      client->cRxPos += len;
+      out += len;
+      n   -= len;
+
+      continue;
+    }
+
+    if (!client->tcp->connected())
+    {
+      WSK_LOGDEBUG("[readCb] Not connected!");
+
+      if (cb)
+      {
+        cb(client, false);
+      }
+      
+      return false;
+    }
+
+    if ((millis() - t) > _readTimeout)
+    {
+      WSK_LOGDEBUG1("[readCb] TIMEOUT (ms):", (millis() - t));
+
+      timeoutOccurred(client, WStimeout_read);
+
+      if (cb)
+      {
+        cb(client, false);
+      }
+      
+      return false;
+    }
+
+    if (!client->tcp->available())
+    {
+      waitIO(client, false, t);
+      continue;
+    }
+
+#if (WEBSOCKETS_RX_BUFFER_SIZE > 0)
+    if (n < WEBSOCKETS_RX_BUFFER_SIZE)
+    {
+      // one driver read for this and whatever follows it (next header, next small frames)
+      if (!client->cRxBuffer)
+      {
+        client->cRxBuffer = (uint8_t *) malloc(WEBSOCKETS_RX_BUFFER_SIZE);
+      }
+
+      if (client->cRxBuffer)
+      {
+        len = client->tcp->read(client->cRxBuffer, WEBSOCKETS_RX_BUFFER_SIZE);
+
+        client->cRxPos    = 0;
+        client->cRxLength = (len > 0) ? len : 0;
+
+        if (len > 0)
+        {
+          t = millis();
+        }
+
+        continue;
+      }
+    }
+#endif
+
+    len = client->tcp->read((uint8_t *)out, n);
+
+    if (len > 0)
+    {
+      t    = millis();
+      out += len;
+      n   -= len;
+    }
+    
+    WSK_LOGDEBUG3("[readCb] Receive Length =", len, ", left =", n);
+      
+    if (n > 0) 
+    {
+      WEBSOCKETS_YIELD();
+    }
+  }
+
+  if (cb)
+  {
+    cb(client, true);
+  }
+  
+  WEBSOCKETS_YIELD();
+#endif
+
+  return true;
+}
+
+/**
+   wait for the connection to become readable (write = false) or writable
+   a wait strategy blocks up to WEBSOCKETS_WAIT_SLICE_US and returns as soon as the socket is ready,
+   without one the first WEBSOCKETS_WAIT_SPIN_MS only yield, then every poll sleeps a millisecond
+   @param client WSclient_t *   ptr to the client struct
+   @param write bool
+   @param since unsigned long   millis of the last progress
+*/
+void WebSockets::waitIO(WSclient_t * client, bool write, unsigned long since)
+{
+  if (_waitCb && _waitCb(client, write, WEBSOCKETS_WAIT_SLICE_US))
+  {
+    return;
+  }
+
+  if ((millis() - since) < WEBSOCKETS_WAIT_SPIN_MS)
+  {
+    WEBSOCKETS_YIELD();
+  }
+  else
+  {
+    WEBSOCKETS_YIELD_MORE();
+  }
+}
+
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH)
+/**
+   wait strategy of the ESP32 lwIP sockets, select() wakes up as soon as data or room is there
+   TLS connections have no socket of their own here and fall back to polling
+   @param client WSclient_t *   ptr to the client struct
+   @param write bool
+   @param timeoutUs uint32_t
+   @return false if the connection has no socket
+*/
+bool WS_waitSocket(WSclient_t * client, bool write, uint32_t timeoutUs)
+{
+  int fd = client->tcp ? client->tcp->fd() : -1;
+
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  fd_set set;
+  struct timeval tv;
+
+  FD_ZERO(&set);
+  FD_SET(fd, &set);
+
+  tv.tv_sec  = (timeoutUs / 1000000);
+  tv.tv_usec = (timeoutUs % 1000000);
+
+  return (select(fd + 1, (write ? NULL : &set), (write ? &set : NULL), NULL, &tv) >= 0);
+}
+#endif
+
+/**
+   bytes that can be read without waiting, the read-ahead included
+   @param client WSclient_t *   ptr to the client struct
+   @return int
+*/
+int WebSockets::rxAvailable(WSclient_t * client)
+{
+  int len = (client->cRxLength - client->cRxPos);
+
+  if (client->tcp)
+  {
+    len += client->tcp->available();
+  }
+
+  return len;
+}
+
+/**
+   free the read-ahead of a connection, what it still holds is dropped
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::rxRelease(WSclient_t * client)
+{
+  if (client->cRxBuffer)
+  {
+    free(client->cRxBuffer);
+    client->cRxBuffer = NULL;
+  }
+
+  client->cRxPos    = 0;
+  client->cRxLength = 0;
+}
+
+/**
+   write x byte to tcp or get timeout
+   @param client WSclient_t
+   @param out  uint8_t * data buffer
+   @param n size_t byte count
+   @return bytes send
+*/
+size_t WebSockets::write(WSclient_t * client, uint8_t * out, size_t n)
+{
+  if (out == NULL)
+    return 0;
+
+  if (client == NULL)
+    return 0;
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+  if (_cork && (client->status == WSC_CONNECTED))
+  {
+    if (((client->cTxLength + n) > WEBSOCKETS_TX_BUFFER_SIZE) && !txFlush(client))
+    {
+      return 0;
+    }
+
+    if (n < WEBSOCKETS_TX_BUFFER_SIZE)
+    {
+      if (!client->cTxBuffer)
+      {
+        client->cTxBuffer = (uint8_t *) malloc(WEBSOCKETS_TX_BUFFER_SIZE);
+      }
+
+      if (client->cTxBuffer)
+      {
+        memcpy((client->cTxBuffer + client->cTxLength), out, n);
+        client->cTxLength += n;
+
+        return n;
+      }
+    }
+  }
+#endif
+
+  return tcpWrite(client, out, n);
+}
+
+/**
+   write to the tcp connection, waits up to _writeTimeout for the driver to take it
+   @param client WSclient_t *   ptr to the client struct
+   @param out const uint8_t *
+   @param n size_t
+   @return size_t   bytes written
+*/
+size_t WebSockets::tcpWrite(WSclient_t * client, const uint8_t * out, size_t n)
+{
+  unsigned long t = millis();
+  size_t len      = 0;
+  size_t total    = 0;
+
+  WSK_LOGDEBUG3("[write] n:", n, ", t:", t);
+
+  while (n > 0)
+  {
+    if (client->tcp == NULL)
+    {
+      WSK_LOGDEBUG("[write] Null tcp!");
+      break;
+    }
+
+    if (!client->tcp->connected())
+    {
+      WSK_LOGDEBUG("[write] Not connected!");
+      break;
+    }
+
+    if ((millis() - t) > _writeTimeout)
+    {
+      WSK_LOGDEBUG1("[write] TIMEOUT (ms):", (millis() - t));
+
+      timeoutOccurred(client, WStimeout_write);
+
+      // part of a frame may be out, the connection is dropped by the next clientIsConnected()
+      client->tcp->stop();
+      break;
+    }
+
+    len = client->tcp->write((const uint8_t *)out, n);
+
+    if (len)
+    {
+      t      = millis();
+      out   += len;
+      n     -= len;
+      total += len;
+
+      WSK_LOGDEBUG3("[write] Write, Length :", len, ", Left :", n);
+    }
+    else
+    {
+      WSK_LOGDEBUG3("[write] Failed Write, Length :", len, ", Left :", n);
+
+      // driver is full
+      waitIO(client, true, t);
+    }
+       
+    if (n > 0) 
+    {
+      WEBSOCKETS_YIELD();
+    }
+  }
+  
+  WEBSOCKETS_YIELD();
+  
+  return total;
+}
+
+size_t WebSockets::write(WSclient_t * client, const char * out)
+{
+  if (client == NULL)
+    return 0;
+
+  if (out == NULL)
+    return 0;
+
+  return write(client, (uint8_t *)out, strlen(out));
+}
+
+/**
+   write the corked frames of a connection
+   @param client WSclient_t *   ptr to the client struct
+   @return false if not everything could be written
+*/
+bool WebSockets::txFlush(WSclient_t * client)
+{
+  if (client->cTxLength == 0)
+  {
+    return true;
+  }
+
+  size_t length     = client->cTxLength;
+  client->cTxLength = 0;
+
+  return (tcpWrite(client, client->cTxBuffer, length) == length);
+}
+
+/**
+   write what is still corked and free the buffer of a connection
+   @param client WSclient_t *   ptr to the client struct
+*/
+void WebSockets::txRelease(WSclient_t * client)
+{
+  if (client->cTxBuffer)
+  {
+    txFlush(client);
+
+    free(client->cTxBuffer);
+    client->cTxBuffer = NULL;
+  }
+
+  client->cTxLength = 0;
+}
+
+/**
+   enable ping/pong heartbeat process
+   @param client WSclient_t
+   @param pingInterval uint32_t how often ping will be sent
+   @param pongTimeout uint32_t millis after which pong should timout if not received
+   @param disconnectTimeoutCount uint8_t how many timeouts before disconnect, 0=> do not disconnect
+*/
+void WebSockets::enableHeartbeat(WSclient_t * client, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount)
+{
+  if (client == NULL)
+    return;
+
+  client->pingInterval           = pingInterval;
+  client->pongTimeout            = pongTimeout;
+  client->disconnectTimeoutCount = disconnectTimeoutCount;
+  client->pongReceived           = false;
+}
+
+/**
+   handle ping/pong heartbeat timeout process
+   @param client WSclient_t
+*/
+void WebSockets::handleHBTimeout(WSclient_t * client)
+{
+  if (client->pingInterval)
+  {
+    // if heartbeat is enabled
+    uint32_t pi = millis() - client->lastPing;
+
+    if (client->pongReceived)
+    {
+      client->pongTimeoutCount = 0;
+    }
+    else
+    {
+      if (pi > client->pongTimeout)
+      {
+        // pong not received in time
+        client->pongTimeoutCount++;
+        client->lastPing = millis() - client->pingInterval - 500;    // force ping on the next run
+
+        WSK_LOGDEBUG3("[HBtimeout] pong TIMEOUT! lp=", client->lastPing, ", millis=",  millis());
+        WSK_LOGDEBUG3("[HBtimeout] pong TIMEOUT! pi=", pi, ", count=", client->pongTimeoutCount);             
+
+        if (client->disconnectTimeoutCount && client->pongTimeoutCount >= client->disconnectTimeoutCount)
+        {
+          WSK_LOGDEBUG1("[HBtimeout] DISCONNECTING, count=", client->pongTimeoutCount); 
+          
+          clientDisconnect(client);
         }
       }
     }
-   
-    switch (header->opCode)
+  }
+}
+
+/**
+   register an extension for the connections opened from now on,
+   extensions are offered and accepted in the order they were added
+   @param extension WebSocketsExtension *
+   @return false if there is no room left or one of its RSV bits is taken
+*/
+bool WebSockets::addExtension(WebSocketsExtension * extension)
+{
+  uint8_t rsv = 0x00;
+
+  for (uint8_t i = 0; i < _extensionCount; i++)
+  {
+    if (_extensions[i] == extension)
     {
-      case WSop_text:
-        WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Client: ", client->num, ", text:", (char *) payload);
-        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
-        break;
+      return true;
+    }
 
-      case WSop_binary:
-      case WSop_continuation:
-        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
-        break;
-        
-      case WSop_ping:
-        // send pong back
-        WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Client: ", client->num, ", ping received", payload ? (const char *)payload : "");               
-                          
-        sendFrame(client, WSop_pong, payload, header->payloadLen);
-        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
-        break;
-        
-      case WSop_pong:
-        WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Client: ", client->num, ", get pong", payload ? (const char *)payload : "");             
-                          
-        client->pongReceived = true;
-        messageReceived(client, header->opCode, payload, header->payloadLen, header->fin);
-        break;
-        
-      case WSop_close:
-        {
-          uint16_t reasonCode = 1000;
+    rsv |= _extensions[i]->rsv();
+  }
 
-          if (header->payloadLen >= 2)
-          {
-            reasonCode = payload[0] << 8 | payload[1];
-          }
+  if (!extension || (_extensionCount >= WEBSOCKETS_MAX_EXTENSIONS) || (rsv & extension->rsv()))
+  {
+    WSK_LOGERROR("[addExtension] extension can not be added");
+    return false;
+  }
 
-          WSK_LOGDEBUG3("[handleWebsocketPayloadCb] Get ask for close. Client Num:", client->num, ", Code:", reasonCode);
-          
-          if (header->payloadLen > 2)
-          {
-            WSK_LOGDEBUG1("Payload =", (char *) (payload + 2));
-          }
+  _extensions[_extensionCount++] = extension;
 
-          clientDisconnect(client, 1000);
-        } 
-        break;
-        
-      default:
-        WSK_LOGDEBUG3("[WS][handleWebsocket] Got unknown opcode: Client =", client->num, ", opcode =", header->opCode);
-        clientDisconnect(client, 1002);
-        break;
+  return true;
+}
+
+/**
+   the connections opened from now on do not use the extension anymore
+   @param extension WebSocketsExtension *
+*/
+void WebSockets::removeExtension(WebSocketsExtension * extension)
+{
+  for (uint8_t i = 0; i < _extensionCount; i++)
+  {
+    if (_extensions[i] == extension)
+    {
+      _extensionCount--;
+
+      for (; i < _extensionCount; i++)
+      {
+        _extensions[i] = _extensions[i + 1];
+      }
+
+      _extensions[_extensionCount] = NULL;
+
+      return;
     }
+  }
+}
+
+/**
+   client side, Sec-WebSocket-Extensions value offering the registered extensions
+   @return String, empty if there is nothing to offer
+*/
+String WebSockets::extensionOffer()
+{
+  String offer;
+
+  for (uint8_t i = 0; i < _extensionCount; i++)
+  {
+    String element = _extensions[i]->offer();
 
-    if (payload)
+    if (element.length() > 0)
     {
-      free(payload);
+      if (offer.length() > 0)
+      {
+        offer += WEBSOCKETS_STRING(", ");
+      }
+
+      offer += element;
     }
+  }
 
-    // reset input
-    client->cWsRXsize = 0;
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    //register callback for next message
-    handleWebsocketWaitFor(client, 2);
-#endif
+  return offer;
+}
+
+/**
+   server side, accept what we support of the client's offers in client->cExtensions
+   @param client WSclient_t *  ptr to the client struct
+   @param response String &    Sec-WebSocket-Extensions value for the handshake response, empty if nothing is used
+   @return true if an extension is used on this connection
+*/
+bool WebSockets::extensionAccept(WSclient_t * client, String & response)
+{
+  response = "";
+
+  extensionRelease(client);
+
+  if ((_extensionCount == 0) || (client->cExtensions.length() == 0))
+  {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < _extensionCount; i++)
+  {
+    int pos = 0;
+    String element;
+    String name;
+
+    // several offers for one extension are alternatives, the client's favourite first
+    while (WS_nextExtension(client->cExtensions, pos, element, name))
+    {
+      if (!name.equalsIgnoreCase(_extensions[i]->name()))
+      {
+        continue;
+      }
 
+      String accepted;
+      WebSocketsExtensionSession * session = _extensions[i]->accept(element, accepted);
+
+      if (session)
+      {
+        extensionAdd(client, _extensions[i], session);
+
+        if (response.length() > 0)
+        {
+          response += WEBSOCKETS_STRING(", ");
+        }
+
+        response += accepted;
+        break;
+      }
+    }
   }
-  else
+
+  WSK_LOGDEBUG3("[extensionAccept] Client:", client->num, ", Sec-WebSocket-Extensions:", response);
+
+  return (client->cExtensionList != NULL);
+}
+
+/**
+   client side, check the server's answer to extensionOffer() in client->cExtensions
+   @param client WSclient_t *  ptr to the client struct
+   @return false if the connection has to be failed
+*/
+bool WebSockets::extensionConfirm(WSclient_t * client)
+{
+  extensionRelease(client);
+
+  int pos = 0;
+  String element;
+  String name;
+  uint32_t used = 0;
+
+  while (WS_nextExtension(client->cExtensions, pos, element, name))
   {
-    WSK_LOGDEBUG1("[handleWebsocket] Missing data!. Client:", client->num);
-    
-    free(payload);
-    clientDisconnect(client, 1002);
+    uint8_t i;
+
+    for (i = 0; i < _extensionCount; i++)
+    {
+      if (name.equalsIgnoreCase(_extensions[i]->name()))
+      {
+        break;
+      }
+    }
+
+    // only what we offered may come back, and only once
+    if ((i == _extensionCount) || (used & (1UL << i)) || (_extensions[i]->offer().length() == 0))
+    {
+      WSK_LOGINFO1("[extensionConfirm] unexpected Sec-WebSocket-Extensions:", client->cExtensions);
+
+      extensionRelease(client);
+      return false;
+    }
+
+    used |= (1UL << i);
+
+    WebSocketsExtensionSession * session = _extensions[i]->confirm(element);
+
+    if (!session)
+    {
+      extensionRelease(client);
+      return false;
+    }
+
+    extensionAdd(client, _extensions[i], session);
   }
+
+  return true;
 }
 
 /**
-   generate the key for Sec-WebSocket-Accept
-   @param clientKey String
-   @return String Accept Key
+   append a negotiated extension to the connection
+   @param client WSclient_t *  ptr to the client struct
+   @param extension WebSocketsExtension *
+   @param session WebSocketsExtensionSession *
 */
-String WebSockets::acceptKey(String & clientKey)
+void WebSockets::extensionAdd(WSclient_t * client, WebSocketsExtension * extension, WebSocketsExtensionSession * session)
 {
-  uint8_t sha1HashBin[20] = { 0 };
+  WebSocketsExtensionSession ** last = &client->cExtensionList;
 
-#ifdef ESP8266
-  sha1(clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", &sha1HashBin[0]);
-#elif defined(ESP32)
-  String data = clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-  esp_sha(SHA1, (unsigned char *)data.c_str(), data.length(), &sha1HashBin[0]);
-#else
-  clientKey += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-  SHA1_CTX ctx;
-  SHA1Init(&ctx);
-  SHA1Update(&ctx, (const unsigned char *)clientKey.c_str(), clientKey.length());
-  SHA1Final(&sha1HashBin[0], &ctx);
-#endif
+  while (*last)
+  {
+    last = &(*last)->next;
+  }
 
-  String key = base64_encode(sha1HashBin, 20);
-  key.trim();
+  *last         = session;
+  session->next = NULL;
 
-  return key;
+  client->cExtensionRsv |= session->rsv;
+
+  if (extension == &_deflate)
+  {
+    client->cDeflate = static_cast<WebSocketsDeflateSession *>(session);
+  }
 }
 
+/**
+   free the extension state of a connection
+   @param client WSclient_t *  ptr to the client struct
+*/
+void WebSockets::extensionRelease(WSclient_t * client)
+{
+  while (client->cExtensionList)
+  {
+    WebSocketsExtensionSession * next = client->cExtensionList->next;
+
+    delete client->cExtensionList;
+    client->cExtensionList = next;
+  }
+
+  client->cExtensionRsv = 0x00;
+  client->cDeflate      = NULL;
+}
 
 /**
-   base64_encode
-   @param data uint8_t
+   run the payload of a data frame through the extensions of the connection, in the negotiated order
+   @param client WSclient_t *    ptr to the client struct
+   @param opcode WSopcode_t
+   @param payload const uint8_t *
    @param length size_t
-   @return base64 encoded String
+   @param fin bool
+   @param out uint8_t **         encoded payload, malloc'ed with WEBSOCKETS_MAX_HEADER_SIZE bytes in front of the data
+   @param outLength size_t *
+   @param rsv uint8_t *          RSV bits of the encoded payload are added
+   @return true if *out replaces the payload
 */
-String WebSockets::base64_encode(uint8_t * data, size_t length)
+bool WebSockets::extensionEncode(WSclient_t * client, WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin,
+                                 uint8_t ** out, size_t * outLength, uint8_t * rsv)
 {
-  size_t size   = ((length * 1.6f) + 1);
-  char * buffer = (char *) malloc(size);
-  
-  //WSK_LOGDEBUG3("[base64_encode] length:", length, ", size:", size);
+  *out = NULL;
 
-  if (buffer)
+  for (WebSocketsExtensionSession * session = client->cExtensionList; session; session = session->next)
   {
-    base64_encodestate _state;
-    
-    base64_init_encodestate(&_state);
-    
-    int len = base64_encode_block((const char *)&data[0], length, &buffer[0], &_state);
+    uint8_t * encoded;
+    size_t encodedLength;
 
-    //WSK_LOGDEBUG1("[base64_encode] #1 len:", len);
-    
-    len = base64_encode_blockend((buffer + len), &_state);
-    //WSK_LOGDEBUG1("[base64_encode] #2 len:", len);
-    
-    String base64 = String(buffer);
-    
-    //WSK_LOGDEBUG3("[base64_encode] base64:", base64, ", buffer:", buffer);
-    
-    free(buffer);
-    return base64;
+    if (session->encode(opcode, (*out ? (*out + WEBSOCKETS_MAX_HEADER_SIZE) : payload), (*out ? *outLength : length), fin,
+                        &encoded, &encodedLength, rsv))
+    {
+      if (*out)
+      {
+        free(*out);
+      }
+
+      *out       = encoded;
+      *outLength = encodedLength;
+    }
+  }
+
+  return (*out != NULL);
+}
+
+/**
+   undo the extensions on the payload of a received data frame, the last negotiated one first
+   @param client WSclient_t *  ptr to the client struct
+   @param payload uint8_t **   in: received frame payload, out: decoded payload (malloc'ed, 0 terminated)
+   @return false if the connection has been failed, payload is freed then
+*/
+bool WebSockets::extensionDecode(WSclient_t * client, uint8_t ** payload)
+{
+  WSMessageHeader_t * header = &client->cWsHeaderDecode;
+  WebSocketsExtensionSession * sessions[WEBSOCKETS_MAX_EXTENSIONS];
+  uint8_t count = 0;
+
+  for (WebSocketsExtensionSession * session = client->cExtensionList; session && (count < WEBSOCKETS_MAX_EXTENSIONS); session = session->next)
+  {
+    sessions[count++] = session;
   }
-  
-  return String("-FAIL-");
+
+  while (count > 0)
+  {
+    uint16_t closeCode = 1002;
+
+    if (!sessions[--count]->decode(header, payload, &closeCode))
+    {
+      WSK_LOGDEBUG3("[extensionDecode] Client:", client->num, ", decoding failed, close:", closeCode);
+
+      free(*payload);
+      *payload = NULL;
+
+      client->cWsRXsize = 0;
+      clientDisconnect(client, closeCode);
+
+      return false;
+    }
+  }
+
+  return true;
 }
 
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
 /**
-   read x byte from tcp or get timeout
-   @param client WSclient_t
-   @param out  uint8_t * data buffer
-   @param n size_t byte count
-   @return true if ok
+   read a frame of a compressed message in WEBSOCKETS_INFLATE_CHUNK_SIZE steps and inflate it on the fly,
+   only the inflate window is needed, whatever the size of the message.
+   every full window is handed out as WStype_FRAGMENT_TEXT_START / WStype_FRAGMENT_BIN_START / WStype_FRAGMENT,
+   the rest at the end of the message as WStype_FRAGMENT_FIN,
+   or as a plain WStype_TEXT / WStype_BIN if the whole message fit into the window
+   @param client WSclient_t *  ptr to the client struct
 */
-bool WebSockets::readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWaitCb cb)
+void WebSockets::handleWebsocketStream(WSclient_t * client)
 {
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-  if (!client->tcp || !client->tcp->connected())
-  {
-    return false;
-  }
+  WSMessageHeader_t * header         = &client->cWsHeaderDecode;
+  WebSocketsDeflateSession * session = client->cDeflate;
 
-  client->tcp->readBytes(out, n, std::bind([](WSclient_t * client, bool ok, WSreadWaitCb cb)
+  static const uint8_t trailer[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+  uint8_t chunk[WEBSOCKETS_INFLATE_CHUNK_SIZE];
+  size_t offset            = 0;
+  uint16_t reason          = 1007;
+  WSinflateResult_t result = WSinflate_ok;
+
+  if (header->rsv1)
   {
-    if (cb)
+    if (header->opCode == WSop_continuation)
     {
-      cb(client, ok);
+      // RSV1 only marks the first frame of a message
+      clientDisconnect(client, 1002);
+      return;
     }
-  }, client, std::placeholders::_1, cb));
 
-#else
-  unsigned long t = millis();
-  ssize_t len;
+    session->rxMessage = true;
+    session->rxOpcode  = header->opCode;
+    session->rxStarted = false;
+  }
 
-  WSK_LOGDEBUG3("[readCb] n:", n, ", t:", t);
+  // an event handler may close the connection, keep the session away from clientDisconnect meanwhile
+  client->cExtensionList = NULL;
+  client->cDeflate       = NULL;
 
-  while (n > 0)
+  WebSocketsInflate::WSinflateOutputCb output = [&](const uint8_t * data, size_t length) -> bool
   {
-    if (client->tcp == NULL)
-    {
-      WSK_LOGDEBUG("[readCb] Null tcp!");
+    // a full window, more of the message follows
+    messageReceived(client, (session->rxStarted ? WSop_continuation : session->rxOpcode), (uint8_t *) data, length, false);
+    session->rxStarted = true;
 
-      if (cb)
-      {
-        cb(client, false);
-      }
-      
-      return false;
+    return clientIsConnected(client);
+  };
+
+  while ((offset < header->payloadLen) && ((result == WSinflate_ok) || (result == WSinflate_end)))
+  {
+    size_t n = header->payloadLen - offset;
+
+    if (n > sizeof(chunk))
+    {
+      n = sizeof(chunk);
     }
 
-    if (!client->tcp->connected())
+    if (!readCb(client, chunk, n, NULL))
     {
-      WSK_LOGDEBUG("[readCb] Not connected!");
+      WSK_LOGDEBUG1("[handleWebsocketStream] Missing data!. Client:", client->num);
 
-      if (cb)
-      {
-        cb(client, false);
-      }
-      
-      return false;
+      reason = 1002;
+      result = WSinflate_error;
+      break;
     }
 
-    if ((millis() - t) > WEBSOCKETS_TCP_TIMEOUT)
+    if (header->mask)
     {
-      WSK_LOGDEBUG1("[readCb] TIMEOUT (ms):", (millis() - t));
-
-      if (cb)
+      //decode XOR
+      for (size_t i = 0; i < n; i++)
       {
-        cb(client, false);
+        chunk[i] = (chunk[i] ^ header->maskKey[(offset + i) % 4]);
       }
-      
-      return false;
     }
 
-    if (!client->tcp->available())
+    offset += n;
+
+    // data behind the final block is read but ignored
+    result = session->rx.inflate(chunk, n, output);
+  }
+
+  if (header->fin && (result == WSinflate_ok))
+  {
+    // the 00 00 ff ff the sender stripped from the end of the message
+    result = session->rx.inflate(trailer, sizeof(trailer), output);
+  }
+
+  if (header->fin && ((result == WSinflate_ok) || (result == WSinflate_end)) && clientIsConnected(client))
+  {
+    bool delivered = false;
+
+    WebSocketsInflate::WSinflateOutputCb last = [&](const uint8_t * data, size_t length) -> bool
     {
-      WEBSOCKETS_YIELD_MORE();
-      continue;
+      messageReceived(client, (session->rxStarted ? WSop_continuation : session->rxOpcode), (uint8_t *) data, length, true);
+      delivered = true;
+
+      return true;
+    };
+
+    session->rx.flush(last);
+
+    if (!delivered)
+    {
+      // empty message, or the last window ended exactly with it
+      messageReceived(client, (session->rxStarted ? WSop_continuation : session->rxOpcode), NULL, 0, true);
     }
 
-    len = client->tcp->read((uint8_t *)out, n);
+    session->rxMessage = false;
+    session->rxStarted = false;
 
-    if (len > 0)
+    if (session->rxNoContextTakeover)
     {
-      t    = millis();
-      out += len;
-      n   -= len;
+      session->rx.release();
     }
-    
-    WSK_LOGDEBUG3("[readCb] Receive Length =", len, ", left =", n);
-      
-    if (n > 0) 
+    else
     {
-      WEBSOCKETS_YIELD();
+      session->rx.reset();
     }
   }
 
-  if (cb)
+  client->cWsRXsize = 0;
+
+  if (!clientIsConnected(client))
   {
-    cb(client, true);
+    delete session;
+    return;
   }
-  
-  WEBSOCKETS_YIELD();
-#endif
 
-  return true;
+  client->cExtensionList = session;
+  client->cExtensionRsv  = session->rsv;
+  client->cDeflate       = session;
+
+  if ((result != WSinflate_ok) && (result != WSinflate_end))
+  {
+    if (result == WSinflate_noMemory)
+    {
+      reason = 1011;
+    }
+
+    WSK_LOGDEBUG3("[handleWebsocketStream] Client:", client->num, ", inflate failed, close:", reason);
+
+    clientDisconnect(client, reason);
+  }
 }
 
 /**
-   write x byte to tcp or get timeout
-   @param client WSclient_t
-   @param out  uint8_t * data buffer
-   @param n size_t byte count
-   @return bytes send
+   forward a data frame of a relay source to the targets of its relay, WEBSOCKETS_RELAY_CHUNK_SIZE
+   bytes at a time: each target gets the frame with its own header and masking, whatever the size
+   of the message only the chunk is in RAM and the event handler is not called
+   @param client WSclient_t *  ptr to the client struct of the source
 */
-size_t WebSockets::write(WSclient_t * client, uint8_t * out, size_t n)
+void WebSockets::handleWebsocketRelay(WSclient_t * client)
 {
-  if (out == NULL)
-    return 0;
-
-  if (client == NULL)
-    return 0;
+  WSMessageHeader_t * header = &client->cWsHeaderDecode;
+  WebSocketsRelay * relay    = client->cRelay;
 
-  unsigned long t = millis();
-  size_t len      = 0;
-  size_t total    = 0;
+  uint8_t chunk[WEBSOCKETS_RELAY_CHUNK_SIZE];
+  uint8_t masked[WEBSOCKETS_RELAY_CHUNK_SIZE];
+  uint8_t maskKeys[WEBSOCKETS_RELAY_TARGETS_MAX][4];
+  bool active[WEBSOCKETS_RELAY_TARGETS_MAX];
 
-  WSK_LOGDEBUG3("[write] n:", n, ", t:", t);
+  bool first    = (header->opCode != WSop_continuation);
+  size_t offset = 0;
 
-  while (n > 0)
+  for (uint8_t i = 0; i < relay->_count; i++)
   {
-    if (client->tcp == NULL)
-    {
-      WSK_LOGDEBUG("[write] Null tcp!");
-      break;
-    }
+    WebSockets * ws      = relay->_ws[i];
+    WSclient_t * target  = relay->_clients[i];
+    uint8_t buffer[WEBSOCKETS_MAX_HEADER_SIZE];
 
-    if (!client->tcp->connected())
+    active[i] = false;
+
+    if ((target == client) || (target->status != WSC_CONNECTED) || !target->tcp || !target->tcp->connected())
     {
-      WSK_LOGDEBUG("[write] Not connected!");
-      break;
+      continue;
     }
 
-    if ((millis() - t) > WEBSOCKETS_TCP_TIMEOUT)
+    // a message can't go in between the fragments of another one
+    if ((target->cRelayOwner != (first ? NULL : client)) || (first && target->cWriter))
     {
-      WSK_LOGDEBUG1("[write] TIMEOUT (ms):", (millis() - t));
-      break;
-    }
+      if (first)
+      {
+        WSK_LOGDEBUG3("[handleWebsocketRelay] Client:", client->num, ", target busy, message dropped for:", target->num);
+      }
 
-    len = client->tcp->write((const uint8_t *)out, n);
+      continue;
+    }
 
-    if (len)
+    if (first)
     {
-      t      = millis();
-      out   += len;
-      n     -= len;
-      total += len;
-
-      WSK_LOGDEBUG3("[write] Write, Length :", len, ", Left :", n);
+      ws->bulkFinish(target);
     }
-    else
+
+    for (uint8_t x = 0; x < 4; x++)
     {
-      WSK_LOGDEBUG3("[write] Failed Write, Length :", len, ", Left :", n);
+      maskKeys[i][x] = target->cIsClient ? random(0xFF) : 0x00;
     }
-       
-    if (n > 0) 
+
+    uint8_t headerSize = createHeader(buffer, header->opCode, header->payloadLen, target->cIsClient, maskKeys[i], header->fin);
+
+    if (ws->write(target, buffer, headerSize) != headerSize)
     {
-      WEBSOCKETS_YIELD();
+      // dropped by the next clientIsConnected()
+      if (target->tcp)
+      {
+        target->tcp->stop();
+      }
+
+      continue;
     }
+
+    target->cRelayOwner = header->fin ? NULL : client;
+    active[i]           = true;
   }
-  
-  WEBSOCKETS_YIELD();
-  
-  return total;
-}
 
-size_t WebSockets::write(WSclient_t * client, const char * out)
-{
-  if (client == NULL)
-    return 0;
+  while (offset < header->payloadLen)
+  {
+    size_t n = header->payloadLen - offset;
 
-  if (out == NULL)
-    return 0;
+    if (n > sizeof(chunk))
+    {
+      n = sizeof(chunk);
+    }
 
-  return write(client, (uint8_t *)out, strlen(out));
-}
+    if (!readCb(client, chunk, n, NULL))
+    {
+      WSK_LOGDEBUG1("[handleWebsocketRelay] Missing data!. Client:", client->num);
 
-/**
-   enable ping/pong heartbeat process
-   @param client WSclient_t
-   @param pingInterval uint32_t how often ping will be sent
-   @param pongTimeout uint32_t millis after which pong should timout if not received
-   @param disconnectTimeoutCount uint8_t how many timeouts before disconnect, 0=> do not disconnect
-*/
-void WebSockets::enableHeartbeat(WSclient_t * client, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount)
-{
-  if (client == NULL)
-    return;
+      // the targets got part of a frame, nothing can follow on them
+      for (uint8_t i = 0; i < relay->_count; i++)
+      {
+        if (active[i])
+        {
+          WSclient_t * target = relay->_clients[i];
 
-  client->pingInterval           = pingInterval;
-  client->pongTimeout            = pongTimeout;
-  client->disconnectTimeoutCount = disconnectTimeoutCount;
-  client->pongReceived           = false;
-}
+          target->cRelayOwner = NULL;
 
-/**
-   handle ping/pong heartbeat timeout process
-   @param client WSclient_t
-*/
-void WebSockets::handleHBTimeout(WSclient_t * client)
-{
-  if (client->pingInterval)
-  {
-    // if heartbeat is enabled
-    uint32_t pi = millis() - client->lastPing;
+          if (target->tcp)
+          {
+            target->tcp->stop();
+          }
+        }
+      }
 
-    if (client->pongReceived)
+      clientDisconnect(client, 1002);
+      return;
+    }
+
+    if (header->mask)
     {
-      client->pongTimeoutCount = 0;
+      //decode XOR
+      for (size_t x = 0; x < n; x++)
+      {
+        chunk[x] = (chunk[x] ^ header->maskKey[(offset + x) % 4]);
+      }
     }
-    else
+
+    for (uint8_t i = 0; i < relay->_count; i++)
     {
-      if (pi > client->pongTimeout)
+      WSclient_t * target = relay->_clients[i];
+      uint8_t * data      = chunk;
+
+      if (!active[i])
       {
-        // pong not received in time
-        client->pongTimeoutCount++;
-        client->lastPing = millis() - client->pingInterval - 500;    // force ping on the next run
+        continue;
+      }
 
-        WSK_LOGDEBUG3("[HBtimeout] pong TIMEOUT! lp=", client->lastPing, ", millis=",  millis());
-        WSK_LOGDEBUG3("[HBtimeout] pong TIMEOUT! pi=", pi, ", count=", client->pongTimeoutCount);             
+      if (target->cIsClient)
+      {
+        for (size_t x = 0; x < n; x++)
+        {
+          masked[x] = (chunk[x] ^ maskKeys[i][(offset + x) % 4]);
+        }
 
-        if (client->disconnectTimeoutCount && client->pongTimeoutCount >= client->disconnectTimeoutCount)
+        data = masked;
+      }
+
+      if (relay->_ws[i]->write(target, data, n) != n)
+      {
+        active[i]           = false;
+        target->cRelayOwner = NULL;
+
+        if (target->tcp)
         {
-          WSK_LOGDEBUG1("[HBtimeout] DISCONNECTING, count=", client->pongTimeoutCount); 
-          
-          clientDisconnect(client);
+          target->tcp->stop();
         }
       }
     }
+
+    offset += n;
+  }
+
+  client->cRelaying = !header->fin;
+  client->cWsRXsize = 0;
+}
+
+/**
+   handle the frames of a connection that are in already, one after the other,
+   the text and binary messages among them reach the batch callback with one call
+   @param client WSclient_t *  ptr to the client struct
+*/
+void WebSockets::handleWebsocketBatch(WSclient_t * client)
+{
+  handleWebsocket(client);
+
+  for (uint16_t n = 1; _batchBuffer && (n < _batchMax) && (client->status == WSC_CONNECTED) && (client->cWsRXsize == 0) &&
+       (rxAvailable(client) > 0); n++)
+  {
+    handleWebsocket(client);
   }
+
+  batchFlush();
 }
+#endif
 
 #endif    // WEBSOCKETS_GENERIC_IMPL_H_
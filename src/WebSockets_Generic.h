@@ -298,6 +298,51 @@
 // max size of the WS Message Header
 #define WEBSOCKETS_MAX_HEADER_SIZE (14)
 
+// bulk messages waiting per connection, see queueTXT() / queueBIN()
+#ifndef WEBSOCKETS_BULK_QUEUE_MAX
+  #define WEBSOCKETS_BULK_QUEUE_MAX       (4)
+#endif
+
+// payload bytes of a bulk message sent per loop() when no max frame size is set
+#ifndef WEBSOCKETS_BULK_FRAGMENT_SIZE
+  #define WEBSOCKETS_BULK_FRAGMENT_SIZE   (512)
+#endif
+
+// read-ahead per connection, frame headers and small frames are taken in with one driver read, 0 = off.
+// Malloced per connection, so off on AVR where a few connections would take a good part of the RAM
+#ifndef WEBSOCKETS_RX_BUFFER_SIZE
+  #if defined(__AVR__)
+    #define WEBSOCKETS_RX_BUFFER_SIZE     (0)
+  #else
+    #define WEBSOCKETS_RX_BUFFER_SIZE     (256)
+  #endif
+#endif
+
+// frames gathered per connection in cork mode before they are written, one TCP segment (MSS)
+#ifndef WEBSOCKETS_TX_BUFFER_SIZE
+  #define WEBSOCKETS_TX_BUFFER_SIZE       (1460)
+#endif
+
+// payload bytes of the messages handed to the batch callback at once, see onBatchEvent()
+#ifndef WEBSOCKETS_BATCH_BUFFER_SIZE
+  #define WEBSOCKETS_BATCH_BUFFER_SIZE    (512)
+#endif
+
+// messages handed to the batch callback at once
+#ifndef WEBSOCKETS_BATCH_MAX_MESSAGES
+  #define WEBSOCKETS_BATCH_MAX_MESSAGES   (16)
+#endif
+
+// longest a wait strategy blocks at once, timeouts and the connection state are checked in between
+#ifndef WEBSOCKETS_WAIT_SLICE_US
+  #define WEBSOCKETS_WAIT_SLICE_US        (10000)
+#endif
+
+// without a wait strategy a wait only yields for this long before it sleeps a millisecond per poll
+#ifndef WEBSOCKETS_WAIT_SPIN_MS
+  #define WEBSOCKETS_WAIT_SPIN_MS         (2)
+#endif
+
 //////////////////////////////////////////////////////////////
 
 #ifndef WEBSOCKETS_NETWORK_TYPE
@@ -437,6 +482,11 @@
     #define WEBSOCKETS_NETWORK_CLASS          EthernetClient
     #define WEBSOCKETS_NETWORK_SERVER_CLASS   EthernetServer
     
+    // patched Ethernet / EthernetLarge (LibraryPatches), the server polls its sockets with one SPI transaction each
+    #if defined(ETHERNET_SOCKET_SNAPSHOT)
+      #define WEBSOCKETS_SOCKET_SNAPSHOT      true
+    #endif
+    
     // KH, test SSL
     //#define WEBSOCKETS_NETWORK_SSL_CLASS      EthernetSSLClient
     
@@ -452,6 +502,9 @@
 
   #include <WiFi.h>
   #include <WiFiClientSecure.h>
+  #include <lwip/sockets.h>
+  #include <lwip/dns.h>
+  #include <lwip/tcpip.h>
   
   // From v2.3.1
   #define SSL_AXTLS
@@ -464,6 +517,9 @@
 #elif (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH)
 
   #include <ETH.h>
+  #include <lwip/sockets.h>
+  #include <lwip/dns.h>
+  #include <lwip/tcpip.h>
   #define WEBSOCKETS_NETWORK_CLASS            WiFiClient
   #define WEBSOCKETS_NETWORK_SERVER_CLASS     WiFiServer
 
@@ -571,8 +627,24 @@ typedef enum
   WStype_FRAGMENT_FIN,
   WStype_PING,
   WStype_PONG,
+  WStype_TIMEOUT,    ///< payload[0] is the WStimeout_t that expired, WStype_DISCONNECTED follows
 } WStype_t;
 
+typedef struct
+{
+  WStype_t type;         ///< WStype_TEXT or WStype_BIN
+  uint8_t * payload;     ///< 0 terminated, valid until the batch callback returns
+  size_t length;
+} WSmessage_t;
+
+typedef enum
+{
+  WStimeout_connect,      ///< tcp connection not up in time (client)
+  WStimeout_handshake,    ///< HTTP upgrade not done in time
+  WStimeout_read,         ///< peer stalled in the middle of a frame
+  WStimeout_write,        ///< network driver did not take the data in time
+} WStimeout_t;
+
 typedef enum
 {
   WSop_continuation = 0x00,    ///< %x0 denotes a continuation frame
@@ -600,6 +672,24 @@ typedef struct
   uint8_t * maskKey;
 } WSMessageHeader_t;
 
+#include "WebSocketsExtension_Generic.h"
+#include "WebSocketsDeflate_Generic.h"
+
+typedef struct WSbulkMessage_s
+{
+  uint8_t * payload;     ///< WEBSOCKETS_MAX_HEADER_SIZE bytes in front of the data
+  size_t length;
+  size_t offset;         ///< bytes sent so far
+  WSopcode_t opcode;
+  uint8_t rsv;           ///< RSV bits of the encoded payload
+  bool encoded;          ///< went through the extensions, done when it is about to be sent
+
+  struct WSbulkMessage_s * next;
+} WSbulkMessage_t;
+
+class WebSocketsRelay;
+class WebSocketsWriter;
+
 typedef struct
 {
   void init(uint8_t num, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount) 
@@ -637,6 +727,34 @@ typedef struct
   String cExtensions;       ///< client Sec-WebSocket-Extensions
   uint16_t cVersion = 0;    ///< client Sec-WebSocket-Version
 
+  uint32_t cHandshakeStart = 0;    ///< millis when the tcp connection was accepted, server only
+
+  WebSocketsExtensionSession * cExtensionList = nullptr;    ///< negotiated extensions in their order, NULL if none
+  uint8_t cExtensionRsv = 0x00;                            ///< RSV bits owned by the negotiated extensions
+  WebSocketsDeflateSession * cDeflate = nullptr;           ///< permessage-deflate in cExtensionList, NULL if not in use
+
+  uint8_t * cReassembly          = nullptr;              ///< fragments of the current message, kept for the next ones
+  size_t cReassemblySize         = 0;                    ///< capacity of cReassembly, without the 0 termination
+  size_t cReassemblyLength       = 0;                    ///< bytes gathered so far
+  WSopcode_t cReassemblyOpcode   = WSop_continuation;    ///< opcode of the message being gathered, WSop_continuation = none
+
+  WSbulkMessage_t * cBulkQueue = nullptr;    ///< bulk messages to send, the first one may be sent partly
+  uint8_t cBulkCount           = 0;
+
+  uint8_t * cRxBuffer = nullptr;    ///< read-ahead of WEBSOCKETS_RX_BUFFER_SIZE bytes, allocated at the first frame
+  uint16_t cRxPos     = 0;          ///< next byte to hand out
+  uint16_t cRxLength  = 0;          ///< bytes in cRxBuffer
+
+  uint8_t * cTxBuffer = nullptr;    ///< corked frames, WEBSOCKETS_TX_BUFFER_SIZE bytes, allocated at the first one
+  uint16_t cTxLength  = 0;          ///< bytes in cTxBuffer
+
+  WebSocketsRelay * cRelay = nullptr;    ///< text and binary messages received go to its targets, see WebSocketsRelay
+  void * cRelayNext        = nullptr;    ///< next source of cRelay
+  bool cRelaying           = false;      ///< a fragmented message is being relayed
+  void * cRelayOwner       = nullptr;    ///< as a relay target: source connection whose fragmented message comes in
+
+  WebSocketsWriter * cWriter = nullptr;    ///< writer with a message open on the connection, see beginMessage()
+
   uint8_t cWsRXsize = 0;                            ///< State of the RX
   uint8_t cWsHeader[WEBSOCKETS_MAX_HEADER_SIZE];    ///< RX WS Message buffer
   WSMessageHeader_t cWsHeaderDecode;
@@ -662,8 +780,25 @@ typedef struct
 
 } WSclient_t;
 
+/**
+   wait strategy of a transport: block until the connection may be readable (write = false) or writable
+   @return false if it can't wait for this connection, the default polling is used then
+*/
+#ifdef __AVR__
+  typedef bool (*WSwaitCb)(WSclient_t * client, bool write, uint32_t timeoutUs);
+#else
+  typedef std::function<bool(WSclient_t * client, bool write, uint32_t timeoutUs)> WSwaitCb;
+#endif
+
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH)
+  bool WS_waitSocket(WSclient_t * client, bool write, uint32_t timeoutUs);
+#endif
+
 class WebSockets
 {
+  friend class WebSocketsWriter;
+  friend class WebSocketsRelay;
+
   protected:
 #ifdef __AVR__
     typedef void (*WSreadWaitCb)(WSclient_t * client, bool ok);
@@ -677,10 +812,64 @@ class WebSockets
     void clientDisconnect(WSclient_t * client, uint16_t code, char * reason = NULL, size_t reasonLen = 0);
 
     virtual void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin) = 0;
+    virtual void timeoutOccurred(WSclient_t * client, WStimeout_t timeout) = 0;
+    virtual void batchReceived(WSclient_t * client, WSmessage_t * messages, size_t count) = 0;
+
+    WebSocketsExtension * _extensions[WEBSOCKETS_MAX_EXTENSIONS] = { };
+    uint8_t _extensionCount = 0;
+    size_t _maxFrameSize    = 0;    ///< bigger messages are sent in fragments, 0 = one frame per message
+    size_t _reassemblySize  = 0;    ///< largest fragmented message put back together, 0 = fragments are passed on
+    bool _cork              = false;    ///< gather frames and write them at the end of loop(), see enableCork()
+    uint32_t _readTimeout   = WEBSOCKETS_TCP_TIMEOUT;    ///< ms a frame may stall while it is read
+    uint32_t _writeTimeout  = WEBSOCKETS_TCP_TIMEOUT;    ///< ms the driver may refuse data while a frame is written
+
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH)
+    WSwaitCb _waitCb = WS_waitSocket;    ///< lwIP select() on the socket
+#else
+    WSwaitCb _waitCb = NULL;
+#endif
+    WebSocketsDeflateExtension _deflate;    ///< built-in permessage-deflate, see enableCompression()
+
+    uint8_t * _batchBuffer       = nullptr;    ///< payloads of the gathered messages, NULL = batching is off
+    size_t _batchSize            = 0;
+    size_t _batchUsed            = 0;
+    WSmessage_t * _batchMessages = nullptr;
+    uint16_t _batchMax           = 0;
+    uint16_t _batchCount         = 0;
+    WSclient_t * _batchClient    = nullptr;    ///< connection the gathered messages came from
 
-    uint8_t createHeader(uint8_t * buf, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin);
+    uint8_t createHeader(uint8_t * buf, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin, uint8_t rsv = 0x00);
     bool sendFrameHeader(WSclient_t * client, WSopcode_t opcode, size_t length = 0, bool fin = true);
-    bool sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload = NULL, size_t length = 0, bool fin = true, bool headerToPayload = false);
+    bool sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload = NULL, size_t length = 0, bool fin = true, bool headerToPayload = false,
+                   bool encoded = false, uint8_t rsv = 0x00);
+    bool sendMessage(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool headerToPayload = false,
+                     bool encoded = false, uint8_t rsv = 0x00);
+    bool beginMessage(WSclient_t * client, WSopcode_t opcode, WebSocketsWriter & writer);
+    bool messageBlocked(WSclient_t * client);
+    void writerRelease(WSclient_t * client);
+
+    bool queueMessage(WSclient_t * client, WSopcode_t opcode, const uint8_t * payload, size_t length);
+    void handleBulk(WSclient_t * client);
+    void bulkFinish(WSclient_t * client);
+    void bulkRelease(WSclient_t * client);
+
+    bool relayAdd(WebSocketsRelay & relay, WSclient_t * client, bool slot);
+    bool relayRemove(WebSocketsRelay & relay, WSclient_t * client);
+    void relaySet(WSclient_t * client, WebSocketsRelay * relay);
+    void relayFinish(WSclient_t * client);
+    void relayRelease(WSclient_t * client);
+    void relayDetach(WSclient_t * client);
+
+    bool reassemble(WSclient_t * client, WSopcode_t * opcode, uint8_t ** payload, size_t * length, bool * fin);
+    void reassemblyRelease(WSclient_t * client);
+
+    bool batchEnable(size_t bufferSize, uint16_t maxMessages);
+    void batchRelease();
+    uint8_t * batchReserve(WSclient_t * client);
+    bool batchOwns(uint8_t * payload);
+    bool batchMessage(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
+    bool batchAdd(WSclient_t * client, WStype_t type, uint8_t * payload, size_t length);
+    void batchFlush();
 
     void headerDone(WSclient_t * client);
 
@@ -694,11 +883,35 @@ class WebSockets
     String base64_encode(uint8_t * data, size_t length);
 
     bool readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWaitCb cb);
+    int rxAvailable(WSclient_t * client);
+    void waitIO(WSclient_t * client, bool write, unsigned long since);
+    void rxRelease(WSclient_t * client);
     virtual size_t write(WSclient_t * client, uint8_t * out, size_t n);
     size_t write(WSclient_t * client, const char * out);
+    size_t tcpWrite(WSclient_t * client, const uint8_t * out, size_t n);
+    bool txFlush(WSclient_t * client);
+    void txRelease(WSclient_t * client);
 
     void enableHeartbeat(WSclient_t * client, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void handleHBTimeout(WSclient_t * client);
+
+    bool addExtension(WebSocketsExtension * extension);
+    void removeExtension(WebSocketsExtension * extension);
+
+    String extensionOffer();
+    bool extensionAccept(WSclient_t * client, String & response);
+    bool extensionConfirm(WSclient_t * client);
+    void extensionAdd(WSclient_t * client, WebSocketsExtension * extension, WebSocketsExtensionSession * session);
+    void extensionRelease(WSclient_t * client);
+    bool extensionEncode(WSclient_t * client, WSopcode_t opcode, const uint8_t * payload, size_t length, bool fin,
+                         uint8_t ** out, size_t * outLength, uint8_t * rsv);
+    bool extensionDecode(WSclient_t * client, uint8_t ** payload);
+
+#if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+    void handleWebsocketStream(WSclient_t * client);
+    void handleWebsocketRelay(WSclient_t * client);
+    void handleWebsocketBatch(WSclient_t * client);
+#endif
 };
 
 
@@ -719,6 +932,9 @@ String WS_IPAddressToString(IPAddress _address)
 #define UNUSED(var) (void)(var)
 #endif
 
+#include "WebSocketsWriter_Generic.h"
+#include "WebSocketsRelay_Generic.h"
+
 #include "WebSockets_Generic-Impl.h"
 
 #endif    // WEBSOCKETS_GENERIC_H_
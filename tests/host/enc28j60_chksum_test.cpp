@@ -0,0 +1,268 @@
+/****************************************************************************************************************************
+  enc28j60_chksum_test.cpp - Enc28J60Network::chksum() and the block transfers of the patched UIPEthernet driver,
+  against an emulated ENC28J60
+
+  Built against LibraryPatches/UIPEthernet as a SAMD board, so the SPI library block path is in, see Makefile.
+
+  - chksum() must give what the byte loop it replaced gave, for odd and even positions and lengths,
+    and for any number of packet bytes readPacket() left in uip_buf, odd ones included. Those bytes
+    are summed from uip_buf and must not be read from the chip again.
+  - chksum() reads the chip a chunk per SPI.transfer(), readPacket() in one block transfer.
+  - readPacket(), writePacket() and copyPacket() still move the right bytes.
+ *****************************************************************************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// to set up received packets and memory blocks without receivePacket() / MemoryPool
+#define protected public
+#define private public
+
+#include "utility/Enc28J60Network.h"
+
+#undef protected
+#undef private
+
+extern "C"
+{
+  #include "uip.h"
+}
+
+#include "Enc28J60Chip.h"
+#include "HostTest.h"
+
+// the driver default
+#ifndef ENC28J60_SPI_CHUNK_SIZE
+  #define ENC28J60_SPI_CHUNK_SIZE   32
+#endif
+
+uint8_t uip_buf[UIP_BUFSIZE + 2];
+struct memblock MemoryPool::blocks[NUM_MEMBLOCKS + 1];
+
+// odd, so 16 bit words of the packet don't line up with the chip memory
+#define PACKET_BEGIN    0x0101
+#define HEADER_LEN      54          // Ethernet 14 + IP 20 + TCP 20
+
+// The loop chksum() ran over the bytes from the SPI bus before, data[0] is the high byte
+static uint16_t byteLoopChksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+
+  for (uint16_t i = 0; i < len; i += 2)
+  {
+    t = (data[i] << 8) + ((i + 1 < len) ? data[i + 1] : 0);
+    sum += t;
+
+    if (sum < t)
+      sum++;
+  }
+
+  return sum;
+}
+
+static const uint8_t * packetData()
+{
+  return ENC28J60.mem + PACKET_BEGIN;
+}
+
+static void receive(uint16_t len)
+{
+  for (uint16_t i = 0; i < len; i++)
+    ENC28J60.mem[PACKET_BEGIN + i] = rand();
+
+  Enc28J60Network::receivePkt.begin = PACKET_BEGIN;
+  Enc28J60Network::receivePkt.size  = len;
+  Enc28J60Network::receiveBuffered  = 0;
+}
+
+static unsigned long chunks(uint16_t len)
+{
+  return (len + ENC28J60_SPI_CHUNK_SIZE - 1) / ENC28J60_SPI_CHUNK_SIZE;
+}
+
+// UIPEthernetClass::tick() reads the packet start to uip_buf, upper_layer_chksum() sums the
+// TCP header from there and the payload from the chip
+static void testTcpChksum()
+{
+  static const uint16_t payloads[] = { 0, 1, 2, 7, 44, 45, 46, 100, 501, 1400 };
+
+  printf("chksum of received TCP segments\n");
+
+  for (uint16_t payload : payloads)
+  {
+    uint16_t total = HEADER_LEN + payload;
+
+    receive(total);
+
+    uint16_t n = Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 0, (uint8_t *) uip_buf, UIP_BUFSIZE);
+
+    CHECK_EQ(n, (total < UIP_BUFSIZE) ? total : UIP_BUFSIZE);
+    CHECK_EQ(Enc28J60Network::receiveBuffered, n);
+    CHECK(memcmp(uip_buf, packetData(), n) == 0);
+
+    // IP header, all in uip_buf
+    SPI.resetCounters();
+    CHECK_EQ(Enc28J60Network::chksum(0, UIP_RECEIVEBUFFERHANDLE, 14, 20), byteLoopChksum(0, packetData() + 14, 20));
+    CHECK_EQ(SPI.frames, 0);
+
+    // pseudo header sum, TCP header and payload
+    ENC28J60.bufferReads = 0;
+    CHECK_EQ(Enc28J60Network::chksum(0x1234, UIP_RECEIVEBUFFERHANDLE, 34, 20 + payload),
+             byteLoopChksum(0x1234, packetData() + 34, 20 + payload));
+    CHECK_EQ(ENC28J60.bufferReads, total - n);
+  }
+}
+
+// any count of bytes in uip_buf, from any position, with any length
+static void testBufferedSweep()
+{
+  static const uint16_t buffered[] = { 0, 1, 2, 3, 33, 34, 35, 41, 97, 98 };
+  static const uint16_t lengths[]  = { 0, 1, 2, 3, 4, 5, 31, 32, 33, 64, 65, 200, 0xFFFF };
+  const uint16_t total = 300;
+  unsigned long sums = 0;
+
+  printf("chksum with 0 - %u packet bytes in uip_buf\n", UIP_BUFSIZE);
+
+  receive(total);
+
+  for (uint16_t b : buffered)
+  {
+    // odd ones come from readPacket() of a part of the packet to uip_buf
+    Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 0, (uint8_t *) uip_buf, b);
+    CHECK_EQ(Enc28J60Network::receiveBuffered, b);
+
+    for (uint16_t pos = 0; pos <= b + 3; pos++)
+    {
+      for (uint16_t len : lengths)
+      {
+        uint16_t n = (len < total - pos) ? len : (total - pos);
+
+        // bytes that have to come from the chip, the uip_buf part ends on a high byte
+        uint16_t fromBuffer = (pos < b) ? (b - pos) : 0;
+
+        if (fromBuffer >= n)
+          fromBuffer = n;
+        else
+          fromBuffer &= ~1;
+
+        ENC28J60.bufferReads = 0;
+        CHECK_EQ(Enc28J60Network::chksum(0xFF00 + pos, UIP_RECEIVEBUFFERHANDLE, pos, len),
+                 byteLoopChksum(0xFF00 + pos, packetData() + pos, n));
+        CHECK_EQ(ENC28J60.bufferReads, n - fromBuffer);
+        sums++;
+      }
+    }
+  }
+
+  // reading the packet elsewhere, or freeing it, leaves nothing in uip_buf
+  uint8_t app[16];
+
+  Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 0, (uint8_t *) uip_buf, 40);
+  Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 0, app, sizeof(app));
+  CHECK_EQ(Enc28J60Network::receiveBuffered, 0);
+
+  Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 0, (uint8_t *) uip_buf, 40);
+  Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 2, (uint8_t *) uip_buf, 20);
+  CHECK_EQ(Enc28J60Network::receiveBuffered, 0);
+
+  Enc28J60Network::readPacket(UIP_RECEIVEBUFFERHANDLE, 0, (uint8_t *) uip_buf, 40);
+  Enc28J60Network::freePacket();
+  CHECK_EQ(Enc28J60Network::receiveBuffered, 0);
+
+  printf("  %lu sums\n", sums);
+}
+
+// SPI.transfer() calls of a chksum() read from the chip, on top of one that reads a single byte
+static void testChksumTransfers()
+{
+  static const uint16_t lengths[] = { 2, 31, 32, 33, 64, 501, 1400 };
+  const uint16_t total = 1500;
+
+  printf("chksum SPI transfers, %u byte chunks\n", ENC28J60_SPI_CHUNK_SIZE);
+
+  receive(total);
+
+  SPI.resetCounters();
+  Enc28J60Network::chksum(0, UIP_RECEIVEBUFFERHANDLE, 0, 1);
+  SPI.resetCounters();
+  Enc28J60Network::chksum(0, UIP_RECEIVEBUFFERHANDLE, 0, 1);
+
+  unsigned long single = SPI.transfers;
+
+  for (uint16_t len : lengths)
+  {
+    SPI.resetCounters();
+    CHECK_EQ(Enc28J60Network::chksum(0, UIP_RECEIVEBUFFERHANDLE, 0, len), byteLoopChksum(0, packetData(), len));
+    CHECK_EQ(SPI.transfers - single, chunks(len) - 1);
+    CHECK_EQ(SPI.unselectedBytes, 0);
+  }
+}
+
+// uipclient_appcall() copies the payload to a memory block, the application reads it from there
+static void testBlocks()
+{
+  static uint8_t app[1500], out[600];
+  const uint16_t payload = 1001;
+
+  printf("readPacket / writePacket / copyPacket\n");
+
+  receive(HEADER_LEN + payload);
+
+  Enc28J60Network::blocks[1].begin = 0x1801;
+  Enc28J60Network::blocks[1].size  = payload;
+  Enc28J60Network::copyPacket(1, 0, UIP_RECEIVEBUFFERHANDLE, HEADER_LEN, payload);
+  CHECK(memcmp(ENC28J60.mem + 0x1801, packetData() + HEADER_LEN, payload) == 0);
+
+  SPI.resetCounters();
+  CHECK_EQ(Enc28J60Network::readPacket(1, 0, app, sizeof(app)), payload);
+  CHECK(memcmp(app, packetData() + HEADER_LEN, payload) == 0);
+
+  unsigned long readTransfers = SPI.transfers;
+
+  // only the data transfer grows with the length
+  SPI.resetCounters();
+  CHECK_EQ(Enc28J60Network::readPacket(1, 0, app, 1), 1);
+  CHECK_EQ(SPI.transfers, readTransfers);
+
+  // a memory block is never in uip_buf, odd position
+  CHECK_EQ(Enc28J60Network::chksum(0x1234, 1, 1, payload), byteLoopChksum(0x1234, app + 1, payload - 1));
+
+  for (uint16_t i = 0; i < sizeof(out); i++)
+    out[i] = i * 3;
+
+  Enc28J60Network::blocks[2].begin = 0x1C00;
+  Enc28J60Network::blocks[2].size  = sizeof(out);
+
+  SPI.resetCounters();
+  CHECK_EQ(Enc28J60Network::writePacket(2, 0, out, sizeof(out)), sizeof(out));
+  CHECK(memcmp(ENC28J60.mem + 0x1C00, out, sizeof(out)) == 0);
+
+  // the data is copied before the in place transfers overwrite it
+  CHECK_EQ(out[sizeof(out) - 1], (uint8_t) ((sizeof(out) - 1) * 3));
+
+  unsigned long writeTransfers = SPI.transfers;
+
+  SPI.resetCounters();
+  CHECK_EQ(Enc28J60Network::writePacket(2, 0, out, 1), 1);
+
+#if defined(SPI_HAS_TRANSFER_BUF)
+  CHECK_EQ(writeTransfers, SPI.transfers);
+#else
+  CHECK_EQ(writeTransfers - SPI.transfers, chunks(sizeof(out)) - 1);
+#endif
+}
+
+int main()
+{
+  srand(1);
+  ENC28J60.reset();
+
+  testTcpChksum();
+  testBufferedSweep();
+  testChksumTransfers();
+  testBlocks();
+
+  CHECK_EQ(ENC28J60.errors, 0);
+
+  return HOST_TEST_RESULT("enc28j60_chksum_test");
+}
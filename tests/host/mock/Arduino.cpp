@@ -0,0 +1,75 @@
+/****************************************************************************************************************************
+  Arduino.cpp - minimal Arduino core for the host tests of the LibraryPatches drivers
+ *****************************************************************************************************************************/
+
+#include "Arduino.h"
+#include "SPI.h"
+
+HardwareSerial Serial;
+SPIClass       SPI;
+
+// simulated time, delay() moves it on and every millis() call ticks it, so polling loops end
+static unsigned long mockMicros = 0;
+
+void SPIClass::chipSelect(bool active)
+{
+  if (active && !selected)
+  {
+    frames++;
+
+    if (device)
+      device->select();
+  }
+  else if (!active && selected && device)
+  {
+    device->deselect();
+  }
+
+  selected = active;
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t, uint8_t val)
+{
+  SPI.chipSelect(val == LOW);
+}
+
+unsigned long millis()
+{
+  mockMicros += 1000;
+
+  return mockMicros / 1000;
+}
+
+unsigned long micros()
+{
+  return ++mockMicros;
+}
+
+void delay(unsigned long ms)
+{
+  mockMicros += ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  mockMicros += us;
+}
+
+long random(long howbig)
+{
+  return howbig ? (rand() % howbig) : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+  return (howsmall < howbig) ? (howsmall + random(howbig - howsmall)) : howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  srand(seed);
+}
@@ -0,0 +1,101 @@
+/****************************************************************************************************************************
+  Arduino.h - minimal Arduino core for the host tests of the LibraryPatches drivers
+
+  Only what the W5x00 and ENC28J60 drivers use. digitalWrite() is routed to the mock SPI bus,
+  so that chip select edges frame the SPI transactions.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARDUINO       10813
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+
+#define DEC           10
+#define HEX           16
+
+typedef uint8_t byte;
+
+// flash strings are plain strings on the host
+#define F(s)          (s)
+
+// SPI pins of the board variant
+#define SS            10
+#define PIN_SPI_MOSI  11
+#define PIN_SPI_MISO  12
+#define PIN_SPI_SCK   13
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+inline void yield() {}
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+      size_t n = 0;
+
+      while (size--)
+        n += write(*buffer++);
+
+      return n;
+    }
+
+    size_t write(const char *str)
+    {
+      return write((const uint8_t *) str, strlen(str));
+    }
+
+    // drivers only print debug output, which the tests drop
+    template<class T> size_t print(T) { return 0; }
+    template<class T> size_t print(T, int) { return 0; }
+    template<class T> size_t println(T) { return 0; }
+    template<class T> size_t println(T, int) { return 0; }
+    size_t println() { return 0; }
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+};
+
+class HardwareSerial : public Stream
+{
+  public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t) { return 1; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#include "IPAddress.h"
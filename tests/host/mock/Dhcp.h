@@ -0,0 +1,15 @@
+/****************************************************************************************************************************
+  Dhcp.h - stand-in for the Ethernet library Dhcp.h in the host tests of the LibraryPatches drivers
+
+  DhcpClass is declared in Ethernet.h / EthernetLarge.h. The tests never start DHCP, so the
+  DHCP sources are not built and the unused callers are dropped by the linker.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+// EthernetClass::maintain() results
+#define DHCP_CHECK_NONE         (0)
+#define DHCP_CHECK_RENEW_FAIL   (1)
+#define DHCP_CHECK_RENEW_OK     (2)
+#define DHCP_CHECK_REBIND_FAIL  (3)
+#define DHCP_CHECK_REBIND_OK    (4)
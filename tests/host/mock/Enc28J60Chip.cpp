@@ -0,0 +1,127 @@
+/****************************************************************************************************************************
+  Enc28J60Chip.cpp - emulated Microchip ENC28J60 on the mock SPI bus
+ *****************************************************************************************************************************/
+
+#include "Enc28J60Chip.h"
+
+Enc28J60Chip ENC28J60;
+
+// opcodes, upper 3 bits of the first byte of a frame
+#define OP_RCR        0x00
+#define OP_RBM        0x20
+#define OP_WCR        0x40
+#define OP_WBM        0x60
+#define OP_BFS        0x80
+#define OP_BFC        0xA0
+
+// bank 0 pointers and the common ECON1
+#define REG_ERDPTL    0x00
+#define REG_EWRPTL    0x02
+#define REG_EDMASTL   0x10
+#define REG_EDMANDL   0x12
+#define REG_EDMADSTL  0x14
+#define REG_ECON1     0x1F
+
+#define ECON1_DMAST   0x20
+#define ECON1_BSEL    0x03
+
+void Enc28J60Chip::reset()
+{
+  errors      = 0;
+  bufferReads = 0;
+  memset(mem, 0, sizeof(mem));
+  memset(regs, 0, sizeof(regs));
+
+  opcodeDone = false;
+  SPI.device = this;
+}
+
+uint8_t& Enc28J60Chip::reg(uint8_t address)
+{
+  address &= REGS - 1;
+
+  if (address >= 0x1B)
+    return regs[0][address];
+
+  return regs[regs[0][REG_ECON1] & ECON1_BSEL][address];
+}
+
+uint16_t Enc28J60Chip::pointer(uint8_t address)
+{
+  return regs[0][address] | (regs[0][address + 1] << 8);
+}
+
+void Enc28J60Chip::setPointer(uint8_t address, uint16_t value)
+{
+  regs[0][address]     = value & 0xFF;
+  regs[0][address + 1] = value >> 8;
+}
+
+void Enc28J60Chip::select()
+{
+  opcodeDone = false;
+}
+
+uint8_t Enc28J60Chip::exchange(uint8_t out)
+{
+  if (!opcodeDone)
+  {
+    opcodeDone = true;
+    opcode     = out & 0xE0;
+    argument   = out & 0x1F;
+
+    return 0;
+  }
+
+  uint16_t p;
+
+  switch (opcode)
+  {
+    case OP_RBM:
+      p = pointer(REG_ERDPTL);
+      setPointer(REG_ERDPTL, p + 1);
+      bufferReads++;
+
+      return mem[p & (MEM_SIZE - 1)];
+
+    case OP_WBM:
+      p = pointer(REG_EWRPTL);
+      setPointer(REG_EWRPTL, p + 1);
+      mem[p & (MEM_SIZE - 1)] = out;
+
+      return 0;
+
+    case OP_RCR:
+      return reg(argument);
+
+    case OP_WCR:
+      reg(argument) = out;
+      break;
+
+    case OP_BFS:
+      reg(argument) |= out;
+      break;
+
+    case OP_BFC:
+      reg(argument) &= ~out;
+      break;
+
+    default:
+      // the soft reset has no data byte
+      errors++;
+
+      return 0;
+  }
+
+  if ((argument == REG_ECON1) && (regs[0][REG_ECON1] & ECON1_DMAST))
+  {
+    uint16_t dest = pointer(REG_EDMADSTL);
+
+    for (uint16_t src = pointer(REG_EDMASTL); src <= pointer(REG_EDMANDL); src++)
+      mem[dest++ & (MEM_SIZE - 1)] = mem[src & (MEM_SIZE - 1)];
+
+    regs[0][REG_ECON1] &= ~ECON1_DMAST;
+  }
+
+  return 0;
+}
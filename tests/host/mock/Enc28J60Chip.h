@@ -0,0 +1,56 @@
+/****************************************************************************************************************************
+  Enc28J60Chip.h - emulated Microchip ENC28J60 on the mock SPI bus
+
+  Speaks the SPI opcodes the UIPEthernet driver uses, one opcode byte per chip select frame:
+  - RBM / WBM: buffer memory read / write through ERDPT / EWRPT, which step on with every data byte
+  - RCR / WCR / BFS / BFC: control registers, banked by ECON1.BSEL, 0x1B - 0x1F in all banks
+  - ECON1.DMAST: the DMA copy from EDMAST - EDMAND to EDMADST is done at once
+
+  The packets of the tests stay clear of the receive buffer end, ERDPT doesn't wrap at ERXND.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include "SPI.h"
+
+class Enc28J60Chip : public SPIDevice
+{
+  public:
+    enum
+    {
+      MEM_SIZE  = 0x2000,
+      BANKS     = 4,
+      REGS      = 0x20
+    };
+
+    // 8 KB buffer memory
+    uint8_t mem[MEM_SIZE];
+
+    // control registers, the common ones 0x1B - 0x1F live in bank 0
+    uint8_t regs[BANKS][REGS];
+
+    // opcodes the emulation doesn't know
+    unsigned long errors = 0;
+
+    // buffer memory bytes read out by RBM
+    unsigned long bufferReads = 0;
+
+    void reset();
+
+    // register address of the current bank, or a common one
+    uint8_t& reg(uint8_t address);
+
+    // 16 bit register pair in bank 0, low byte first (ERDPT, EWRPT, EDMAST, ...)
+    uint16_t pointer(uint8_t address);
+    void setPointer(uint8_t address, uint16_t value);
+
+    void select();
+    uint8_t exchange(uint8_t out);
+
+  private:
+    bool    opcodeDone;
+    uint8_t opcode;
+    uint8_t argument;
+};
+
+extern Enc28J60Chip ENC28J60;
@@ -0,0 +1,31 @@
+/****************************************************************************************************************************
+  HostTest.h - check macros for the host tests of the LibraryPatches drivers
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond)                                                                 \
+  do {                                                                              \
+    if (!(cond)) {                                                                  \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);               \
+      hostTestFailures++;                                                           \
+    }                                                                               \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                                  \
+  do {                                                                              \
+    unsigned long _a = (unsigned long) (actual);                                    \
+    unsigned long _e = (unsigned long) (expected);                                  \
+    if (_a != _e) {                                                                 \
+      printf("%s:%d: %s is %lu, expected %lu\n", __FILE__, __LINE__, #actual, _a, _e); \
+      hostTestFailures++;                                                           \
+    }                                                                               \
+  } while (0)
+
+// return value of main()
+#define HOST_TEST_RESULT(name)                                                      \
+  (printf("%s: %s\n", name, hostTestFailures ? "FAILED" : "OK"), hostTestFailures ? 1 : 0)
@@ -0,0 +1,44 @@
+/****************************************************************************************************************************
+  IPAddress.h - minimal Arduino IPAddress for the host tests of the LibraryPatches drivers
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+class IPAddress
+{
+  private:
+    union
+    {
+      uint8_t  bytes[4];
+      uint32_t dword;
+    } _address;
+
+    // Ethernet.cpp sets the chip addresses from _address.bytes, as with the Arduino core
+    friend class EthernetClass;
+
+  public:
+    IPAddress() { _address.dword = 0; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+      _address.bytes[0] = a;
+      _address.bytes[1] = b;
+      _address.bytes[2] = c;
+      _address.bytes[3] = d;
+    }
+    IPAddress(uint32_t address) { _address.dword = address; }
+    IPAddress(const uint8_t *address) { memcpy(_address.bytes, address, 4); }
+
+    operator uint32_t() const { return _address.dword; }
+    bool operator==(const IPAddress& addr) const { return _address.dword == addr._address.dword; }
+    bool operator==(const uint8_t *addr) const { return memcmp(addr, _address.bytes, 4) == 0; }
+
+    uint8_t operator[](int index) const { return _address.bytes[index]; }
+    uint8_t& operator[](int index) { return _address.bytes[index]; }
+
+    uint8_t * raw_address() { return _address.bytes; }
+};
+
+const IPAddress INADDR_NONE(0, 0, 0, 0);
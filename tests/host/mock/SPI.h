@@ -0,0 +1,142 @@
+/****************************************************************************************************************************
+  SPI.h - mock SPI bus for the host tests of the LibraryPatches drivers
+
+  Every byte clocked on the bus goes to the emulated chip in SPI.device. The bus counts the SPI
+  calls the driver makes, the bytes they move and the chip select frames, which is what the
+  block transfer patches of the drivers are meant to cut down.
+
+  Define SPI_HAS_TRANSFER_BUF to get the separate TX / RX buffer transfer of newer cores.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include "Arduino.h"
+
+#define SPI_HAS_TRANSACTION     1
+
+#define SPI_MODE0               0x00
+#define SPI_MODE1               0x04
+#define SPI_MODE2               0x08
+#define SPI_MODE3               0x0C
+
+#define MSBFIRST                1
+#define LSBFIRST                0
+
+#define SPI_CLOCK_DIV2          0x04
+
+class SPISettings
+{
+  public:
+    SPISettings() {}
+    SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+// An emulated SPI chip, select() / deselect() follow its chip select pin
+class SPIDevice
+{
+  public:
+    virtual ~SPIDevice() {}
+
+    virtual void select() {}
+    virtual void deselect() {}
+
+    // one byte out on MOSI, the returned one comes back on MISO
+    virtual uint8_t exchange(uint8_t out) = 0;
+};
+
+class SPIClass
+{
+  public:
+    SPIDevice * device = NULL;
+
+    // SPI.transfer() calls of any kind, bytes clocked, chip select frames
+    unsigned long transfers = 0;
+    unsigned long bytes     = 0;
+    unsigned long frames    = 0;
+
+    // bytes clocked while no chip was selected
+    unsigned long unselectedBytes = 0;
+
+    bool selected = false;
+
+    void resetCounters()
+    {
+      transfers       = 0;
+      bytes           = 0;
+      frames          = 0;
+      unselectedBytes = 0;
+    }
+
+    // called by digitalWrite() on any pin, only the chip select pin is toggled in the tests
+    void chipSelect(bool active);
+
+    void begin() {}
+    void end() {}
+    void beginTransaction(SPISettings) {}
+    void endTransaction() {}
+    void setBitOrder(uint8_t) {}
+    void setDataMode(uint8_t) {}
+    void setClockDivider(uint8_t) {}
+
+    uint8_t transfer(uint8_t data)
+    {
+      transfers++;
+
+      return exchange(data);
+    }
+
+    uint16_t transfer16(uint16_t data)
+    {
+      transfers++;
+
+      uint16_t hi = exchange(data >> 8);
+
+      return (hi << 8) | exchange(data & 0xFF);
+    }
+
+    // in place, buf is overwritten with the received bytes
+    void transfer(void *buf, size_t count)
+    {
+      uint8_t *p = (uint8_t *) buf;
+
+      transfers++;
+
+      while (count--)
+      {
+        *p = exchange(*p);
+        p++;
+      }
+    }
+
+#if defined(SPI_HAS_TRANSFER_BUF)
+    // tx or rx may be NULL
+    void transfer(const void *tx, void *rx, size_t count)
+    {
+      const uint8_t *out = (const uint8_t *) tx;
+      uint8_t       *in  = (uint8_t *) rx;
+
+      transfers++;
+
+      for (size_t i = 0; i < count; i++)
+      {
+        uint8_t b = exchange(out ? out[i] : 0xFF);
+
+        if (in)
+          in[i] = b;
+      }
+    }
+#endif
+
+  private:
+    uint8_t exchange(uint8_t out)
+    {
+      bytes++;
+
+      if (!selected)
+        unselectedBytes++;
+
+      return (selected && device) ? device->exchange(out) : 0xFF;
+    }
+};
+
+extern SPIClass SPI;
@@ -0,0 +1,13 @@
+/****************************************************************************************************************************
+  Server.h - minimal Arduino Server for the host tests of the LibraryPatches drivers
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include "Arduino.h"
+
+class Server : public Print
+{
+  public:
+    virtual void begin() = 0;
+};
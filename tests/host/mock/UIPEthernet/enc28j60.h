@@ -0,0 +1,114 @@
+/****************************************************************************************************************************
+  enc28j60.h - stand-in for the UIPEthernet utility/enc28j60.h in the host tests of the patched Enc28J60Network
+
+  LibraryPatches/UIPEthernet only carries Enc28J60Network.cpp / .h. The register addresses, bits
+  and opcodes here are the ones of the library header, with bank bits 5 - 6 and bit 7 for MAC / MII.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#define ADDR_MASK              0x1F
+#define BANK_MASK              0x60
+
+// common registers, all banks
+#define EIE                    0x1B
+#define EIR                    0x1C
+#define ESTAT                  0x1D
+#define ECON2                  0x1E
+#define ECON1                  0x1F
+
+// bank 0
+#define ERDPTL                 (0x00|0x00)
+#define EWRPTL                 (0x02|0x00)
+#define ETXSTL                 (0x04|0x00)
+#define ETXNDL                 (0x06|0x00)
+#define ERXSTL                 (0x08|0x00)
+#define ERXNDL                 (0x0A|0x00)
+#define ERXRDPTL               (0x0C|0x00)
+#define EDMASTL                (0x10|0x00)
+#define EDMANDL                (0x12|0x00)
+#define EDMADSTL               (0x14|0x00)
+
+// bank 1
+#define EPMM0                  (0x08|0x20)
+#define EPMM1                  (0x09|0x20)
+#define EPMCSL                 (0x10|0x20)
+#define ERXFCON                (0x18|0x20)
+#define EPKTCNT                (0x19|0x20)
+
+// bank 2
+#define MACON1                 (0x00|0x40|0x80)
+#define MACON2                 (0x01|0x40|0x80)
+#define MACON3                 (0x02|0x40|0x80)
+#define MABBIPG                (0x04|0x40|0x80)
+#define MAIPGL                 (0x06|0x40|0x80)
+#define MICMD                  (0x12|0x40|0x80)
+#define MIREGADR               (0x14|0x40|0x80)
+#define MIWRL                  (0x16|0x40|0x80)
+#define MIRDL                  (0x18|0x40|0x80)
+#define MIRDH                  (0x19|0x40|0x80)
+#define MAMXFLL                (0x0A|0x40|0x80)
+
+// bank 3
+#define MAADR1                 (0x00|0x60|0x80)
+#define MAADR0                 (0x01|0x60|0x80)
+#define MAADR3                 (0x02|0x60|0x80)
+#define MAADR2                 (0x03|0x60|0x80)
+#define MAADR5                 (0x04|0x60|0x80)
+#define MAADR4                 (0x05|0x60|0x80)
+#define MISTAT                 (0x0A|0x60|0x80)
+#define EREVID                 (0x12|0x60)
+#define ECOCON                 (0x15|0x60)
+
+// PHY registers
+#define PHCON2                 0x10
+#define PHSTAT2                0x11
+#define PHLCON                 0x14
+
+// register bits
+#define ERXFCON_UCEN           0x80
+#define ERXFCON_CRCEN          0x20
+#define ERXFCON_PMEN           0x10
+#define ERXFCON_MCEN           0x02
+#define ERXFCON_BCEN           0x01
+#define EIE_INTIE              0x80
+#define EIE_PKTIE              0x40
+#define EIR_TXIF               0x08
+#define EIR_TXERIF             0x02
+#define ESTAT_CLKRDY           0x01
+#define ECON2_PKTDEC           0x40
+#define ECON2_PWRSV            0x20
+#define ECON2_VRPS             0x08
+#define ECON1_TXRST            0x80
+#define ECON1_RXRST            0x40
+#define ECON1_DMAST            0x20
+#define ECON1_CSUMEN           0x10
+#define ECON1_TXRTS            0x08
+#define ECON1_RXEN             0x04
+#define ECON1_BSEL1            0x02
+#define ECON1_BSEL0            0x01
+#define MACON1_TXPAUS          0x08
+#define MACON1_RXPAUS          0x04
+#define MACON1_MARXEN          0x01
+#define MACON3_PADCFG0         0x20
+#define MACON3_TXCRCEN         0x10
+#define MACON3_FRMLNEN         0x02
+#define MICMD_MIIRD            0x01
+#define MISTAT_BUSY            0x01
+#define PHCON2_HDLDIS          0x0100
+
+// SPI opcodes
+#define ENC28J60_READ_CTRL_REG 0x00
+#define ENC28J60_READ_BUF_MEM  0x3A
+#define ENC28J60_WRITE_CTRL_REG 0x40
+#define ENC28J60_WRITE_BUF_MEM 0x7A
+#define ENC28J60_BIT_FIELD_SET 0x80
+#define ENC28J60_BIT_FIELD_CLR 0xA0
+#define ENC28J60_SOFT_RESET    0xFF
+
+// buffer layout, receive buffer first
+#define RXSTART_INIT           0x0
+#define RXSTOP_INIT            0x17FF
+#define TXSTART_INIT           0x1800
+#define TXSTOP_INIT            0x1FFF
+#define MAX_FRAMELEN           1500
@@ -0,0 +1,17 @@
+/****************************************************************************************************************************
+  logging.h - stand-in for the UIPEthernet utility/logging.h in the host tests of the patched Enc28J60Network
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#define LOG_NONE        0
+#define LOG_ERR         3
+#define LOG_ERROR       3
+#define LOG_WARN        4
+#define LOG_INFO        6
+#define LOG_DEBUG       7
+#define LOG_DEBUG_V1    8
+#define LOG_DEBUG_V2    9
+#define LOG_DEBUG_V3    10
+
+#define ACTLOGLEVEL     LOG_NONE
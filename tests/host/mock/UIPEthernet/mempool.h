@@ -0,0 +1,35 @@
+/****************************************************************************************************************************
+  mempool.h - stand-in for the UIPEthernet utility/mempool.h in the host tests of the patched Enc28J60Network
+
+  Only the block table the driver reads, the tests place the blocks in it themselves.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint16_t memaddress;
+typedef uint8_t  memhandle;
+
+#define NOBLOCK         0
+#define NUM_MEMBLOCKS   8
+
+struct memblock
+{
+  memaddress begin;
+  memaddress size;
+  memhandle  nextblock;
+};
+
+class MemoryPool
+{
+  protected:
+    static struct memblock blocks[NUM_MEMBLOCKS + 1];
+
+  public:
+    static void init() {}
+    static memhandle allocBlock(memaddress) { return NOBLOCK; }
+    static void freeBlock(memhandle) {}
+};
+
+void enc28J60_mempool_block_move_callback(memaddress, memaddress, memaddress);
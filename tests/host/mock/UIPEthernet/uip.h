@@ -0,0 +1,13 @@
+/****************************************************************************************************************************
+  uip.h - stand-in for the UIPEthernet utility/uip.h in the host tests of the patched Enc28J60Network
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef UIP_BUFSIZE
+  #define UIP_BUFSIZE   98
+#endif
+
+extern uint8_t uip_buf[UIP_BUFSIZE + 2];
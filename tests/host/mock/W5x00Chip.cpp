@@ -0,0 +1,316 @@
+/****************************************************************************************************************************
+  W5x00Chip.cpp - emulated WIZnet W5100 / W5200 / W5500 on the mock SPI bus
+ *****************************************************************************************************************************/
+
+#include "W5x00Chip.h"
+
+W5x00Chip W5x00;
+
+void W5x00Chip::reset(uint8_t model)
+{
+  chip   = model;
+  errors = 0;
+  memset(mem, 0, sizeof(mem));
+
+  // VERSIONR
+  if (chip == 52)
+    mem[BLOCK_COMMON][0x001F] = 3;
+  else if (chip == 55)
+    mem[BLOCK_COMMON][0x0039] = 4;
+
+  // socket buffers reset to 2 KB: TMSR / RMSR on the W5100, Sn_RXBUF_SIZE / Sn_TXBUF_SIZE
+  if (chip == 51)
+  {
+    mem[0][0x001A] = 0x55;
+    mem[0][0x001B] = 0x55;
+  }
+  else
+  {
+    for (uint8_t s = 0; s < 8; s++)
+    {
+      sn(s, 0x001E) = 2;
+      sn(s, 0x001F) = 2;
+    }
+  }
+
+  pos       = 0;
+  rxPending = false;
+  autoAck   = true;
+  sends     = 0;
+  SPI.device = this;
+
+  // sockets closed, their TX buffers free
+  for (uint8_t s = 0; s < ((chip == 51) ? 4 : 8); s++)
+    ack(s);
+}
+
+static void add16(uint8_t *hi, uint8_t *lo, uint16_t n)
+{
+  uint16_t v = ((*hi << 8) | *lo) + n;
+
+  *hi = v >> 8;
+  *lo = v & 0xFF;
+}
+
+void W5x00Chip::receive(uint8_t s, uint16_t len)
+{
+  add16(&sn(s, 0x0026), &sn(s, 0x0027), len);     // Sn_RX_RSR
+  add16(&sn(s, 0x002A), &sn(s, 0x002B), len);     // Sn_RX_WR
+}
+
+void W5x00Chip::receiveAfter(uint8_t s, unsigned long dataBytes, uint16_t len)
+{
+  rxPending = true;
+  rxSocket  = s;
+  rxAfter   = dataBytes;
+  rxLen     = len;
+}
+
+uint16_t W5x00Chip::sn16(uint8_t s, uint16_t offset)
+{
+  return (sn(s, offset) << 8) | sn(s, offset + 1);
+}
+
+void W5x00Chip::setSn16(uint8_t s, uint16_t offset, uint16_t value)
+{
+  sn(s, offset)     = value >> 8;
+  sn(s, offset + 1) = value & 0xFF;
+}
+
+// the W5100 gives each socket 2 bits of TMSR / RMSR, the others have a KB count per socket
+uint16_t W5x00Chip::txSize(uint8_t s)
+{
+  if (chip == 51)
+    return 1024 << ((mem[0][0x001B] >> (2 * s)) & 0x03);
+
+  return sn(s, 0x001F) << 10;
+}
+
+uint16_t W5x00Chip::rxSize(uint8_t s)
+{
+  if (chip == 51)
+    return 1024 << ((mem[0][0x001A] >> (2 * s)) & 0x03);
+
+  return sn(s, 0x001E) << 10;
+}
+
+// Sn_TX_FSR is what the TX buffer holds beyond the data in flight, Sn_TX_RD up to Sn_TX_WR
+void W5x00Chip::ack(uint8_t s)
+{
+  setSn16(s, 0x0022, sn16(s, 0x0024));
+  setSn16(s, 0x0020, txSize(s));
+}
+
+void W5x00Chip::command(uint8_t s, uint8_t cmd)
+{
+  if (cmd == 0x01)
+  {
+    // OPEN, the buffer sizes are set by now
+    ack(s);
+  }
+  else if (cmd == 0x20)
+  {
+    // SEND
+    sends++;
+    sn(s, 0x0002) |= 0x10;
+
+    if (autoAck)
+      ack(s);
+    else
+      setSn16(s, 0x0020, txSize(s) - (uint16_t) (sn16(s, 0x0024) - sn16(s, 0x0022)));
+  }
+  else if (cmd == 0x40)
+  {
+    // RECV
+    setSn16(s, 0x0026, sn16(s, 0x002A) - sn16(s, 0x0028));
+  }
+
+  sn(s, 0x0001) = 0;
+}
+
+// socket and register offset of the byte at p, if it is a socket register
+bool W5x00Chip::socketRegister(const uint8_t *p, uint8_t *s, uint16_t *offset)
+{
+  uint16_t base = (chip == 51) ? 0x0400 : 0x4000;
+  uint8_t  count = (chip == 51) ? 4 : 8;
+
+  if (chip == 55)
+  {
+    for (uint8_t n = 0; n < 8; n++)
+    {
+      if ((p >= mem[(n << 2) + 1]) && (p < mem[(n << 2) + 1] + 0x0100))
+      {
+        *s      = n;
+        *offset = p - mem[(n << 2) + 1];
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  if ((p < &mem[0][base]) || (p >= &mem[0][base + (count << 8)]))
+    return false;
+
+  *s      = (p - &mem[0][base]) >> 8;
+  *offset = (p - &mem[0][base]) & 0xFF;
+
+  return true;
+}
+
+uint8_t& W5x00Chip::sn(uint8_t s, uint16_t offset)
+{
+  if (chip == 51)
+    return mem[0][0x0400 + (s << 8) + offset];
+  else if (chip == 52)
+    return mem[0][0x4000 + (s << 8) + offset];
+
+  return mem[(s << 2) + 1][offset];
+}
+
+void W5x00Chip::select()
+{
+  pos       = 0;
+  valid     = true;
+  writing   = false;
+  remaining = 0;
+}
+
+void W5x00Chip::deselect()
+{
+  // a W5200 frame must carry exactly the announced length
+  if ((chip == 52) && valid && (pos >= 4) && remaining)
+    errors++;
+}
+
+// one data byte at addr of the current block, MR and VERSIONR behave like the chip
+uint8_t W5x00Chip::access(uint8_t out)
+{
+  if (rxPending && (rxAfter-- == 0))
+  {
+    rxPending = false;
+    receive(rxSocket, rxLen);
+  }
+
+  uint16_t index = addr;
+
+  // W5500 socket buffers wrap at the Sn_TXBUF_SIZE / Sn_RXBUF_SIZE of the socket
+  if ((chip == 55) && (block < BLOCKS) && ((block & 0x03) >= 2))
+  {
+    uint8_t kb = mem[(block & ~0x03) + 1][((block & 0x03) == 2) ? 0x001F : 0x001E];
+
+    index &= (kb << 10) - 1;
+  }
+
+  uint8_t *p = &mem[block][index];
+  bool common = (block == BLOCK_COMMON);
+  uint16_t versionr = (chip == 52) ? 0x001F : 0x0039;
+
+  addr++;
+
+  if (!writing)
+    return *p;
+
+  uint8_t  s;
+  uint16_t offset;
+
+  if (common && (p == &mem[BLOCK_COMMON][0x0000]) && (out & 0x80))
+    *p = 0;                 // soft reset, done at once
+  else if (!(common && (chip != 51) && (p == &mem[BLOCK_COMMON][versionr])))
+    *p = out;
+
+  if (socketRegister(p, &s, &offset) && (offset == 0x0001))
+    command(s, out);
+
+  return 0;
+}
+
+uint8_t W5x00Chip::exchange(uint8_t out)
+{
+  uint8_t in = 0;
+
+  if (!valid)
+    return 0;
+
+  if (chip == 51)
+  {
+    if (pos < 3)
+    {
+      cmd[pos] = out;
+    }
+    else if (pos == 3)
+    {
+      // any other op code is not for a W5100, the chip ignores the frame
+      if ((cmd[0] == 0xF0) || (cmd[0] == 0x0F))
+      {
+        block   = BLOCK_COMMON;
+        addr    = (cmd[1] << 8) | cmd[2];
+        writing = (cmd[0] == 0xF0);
+        in      = access(out);
+      }
+      else
+      {
+        valid = false;
+      }
+    }
+    else
+    {
+      // more than one byte per frame, the W5100 needs SS toggled between frames
+      errors++;
+      valid = false;
+    }
+  }
+  else if (chip == 52)
+  {
+    if (pos < 4)
+    {
+      cmd[pos] = out;
+
+      if (pos == 3)
+      {
+        block     = BLOCK_COMMON;
+        addr      = (cmd[0] << 8) | cmd[1];
+        writing   = cmd[2] & 0x80;
+        remaining = ((cmd[2] & 0x7F) << 8) | cmd[3];
+      }
+    }
+    else if (remaining)
+    {
+      remaining--;
+      in = access(out);
+    }
+    else
+    {
+      errors++;
+      valid = false;
+    }
+  }
+  else
+  {
+    if (pos < 3)
+    {
+      cmd[pos] = out;
+
+      if (pos == 2)
+      {
+        block   = cmd[2] >> 3;
+        addr    = (cmd[0] << 8) | cmd[1];
+        writing = cmd[2] & 0x04;
+
+        // the drivers only use variable length data mode
+        if (cmd[2] & 0x03)
+          errors++;
+      }
+    }
+    else
+    {
+      in = access(out);
+    }
+  }
+
+  if (pos < 0xFF)
+    pos++;
+
+  return in;
+}
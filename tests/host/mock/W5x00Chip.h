@@ -0,0 +1,95 @@
+/****************************************************************************************************************************
+  W5x00Chip.h - emulated WIZnet W5100 / W5200 / W5500 on the mock SPI bus
+
+  Speaks the SPI frame format of the selected chip and keeps its register and buffer memory:
+  - W5100: 4 byte frames, op (0xF0 write / 0x0F read), address, one data byte, SS toggled per frame
+  - W5200: address, R/W bit and data length, then the data
+  - W5500: address, control byte (block select, R/W, variable length mode), then the data
+
+  Enough of MR and VERSIONR is emulated for W5100Class::init() to detect the chip.
+
+  Socket commands written to Sn_CR complete at once. SEND keeps the data in flight, so Sn_TX_FSR
+  doesn't grow back, until the peer acknowledges it (autoAck, or ack()). RECV frees what the host
+  read up to Sn_RX_RD. The socket buffer sizes are Sn_TXBUF_SIZE / Sn_RXBUF_SIZE on W5200 / W5500
+  and TMSR / RMSR on the W5100.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include "SPI.h"
+
+class W5x00Chip : public SPIDevice
+{
+  public:
+    // W5500 block select: common registers, then socket n registers, TX and RX buffer
+    enum
+    {
+      BLOCKS          = 32,
+      BLOCK_COMMON    = 0
+    };
+
+    // 51, 52 or 55
+    uint8_t chip = 0;
+
+    // frames that broke the frame format of the chip
+    unsigned long errors = 0;
+
+    // SEND data counts as acknowledged by the peer right away
+    bool autoAck = true;
+
+    // Sn_CR SEND commands
+    unsigned long sends = 0;
+
+    // W5100 / W5200 use block 0 only, as one flat 64K address space
+    uint8_t mem[BLOCKS][0x10000];
+
+    void reset(uint8_t model);
+
+    // socket register of socket s, offset from the socket register base (Sn_MR = 0x00)
+    uint8_t& sn(uint8_t s, uint16_t offset);
+
+    // data received on socket s: Sn_RX_RSR and Sn_RX_WR grow by len
+    void receive(uint8_t s, uint16_t len);
+
+    // the same, while the host reads: after dataBytes more data bytes went over the bus
+    void receiveAfter(uint8_t s, unsigned long dataBytes, uint16_t len);
+
+    // the peer acknowledged everything sent on socket s, Sn_TX_FSR is back to the buffer size
+    void ack(uint8_t s);
+
+    // socket buffer sizes in bytes
+    uint16_t txSize(uint8_t s);
+    uint16_t rxSize(uint8_t s);
+
+    // 16 bit socket register, high byte first
+    uint16_t sn16(uint8_t s, uint16_t offset);
+    void setSn16(uint8_t s, uint16_t offset, uint16_t value);
+
+    // W5500 socket TX / RX buffer memory
+    uint8_t * txBuffer(uint8_t s) { return mem[(s << 2) + 2]; }
+    uint8_t * rxBuffer(uint8_t s) { return mem[(s << 2) + 3]; }
+
+    void select();
+    void deselect();
+    uint8_t exchange(uint8_t out);
+
+  private:
+    uint8_t  pos;
+    uint8_t  cmd[4];
+    uint8_t  block;
+    uint16_t addr;
+    uint16_t remaining;
+    bool     writing;
+    bool     valid;
+
+    bool          rxPending = false;
+    uint8_t       rxSocket;
+    unsigned long rxAfter;
+    uint16_t      rxLen;
+
+    uint8_t access(uint8_t out);
+    bool socketRegister(const uint8_t *p, uint8_t *s, uint16_t *offset);
+    void command(uint8_t s, uint8_t cmd);
+};
+
+extern W5x00Chip W5x00;
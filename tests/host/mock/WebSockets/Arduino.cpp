@@ -0,0 +1,41 @@
+/****************************************************************************************************************************
+  Arduino.cpp - minimal Arduino core for the host tests of the WebSockets library
+ *****************************************************************************************************************************/
+
+#include "Arduino.h"
+#include "Ethernet.h"
+
+Print Serial;
+EthernetClass Ethernet;
+
+unsigned long hostMillis = 0;
+
+unsigned long millis()
+{
+  return hostMillis;
+}
+
+unsigned long micros()
+{
+  return hostMillis * 1000;
+}
+
+void delay(unsigned long ms)
+{
+  hostMillis += ms;
+}
+
+long random(long howbig)
+{
+  return howbig ? (rand() % howbig) : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+  return (howbig > howsmall) ? (howsmall + rand() % (howbig - howsmall)) : howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  srand(seed);
+}
@@ -0,0 +1,202 @@
+/****************************************************************************************************************************
+  Arduino.h - minimal Arduino core for the host tests of the WebSockets library
+
+  What src/ uses with the W5x00 network: String, Print / Stream / Client and the time functions.
+  millis() only moves when a test sets hostMillis.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <string>
+#include <algorithm>
+
+#define ARDUINO       10813
+
+#define DEC           10
+#define HEX           16
+
+#define bit(b)        (1UL << (b))
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+// flash strings are plain strings on the host
+class __FlashStringHelper;
+#define F(s)          (s)
+
+extern unsigned long hostMillis;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class String
+{
+  public:
+    String() {}
+    String(const char *str) : s(str ? str : "") {}
+    String(const std::string& str) : s(str) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(unsigned char value) : s(std::to_string(value)) {}
+    explicit String(int value) : s(std::to_string(value)) {}
+    explicit String(unsigned int value) : s(std::to_string(value)) {}
+    explicit String(long value) : s(std::to_string(value)) {}
+    explicit String(unsigned long value) : s(std::to_string(value)) {}
+
+    unsigned int length() const { return s.size(); }
+    const char * c_str() const { return s.c_str(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+    char operator[](unsigned int index) const { return (index < s.size()) ? s[index] : 0; }
+    char& operator[](unsigned int index) { return s[index]; }
+
+    bool operator==(const String& rhs) const { return s == rhs.s; }
+    bool operator==(const char *rhs) const { return s == rhs; }
+    bool operator!=(const String& rhs) const { return s != rhs.s; }
+    bool equals(const String& rhs) const { return s == rhs.s; }
+    bool equalsIgnoreCase(const String& rhs) const { return strcasecmp(s.c_str(), rhs.s.c_str()) == 0; }
+    bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+    int indexOf(const char *str, unsigned int from = 0) const { return position(s.find(str, from)); }
+    int indexOf(const String& str, unsigned int from = 0) const { return position(s.find(str.s, from)); }
+
+    String substring(unsigned int from) const
+    {
+      return (from > s.size()) ? String() : String(s.substr(from));
+    }
+
+    String substring(unsigned int from, unsigned int to) const
+    {
+      if (from > to)
+        std::swap(from, to);
+
+      return (from > s.size()) ? String() : String(s.substr(from, to - from));
+    }
+
+    void trim()
+    {
+      size_t first = s.find_first_not_of(" \t\r\n");
+
+      if (first == std::string::npos)
+      {
+        s.clear();
+        return;
+      }
+
+      s = s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+    }
+
+    void toLowerCase()
+    {
+      for (size_t i = 0; i < s.size(); i++)
+        s[i] = tolower(s[i]);
+    }
+
+    long toInt() const { return atol(s.c_str()); }
+    void toCharArray(char *buf, unsigned int size) const { strncpy(buf, s.c_str(), size); }
+
+    void remove(unsigned int index) { s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { s.erase(index, count); }
+
+    bool concat(const String& str) { s += str.s; return true; }
+    bool concat(const char *str, unsigned int length) { s.append(str, length); return true; }
+    bool concat(char c) { s += c; return true; }
+
+    String& operator+=(const String& rhs) { s += rhs.s; return *this; }
+    String& operator+=(const char *rhs) { s += rhs; return *this; }
+    String& operator+=(char rhs) { s += rhs; return *this; }
+    String& operator+=(int rhs) { s += std::to_string(rhs); return *this; }
+    String& operator+=(unsigned int rhs) { s += std::to_string(rhs); return *this; }
+    String& operator+=(unsigned long rhs) { s += std::to_string(rhs); return *this; }
+
+    friend String operator+(const String& lhs, const String& rhs) { return String(lhs.s + rhs.s); }
+    friend String operator+(const String& lhs, const char *rhs) { return String(lhs.s + rhs); }
+    friend String operator+(const String& lhs, char rhs) { return String(lhs.s + rhs); }
+    friend String operator+(const String& lhs, int rhs) { return String(lhs.s + std::to_string(rhs)); }
+    friend String operator+(const String& lhs, unsigned int rhs) { return String(lhs.s + std::to_string(rhs)); }
+    friend String operator+(const String& lhs, uint16_t rhs) { return String(lhs.s + std::to_string(rhs)); }
+
+  private:
+    std::string s;
+
+    static int position(size_t pos) { return (pos == std::string::npos) ? -1 : (int) pos; }
+};
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t) { return 0; }
+
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+      size_t n = 0;
+
+      while (size--)
+        n += write(*buffer++);
+
+      return n;
+    }
+
+    size_t write(const char *str) { return write((const uint8_t *) str, strlen(str)); }
+
+    // the library prints debug output only, which the tests drop
+    size_t print(const char *str) { return write(str); }
+    size_t print(const String& str) { return write(str.c_str()); }
+    template<class T> size_t print(T) { return 0; }
+    template<class T> size_t print(T, int) { return 0; }
+    template<class T> size_t println(T) { return 0; }
+    size_t println() { return 0; }
+    void flush() {}
+};
+
+extern Print Serial;
+
+#include "IPAddress.h"
+
+class Stream : public Print
+{
+  public:
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    String readStringUntil(char) { return String(); }
+    size_t readBytes(char *, size_t length) { return length; }
+    size_t readBytes(uint8_t *, size_t length) { return length; }
+
+  protected:
+    unsigned long _timeout = 1000;
+};
+
+class Client : public Stream
+{
+  public:
+    virtual ~Client() {}
+
+    virtual int connect(IPAddress, uint16_t) { return 0; }
+    virtual int connect(const char *, uint16_t) { return 0; }
+    virtual size_t write(const uint8_t *, size_t size) { return size; }
+    size_t write(const char *str) { return write((const uint8_t *) str, strlen(str)); }
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int read(uint8_t *, size_t) { return 0; }
+    virtual uint8_t connected() { return 0; }
+    virtual void stop() {}
+    virtual void flush() {}
+    virtual operator bool() { return true; }
+
+    IPAddress remoteIP() { return IPAddress(); }
+};
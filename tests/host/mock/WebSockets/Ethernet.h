@@ -0,0 +1,48 @@
+/****************************************************************************************************************************
+  Ethernet.h - Ethernet library stand-in for the host tests of the WebSockets library
+
+  EthernetClient is the base of the in-memory transports of the tests, the server never accepts.
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include "Arduino.h"
+
+#define MAX_SOCK_NUM    8
+
+class EthernetClient : public Client
+{
+  public:
+    EthernetClient() {}
+    EthernetClient(uint8_t s) : sockindex(s) {}
+
+    uint8_t getSocketNumber() const { return sockindex; }
+
+  protected:
+    uint8_t sockindex = 0;
+};
+
+class EthernetServer
+{
+  public:
+    EthernetServer(uint16_t) {}
+
+    void begin() {}
+    EthernetClient available() { return EthernetClient(); }
+    EthernetClient accept() { return EthernetClient(); }
+};
+
+class EthernetClass
+{
+  public:
+    IPAddress dnsServerIP() { return IPAddress(); }
+};
+
+extern EthernetClass Ethernet;
+
+class DNSClient
+{
+  public:
+    void begin(const IPAddress&) {}
+    int getHostByName(const char *, IPAddress&) { return 0; }
+};
@@ -0,0 +1,39 @@
+/****************************************************************************************************************************
+  IPAddress.h - minimal Arduino IPAddress for the host tests of the WebSockets library
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#include "Arduino.h"
+
+class IPAddress
+{
+  public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+      bytes[0] = a;
+      bytes[1] = b;
+      bytes[2] = c;
+      bytes[3] = d;
+    }
+    IPAddress(uint32_t address) { memcpy(bytes, &address, 4); }
+
+    operator uint32_t() const
+    {
+      uint32_t address;
+
+      memcpy(&address, bytes, 4);
+      return address;
+    }
+
+    uint8_t operator[](int index) const { return bytes[index]; }
+    uint8_t& operator[](int index) { return bytes[index]; }
+
+    // host names only, the tests don't connect
+    bool fromString(const char *) { return false; }
+    String toString() const { return String(); }
+
+  private:
+    uint8_t bytes[4] = { 0, 0, 0, 0 };
+};
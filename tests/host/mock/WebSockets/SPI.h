@@ -0,0 +1,5 @@
+/****************************************************************************************************************************
+  SPI.h - the W5x00 network of the WebSockets library includes it, the tests don't use a bus
+ *****************************************************************************************************************************/
+
+#pragma once
@@ -0,0 +1,172 @@
+/****************************************************************************************************************************
+  w5x00_frame_test.cpp - SPI transactions per WebSocket frame sent through the patched EthernetLarge driver,
+  against an emulated chip
+
+  Built against LibraryPatches/EthernetLarge with socket.cpp, see Makefile.
+
+  Without WEBSOCKETS_USE_BIG_MEM, WebSockets::sendFrame() writes the frame header and the payload
+  with two client writes. Each is EthernetClient::connected(), Sn_SR, then socketSend(): Sn_TX_FSR
+  until two reads agree, Sn_SR, Sn_TX_WR, the data, Sn_TX_WR, SEND and Sn_IR. Only the data write
+  grows with the payload:
+  - W5200 / W5500: one more SPI.transfer() per W5100_SPI_CHUNK_SIZE bytes, the chip select frames
+    per WebSocket frame don't change with the payload.
+  - W5100: one buffered 4 byte frame per byte, where byte at a time took 4 transfers.
+ *****************************************************************************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// to re-run init() for each chip
+#define private public
+
+#include <EthernetLarge.h>
+#include "utility/w5100.h"
+
+#undef private
+
+#include "W5x00Chip.h"
+#include "HostTest.h"
+
+#define CHUNK_SIZE    32      // W5100_SPI_CHUNK_SIZE
+
+typedef struct
+{
+  unsigned long transfers;
+  unsigned long frames;
+  unsigned long bytes;
+} SpiCount;
+
+static const uint16_t payloads[] = { 6, 125, 126, 1000 };
+
+static bool initChip(uint8_t model)
+{
+  W5x00.reset(model);
+  W5100.initialized = false;
+
+  if (!W5100.init() || (W5100.getChip() != model))
+    return false;
+
+  W5x00.sn(0, 0x0003) = SnSR::ESTABLISHED;
+  W5x00.ack(0);
+
+  return true;
+}
+
+// EthernetClient::write(), as WebSockets::write() calls it after checking connected()
+static void clientWrite(const uint8_t *buf, uint16_t len)
+{
+  CHECK_EQ(Ethernet.socketStatus(0), SnSR::ESTABLISHED);
+  CHECK_EQ(Ethernet.socketSend(0, buf, len), len);
+}
+
+// an unmasked server frame, header and payload written separately as sendFrame() does
+static SpiCount sendFrame(const uint8_t *payload, uint16_t len)
+{
+  uint8_t header[4];
+  uint8_t headerSize = 2;
+  SpiCount count;
+
+  header[0] = 0x82;
+
+  if (len < 126)
+  {
+    header[1] = len;
+  }
+  else
+  {
+    header[1]  = 126;
+    header[2]  = len >> 8;
+    header[3]  = len & 0xFF;
+    headerSize = 4;
+  }
+
+  SPI.resetCounters();
+
+  clientWrite(header, headerSize);
+  clientWrite(payload, len);
+
+  count.transfers = SPI.transfers;
+  count.frames    = SPI.frames;
+  count.bytes     = SPI.bytes;
+
+  return count;
+}
+
+// chip memory of socket 0's TX buffer
+static const uint8_t * txMemory()
+{
+  if (W5x00.chip == 55)
+    return W5x00.txBuffer(0);
+
+  return &W5x00.mem[0][W5100.SBASE(0)];
+}
+
+static unsigned long dataTransfers(uint8_t model, uint16_t len)
+{
+  // W5500 writes of up to 5 bytes go out with the command
+  if ((model == 55) && (len <= 5))
+    return 0;
+
+  if (model == 51)
+    return len;
+
+  return (len + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+static void testChip(uint8_t model)
+{
+  static uint8_t payload[1000];
+  SpiCount count[sizeof(payloads) / sizeof(payloads[0])];
+
+  printf("W%u00 SPI per WebSocket frame: payload  transfers  CS frames  bytes\n", model);
+
+  CHECK(initChip(model));
+
+  for (uint16_t i = 0; i < sizeof(payload); i++)
+    payload[i] = (uint8_t) (i * 13 + 5);
+
+  for (uint8_t n = 0; n < sizeof(payloads) / sizeof(payloads[0]); n++)
+  {
+    uint16_t len = payloads[n];
+    uint16_t wr  = W5x00.sn16(0, 0x0024);
+    uint8_t  headerSize = (len < 126) ? 2 : 4;
+
+    count[n] = sendFrame(payload, len);
+
+    printf("%38u  %9lu  %9lu  %5lu\n", len, count[n].transfers, count[n].frames, count[n].bytes);
+
+    // header and payload back to back in the TX buffer
+    CHECK_EQ(W5x00.sn16(0, 0x0024), (uint16_t) (wr + headerSize + len));
+    CHECK(memcmp(txMemory() + ((wr + headerSize) & W5100.SMASK_S(0)), payload, len) == 0);
+
+    if (n == 0)
+      continue;
+
+    // only the payload data write grows, a 2 byte header goes out with its command
+    // on every chip, a 4 byte one too on the W5500
+    unsigned long grow = dataTransfers(model, len) - dataTransfers(model, payloads[0]);
+
+    if ((model != 55) && (headerSize == 4))
+      grow += dataTransfers(model, 4) - dataTransfers(model, 2);
+
+    CHECK_EQ(count[n].transfers - count[0].transfers, grow);
+
+    if (model == 51)
+      CHECK_EQ(count[n].frames - count[0].frames, (len - payloads[0]) + (headerSize - 2));
+    else
+      CHECK_EQ(count[n].frames, count[0].frames);
+  }
+
+  CHECK_EQ(W5x00.sends, 2 * sizeof(payloads) / sizeof(payloads[0]));
+  CHECK_EQ(SPI.unselectedBytes, 0);
+  CHECK_EQ(W5x00.errors, 0);
+}
+
+int main()
+{
+  testChip(51);
+  testChip(52);
+  testChip(55);
+
+  return HOST_TEST_RESULT("w5x00_frame_test");
+}
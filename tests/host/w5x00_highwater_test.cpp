@@ -0,0 +1,225 @@
+/****************************************************************************************************************************
+  w5x00_highwater_test.cpp - socket buffer high water marks of the patched EthernetLarge driver, sending and
+  receiving through socket.cpp on an emulated W5500
+
+  Built against LibraryPatches/EthernetLarge with MAX_SOCK_NUM 2, see Makefile.
+
+  With the sizes {8, 2} KB:
+  - socketTxHighWater() is the most data in flight, not yet acknowledged by the peer, that
+    socketSend() / socketSendAvailable() saw. socketRxHighWater() the most received data waiting
+    that socketRecv() / socketRecvAvailable() saw. resetSocketHighWater() clears both.
+  - socketSend() takes up to the socket buffer size per call, so an 8 KB socket sends a 16 KB
+    message with a quarter of the SEND commands of a 2 KB one.
+ *****************************************************************************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// to re-run init() and reach the socket functions EthernetClient calls
+#define private public
+
+#include <EthernetLarge.h>
+#include "utility/w5100.h"
+
+#undef private
+
+#include "W5x00Chip.h"
+#include "HostTest.h"
+
+#if (MAX_SOCK_NUM != 2)
+  #error "w5x00_highwater_test needs MAX_SOCK_NUM 2"
+#endif
+
+#define MESSAGE_LEN     16384
+
+static const uint8_t sizesKB[MAX_SOCK_NUM] = { 8, 2 };
+
+static uint8_t data[MESSAGE_LEN];
+
+static bool initChip()
+{
+  W5x00.reset(55);
+  W5100.initialized = false;
+
+  if (!Ethernet.setSocketBufferSizes(sizesKB) || !W5100.init() || (W5100.getChip() != 55))
+    return false;
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    W5x00.sn(s, 0x0003) = SnSR::ESTABLISHED;
+    W5x00.ack(s);
+  }
+
+  return true;
+}
+
+// what WebSockets::write() does with a message larger than one socketSend() takes
+static unsigned long sendMessage(uint8_t s, const uint8_t *buf, uint16_t len)
+{
+  unsigned long sends = W5x00.sends;
+
+  while (len > 0)
+  {
+    uint16_t n = Ethernet.socketSend(s, buf, len);
+
+    CHECK(n > 0);
+    buf += n;
+    len -= n;
+  }
+
+  return W5x00.sends - sends;
+}
+
+// the W5500 TX buffer of socket s holds buf at offset, wrapping around its end
+static bool txBufferHolds(uint8_t s, uint16_t offset, const uint8_t *buf, uint16_t len)
+{
+  uint16_t mask = Ethernet.socketBufferSize(s) - 1;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    if (W5x00.txBuffer(s)[(offset + i) & mask] != buf[i])
+      return false;
+  }
+
+  return true;
+}
+
+static void testTxHighWater()
+{
+  printf("TX high water, %u / %u KB sockets\n", sizesKB[0], sizesKB[1]);
+
+  Ethernet.resetSocketHighWater();
+  W5x00.autoAck = false;
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    uint16_t size = Ethernet.socketBufferSize(s);
+
+    CHECK_EQ(size, sizesKB[s] << 10);
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 0);
+
+    // 1000 bytes in flight, then 2000
+    CHECK_EQ(Ethernet.socketSend(s, data, 1000), 1000);
+    CHECK_EQ(Ethernet.socketSend(s, data, 1000), 1000);
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 1000);
+
+    CHECK_EQ(Ethernet.socketSendAvailable(s), size - 2000);
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 2000);
+
+    // acknowledged, the mark stays
+    W5x00.ack(s);
+    CHECK_EQ(Ethernet.socketSendAvailable(s), size);
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 2000);
+
+    // a full buffer, as much as one socketSend() takes
+    CHECK_EQ(Ethernet.socketSend(s, data, MESSAGE_LEN), size);
+    CHECK_EQ(Ethernet.socketSendAvailable(s), 0);
+    CHECK_EQ(Ethernet.socketTxHighWater(s), size);
+    CHECK(txBufferHolds(s, 2000, data, size));
+
+    W5x00.ack(s);
+  }
+
+  Ethernet.resetSocketHighWater();
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 0);
+
+  W5x00.autoAck = true;
+}
+
+static void testSendsPerMessage()
+{
+  unsigned long sends[MAX_SOCK_NUM];
+
+  printf("SEND commands for a %u byte message\n", MESSAGE_LEN);
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    uint16_t size = Ethernet.socketBufferSize(s);
+
+    sends[s] = sendMessage(s, data, MESSAGE_LEN);
+    printf("  %2u KB socket: %lu\n", size >> 10, sends[s]);
+
+    CHECK_EQ(sends[s], MESSAGE_LEN / size);
+
+    // acknowledged as it goes, the buffer is never more than one send full
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 0);
+  }
+
+  CHECK_EQ(sends[1], 4 * sends[0]);
+}
+
+// data the peer sent on socket s, at Sn_RX_WR of the W5500 RX buffer
+static void peerSend(uint8_t s, const uint8_t *buf, uint16_t len)
+{
+  uint16_t mask = Ethernet.socketBufferSize(s) - 1;
+  uint16_t wr   = W5x00.sn16(s, 0x002A);
+
+  for (uint16_t i = 0; i < len; i++)
+    W5x00.rxBuffer(s)[(wr + i) & mask] = buf[i];
+
+  W5x00.receive(s, len);
+}
+
+static void testRxHighWater()
+{
+  static uint8_t in[MESSAGE_LEN];
+
+  printf("RX high water, %u / %u KB sockets\n", sizesKB[0], sizesKB[1]);
+
+  Ethernet.resetSocketHighWater();
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    uint16_t size = Ethernet.socketBufferSize(s);
+    uint16_t half = size / 2;
+
+    CHECK_EQ(Ethernet.socketRxHighWater(s), 0);
+
+    peerSend(s, data, half);
+    CHECK_EQ(Ethernet.socketRecvAvailable(s), half);
+    CHECK_EQ(Ethernet.socketRxHighWater(s), half);
+
+    // read in two parts, the first frees its data on the chip
+    CHECK_EQ(Ethernet.socketRecv(s, in, 300), 300);
+    CHECK_EQ(W5x00.sn16(s, 0x0026), half - 300);
+    CHECK_EQ(Ethernet.socketRecv(s, in + 300, size), half - 300);
+    CHECK(memcmp(in, data, half) == 0);
+    CHECK_EQ(W5x00.sn16(s, 0x0026), 0);
+
+    // a full buffer, wrapping around the end of it
+    peerSend(s, data + 1, size);
+    CHECK_EQ(Ethernet.socketRecv(s, in, MESSAGE_LEN), size);
+    CHECK(memcmp(in, data + 1, size) == 0);
+    CHECK_EQ(Ethernet.socketRxHighWater(s), size);
+    CHECK_EQ(Ethernet.socketTxHighWater(s), 0);
+  }
+
+  Ethernet.resetSocketHighWater();
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+    CHECK_EQ(Ethernet.socketRxHighWater(s), 0);
+}
+
+int main()
+{
+  for (uint16_t i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t) (i * 7 + (i >> 8));
+
+  CHECK(initChip());
+
+  testTxHighWater();
+  testSendsPerMessage();
+  testRxHighWater();
+
+  // out of range sockets
+  CHECK_EQ(Ethernet.socketBufferSize(MAX_SOCK_NUM), 0);
+  CHECK_EQ(Ethernet.socketTxHighWater(MAX_SOCK_NUM), 0);
+  CHECK_EQ(Ethernet.socketRxHighWater(MAX_SOCK_NUM), 0);
+
+  CHECK_EQ(SPI.unselectedBytes, 0);
+  CHECK_EQ(W5x00.errors, 0);
+
+  return HOST_TEST_RESULT("w5x00_highwater_test");
+}
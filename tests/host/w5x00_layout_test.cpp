@@ -0,0 +1,173 @@
+/****************************************************************************************************************************
+  w5x00_layout_test.cpp - per-socket buffer sizes of the patched EthernetLarge driver, against an emulated chip
+
+  Built against LibraryPatches/EthernetLarge with MAX_SOCK_NUM 4, see Makefile.
+
+  With the sizes {8, 4, 2, 2} KB:
+  - W5500 / W5200: Sn_TXBUF_SIZE / Sn_RXBUF_SIZE, and SBASE() / RBASE() laid out back to back.
+    On the W5500 every byte of each socket's buffers must land in that socket's TX / RX block.
+  - W5100: 8 KB only, so the sizes don't fit and init() keeps the even split. {4, 2, 1, 1} fits,
+    and sets TMSR / RMSR to 2 bits per socket.
+ *****************************************************************************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <EthernetLarge.h>
+
+// to re-run init() for each chip
+#define private public
+#include "utility/w5100.h"
+#undef private
+
+#include "W5x00Chip.h"
+#include "HostTest.h"
+
+#if (MAX_SOCK_NUM != 4)
+  #error "w5x00_layout_test needs MAX_SOCK_NUM 4"
+#endif
+
+static const uint8_t mixedKB[MAX_SOCK_NUM]   = { 8, 4, 2, 2 };
+static const uint8_t w5100KB[MAX_SOCK_NUM]   = { 4, 2, 1, 1 };
+
+static bool initChip(uint8_t model, const uint8_t *sizesKB)
+{
+  W5x00.reset(model);
+  W5100.initialized = false;
+
+  if (!W5100.setSocketBufferSizes(sizesKB))
+    return false;
+
+  return W5100.init() && (W5100.getChip() == model);
+}
+
+static void checkBases(uint16_t txBase, uint16_t rxBase, const uint8_t *sizesKB)
+{
+  uint16_t offset = 0;
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    CHECK_EQ(W5100.SSIZE_S(s), sizesKB[s] << 10);
+    CHECK_EQ(W5100.SMASK_S(s), (sizesKB[s] << 10) - 1);
+    CHECK_EQ(W5100.SBASE(s),   txBase + offset);
+    CHECK_EQ(W5100.RBASE(s),   rxBase + offset);
+
+    offset += sizesKB[s] << 10;
+  }
+}
+
+// fill every socket buffer through write() and check it arrived in that socket's W5500 block
+static void checkW5500Buffers()
+{
+  static uint8_t data[16384];
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    uint16_t size = W5100.SSIZE_S(s);
+
+    memset(data, 0x10 + s, size);
+    data[0]        = 0xA0 + s;
+    data[size - 1] = 0xB0 + s;
+
+    W5100.write(W5100.SBASE(s), data, size);
+    CHECK(memcmp(W5x00.txBuffer(s), data, size) == 0);
+
+    memset(data, 0x20 + s, size);
+    data[0]        = 0xC0 + s;
+    data[size - 1] = 0xD0 + s;
+
+    W5100.write(W5100.RBASE(s), data, size);
+    CHECK(memcmp(W5x00.rxBuffer(s), data, size) == 0);
+  }
+
+  // and reads come from the same place
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    uint16_t size = W5100.SSIZE_S(s);
+    uint8_t first, last;
+
+    W5100.read(W5100.SBASE(s), &first, 1);
+    W5100.read(W5100.SBASE(s) + size - 1, &last, 1);
+    CHECK_EQ(first, 0xA0 + s);
+    CHECK_EQ(last,  0xB0 + s);
+
+    W5100.read(W5100.RBASE(s), &first, 1);
+    W5100.read(W5100.RBASE(s) + size - 1, &last, 1);
+    CHECK_EQ(first, 0xC0 + s);
+    CHECK_EQ(last,  0xD0 + s);
+  }
+}
+
+static void testW5x00Mixed(uint8_t model)
+{
+  printf("W%u00 {8, 4, 2, 2}\n", model);
+
+  CHECK(initChip(model, mixedKB));
+
+  for (uint8_t s = 0; s < 8; s++)
+  {
+    uint8_t kb = (s < MAX_SOCK_NUM) ? mixedKB[s] : 0;
+
+    CHECK_EQ(W5x00.sn(s, 0x001E), kb);    // Sn_RXBUF_SIZE
+    CHECK_EQ(W5x00.sn(s, 0x001F), kb);    // Sn_TXBUF_SIZE
+  }
+
+  checkBases(0x8000, 0xC000, mixedKB);
+
+  if (model == 55)
+    checkW5500Buffers();
+
+  CHECK_EQ(W5x00.errors, 0);
+}
+
+static void testW5100()
+{
+  static const uint8_t evenKB[MAX_SOCK_NUM] = { 2, 2, 2, 2 };
+
+  printf("W5100 {8, 4, 2, 2}\n");
+
+  // 16 KB doesn't fit the 8 KB of the W5100, the even split stays
+  CHECK(initChip(51, mixedKB));
+  CHECK_EQ(W5x00.mem[0][0x001A], 0x55);   // RMSR
+  CHECK_EQ(W5x00.mem[0][0x001B], 0x55);   // TMSR
+  checkBases(0x4000, 0x6000, evenKB);
+
+  printf("W5100 {4, 2, 1, 1}\n");
+
+  // 2 bits per socket, 1 << n KB: 4 KB = 2, 2 KB = 1, 1 KB = 0
+  CHECK(initChip(51, w5100KB));
+  CHECK_EQ(W5x00.mem[0][0x001A], 0x06);
+  CHECK_EQ(W5x00.mem[0][0x001B], 0x06);
+  checkBases(0x4000, 0x6000, w5100KB);
+
+  CHECK_EQ(W5x00.errors, 0);
+}
+
+static void testInvalidSizes()
+{
+  static const uint8_t tooLarge[MAX_SOCK_NUM] = { 8, 8, 2, 2 };
+  static const uint8_t notPow2[MAX_SOCK_NUM]  = { 8, 3, 2, 2 };
+  static const uint8_t zero[MAX_SOCK_NUM]     = { 8, 4, 2, 0 };
+
+  printf("invalid sizes\n");
+
+  CHECK(!W5100.setSocketBufferSizes(tooLarge));
+  CHECK(!W5100.setSocketBufferSizes(notPow2));
+  CHECK(!W5100.setSocketBufferSizes(zero));
+
+  // NULL goes back to the even split, 16 KB / 4 sockets
+  static const uint8_t evenKB[MAX_SOCK_NUM] = { 4, 4, 4, 4 };
+
+  CHECK(initChip(55, NULL));
+  checkBases(0x8000, 0xC000, evenKB);
+  checkW5500Buffers();
+}
+
+int main()
+{
+  testW5x00Mixed(55);
+  testW5x00Mixed(52);
+  testW5100();
+  testInvalidSizes();
+
+  return HOST_TEST_RESULT("w5x00_layout_test EthernetLarge");
+}
@@ -0,0 +1,190 @@
+/****************************************************************************************************************************
+  w5x00_snapshot_test.cpp - Ethernet.socketStatusSnapshot() of the patched W5x00 drivers, against an emulated chip
+
+  Built against LibraryPatches/Ethernet and LibraryPatches/EthernetLarge, see Makefile.
+
+  - SPI transactions (chip select frames) per server loop, with all sockets established and idle.
+    The snapshot takes one per socket on W5200 / W5500, and 4 single byte frames on the W5100.
+    With EthernetLarge the test also counts connected() + available(), which is what each client
+    cost before: Sn_SR, then Sn_RX_RSR read until two reads agree.
+  - Sn_RX_RSR is read once. Data arriving at any byte of the snapshot, from any Sn_RX_RSR before,
+    must never turn into rxSize 0 when Sn_RX_RSR was non-zero when the read started. A non-zero
+    rxSize only sends the client down the connected() / available() path, which reads the register
+    the datasheet way. So a torn read can cost a slow loop, but never hides received data.
+ *****************************************************************************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// to re-run init() for each chip, and reach EthernetClass::socketStatus() / socketRecvAvailable()
+#define private public
+
+#if __has_include(<EthernetLarge.h>)
+  #include <EthernetLarge.h>
+  #define DRIVER_NAME       "EthernetLarge"
+  #define HAVE_SOCKET_CPP   1
+#else
+  #include <Ethernet.h>
+  #define DRIVER_NAME       "Ethernet"
+  #define HAVE_SOCKET_CPP   0
+#endif
+
+#include "utility/w5100.h"
+
+#undef private
+
+#include "W5x00Chip.h"
+#include "HostTest.h"
+
+#define ALL_SOCKETS     ((uint8_t) ((1 << MAX_SOCK_NUM) - 1))
+
+static bool initChip(uint8_t model)
+{
+  W5x00.reset(model);
+  W5100.initialized = false;
+
+  if (!W5100.init() || (W5100.getChip() != model))
+    return false;
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+    W5x00.sn(s, 0x0003) = SnSR::ESTABLISHED;
+
+  return true;
+}
+
+static void setRx(uint8_t s, uint16_t rsr, uint16_t rd)
+{
+  uint16_t wr = rd + rsr;
+
+  W5x00.sn(s, 0x0026) = rsr >> 8;
+  W5x00.sn(s, 0x0027) = rsr & 0xFF;
+  W5x00.sn(s, 0x0028) = rd >> 8;
+  W5x00.sn(s, 0x0029) = rd & 0xFF;
+  W5x00.sn(s, 0x002A) = wr >> 8;
+  W5x00.sn(s, 0x002B) = wr & 0xFF;
+}
+
+static void testLoopCost(uint8_t model)
+{
+  EthernetSocketStatus status[MAX_SOCK_NUM];
+
+  printf("W%u00 loop cost, %u sockets\n", model, MAX_SOCK_NUM);
+
+  CHECK(initChip(model));
+
+  W5x00.sn(1, 0x0002) = SnIR::RECV;
+  W5x00.sn(1, 0x0003) = SnSR::CLOSE_WAIT;
+  W5x00.receive(1, 300);
+
+  SPI.resetCounters();
+  CHECK_EQ(Ethernet.socketStatusSnapshot(status, ALL_SOCKETS), MAX_SOCK_NUM);
+  CHECK_EQ(SPI.frames, MAX_SOCK_NUM * ((model == 51) ? 4 : 1));
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    CHECK_EQ(status[s].ir,     (s == 1) ? SnIR::RECV : 0);
+    CHECK_EQ(status[s].sr,     (s == 1) ? SnSR::CLOSE_WAIT : SnSR::ESTABLISHED);
+    CHECK_EQ(status[s].rxSize, (s == 1) ? 300 : 0);
+  }
+
+  // only the sockets asked for
+  SPI.resetCounters();
+  CHECK_EQ(Ethernet.socketStatusSnapshot(status, 0x01), 1);
+  CHECK_EQ(SPI.frames, (model == 51) ? 4 : 1);
+
+#if HAVE_SOCKET_CPP
+  // before: EthernetClient::connected() reads Sn_SR, available() reads Sn_RX_RSR until two reads agree
+  W5x00.sn(1, 0x0003) = SnSR::ESTABLISHED;
+  setRx(1, 0, 0);
+
+  SPI.resetCounters();
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+  {
+    CHECK_EQ(Ethernet.socketStatus(s), SnSR::ESTABLISHED);
+    CHECK_EQ(Ethernet.socketRecvAvailable(s), 0);
+  }
+
+  CHECK_EQ(SPI.frames, MAX_SOCK_NUM * ((model == 51) ? 5 : 3));
+#endif
+
+  CHECK_EQ(W5x00.errors, 0);
+}
+
+// Sn_RX_RSR before the read, data arriving during it, Sn_RX_RD
+static const uint16_t rsrBefore[]  = { 0, 1, 0x80, 0xFF, 0x100, 0x101, 0x1FF, 0x7FF };
+static const uint16_t arriving[]   = { 1, 0x80, 0x100, 0x101, 0x200, 0x5B4 };
+static const uint16_t rdPointer[]  = { 0x0000, 0x1234, 0xFFF0 };
+
+static void testTornRead(uint8_t model)
+{
+  EthernetSocketStatus status[MAX_SOCK_NUM];
+  // data bytes of one socket's snapshot: Sn_IR, Sn_SR, Sn_RX_RSR / Sn_IR up to Sn_RX_WR
+  unsigned long frameBytes = (model == 51) ? 4 : (0x2C - 0x02);
+  unsigned long reads = 0, torn = 0, naiveZeros = 0;
+
+  printf("W%u00 Sn_RX_RSR read once\n", model);
+
+  CHECK(initChip(model));
+
+  for (uint16_t before : rsrBefore)
+  {
+    // Sn_RX_RSR can't grow past the buffer
+    for (uint16_t len : arriving)
+    {
+      // and to a multiple of 256
+      uint16_t lens[2] = { len, (uint16_t) (len + 0x100 - (before & 0xFF)) };
+
+      for (uint16_t n : lens)
+      {
+        for (uint16_t rd : rdPointer)
+        {
+          for (unsigned long at = 0; at <= frameBytes; at++)
+          {
+            setRx(0, before, rd);
+            W5x00.receiveAfter(0, at, n);
+
+            CHECK_EQ(Ethernet.socketStatusSnapshot(status, 0x01), 1);
+            reads++;
+
+            // never 0 with data received before the read
+            if (before)
+              CHECK(status[0].rxSize != 0);
+
+            if (status[0].rxSize && (status[0].rxSize != before) && (status[0].rxSize != before + n))
+              torn++;
+          }
+
+          // a plain single read of Sn_RX_RSR, high byte first, can come out 0
+          for (unsigned long at = 0; at <= 2; at++)
+          {
+            setRx(0, before, rd);
+            W5x00.receiveAfter(0, at, n);
+
+            if (before && (W5100.readSnRX_RSR(0) == 0))
+              naiveZeros++;
+          }
+        }
+      }
+    }
+  }
+
+  printf("  %lu snapshots, %lu torn non-zero rxSize, %lu times 0 from a plain read\n", reads, torn, naiveZeros);
+
+  // the sweep does hit the torn reads it is meant to cover
+  CHECK(naiveZeros > 0);
+  CHECK_EQ(W5x00.errors, 0);
+}
+
+int main()
+{
+  testLoopCost(51);
+  testLoopCost(52);
+  testLoopCost(55);
+
+  testTornRead(51);
+  testTornRead(52);
+  testTornRead(55);
+
+  return HOST_TEST_RESULT("w5x00_snapshot_test " DRIVER_NAME);
+}
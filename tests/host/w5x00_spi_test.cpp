@@ -0,0 +1,150 @@
+/****************************************************************************************************************************
+  w5x00_spi_test.cpp - SPI transactions of the patched W5x00 drivers, against an emulated chip
+
+  Built once against LibraryPatches/Ethernet and once against LibraryPatches/EthernetLarge, see Makefile.
+
+  A 512 byte buffer write and read must round trip through the chip memory with:
+  - W5100: one buffered 4 byte transfer per frame, 512 transfers for the write. Byte at a time
+    this took 2048. Reads stay byte at a time unless W5100_SPI_BUFFERED_READ, which is not
+    verified on a real W5100.
+  - W5200 / W5500: the command, then the data in W5100_SPI_CHUNK_SIZE chunks (one transfer with
+    SPI_HAS_TRANSFER_BUF). Byte at a time the write took 513 transfers.
+ *****************************************************************************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#if __has_include(<EthernetLarge.h>)
+  #include <EthernetLarge.h>
+  #define DRIVER_NAME     "EthernetLarge"
+#else
+  #include <Ethernet.h>
+  #define DRIVER_NAME     "Ethernet"
+#endif
+
+// to re-run init() for each chip
+#define private public
+#include "utility/w5100.h"
+#undef private
+
+#include "W5x00Chip.h"
+#include "HostTest.h"
+
+#define TEST_LEN      512
+#define CHUNK_SIZE    32      // W5100_SPI_CHUNK_SIZE
+
+#if W5100_SPI_BUFFERED_READ
+  #define W5100_READ_TRANSFERS    1
+#else
+  #define W5100_READ_TRANSFERS    4
+#endif
+
+static bool initChip(uint8_t model)
+{
+  W5x00.reset(model);
+  W5100.initialized = false;
+
+  return W5100.init() && (W5100.getChip() == model);
+}
+
+// chip memory behind SBASE(0)
+static uint8_t * txMemory()
+{
+  if (W5x00.chip == 55)
+    return W5x00.txBuffer(0);
+
+  return &W5x00.mem[0][W5100.SBASE(0)];
+}
+
+static unsigned long blockTransfers(uint16_t len)
+{
+#if defined(SPI_HAS_TRANSFER_BUF)
+  (void) len;
+
+  return 1;
+#else
+  return (len + CHUNK_SIZE - 1) / CHUNK_SIZE;
+#endif
+}
+
+static void testChip(uint8_t model)
+{
+  static uint8_t data[TEST_LEN];
+  static uint8_t back[TEST_LEN];
+  unsigned long cmdLen = (model == 52) ? 4 : 3;
+
+  printf("W%u00\n", model);
+
+  CHECK(initChip(model));
+
+  for (uint16_t i = 0; i < TEST_LEN; i++)
+    data[i] = (uint8_t) (i * 7 + 1);
+
+  // write
+  SPI.resetCounters();
+  W5100.write(W5100.SBASE(0), data, TEST_LEN);
+
+  CHECK(memcmp(txMemory(), data, TEST_LEN) == 0);
+
+  if (model == 51)
+  {
+    CHECK_EQ(SPI.transfers, TEST_LEN);
+    CHECK_EQ(SPI.frames,    TEST_LEN);
+    CHECK_EQ(SPI.bytes,     4 * TEST_LEN);
+  }
+  else
+  {
+    CHECK_EQ(SPI.transfers, 1 + blockTransfers(TEST_LEN));
+    CHECK_EQ(SPI.frames,    1);
+    CHECK_EQ(SPI.bytes,     cmdLen + TEST_LEN);
+  }
+
+  // read back
+  memset(back, 0, sizeof(back));
+  SPI.resetCounters();
+  W5100.read(W5100.SBASE(0), back, TEST_LEN);
+
+  CHECK(memcmp(back, data, TEST_LEN) == 0);
+
+  if (model == 51)
+  {
+    CHECK_EQ(SPI.transfers, W5100_READ_TRANSFERS * TEST_LEN);
+    CHECK_EQ(SPI.frames,    TEST_LEN);
+    CHECK_EQ(SPI.bytes,     4 * TEST_LEN);
+  }
+  else
+  {
+    CHECK_EQ(SPI.transfers, 2);
+    CHECK_EQ(SPI.frames,    1);
+    CHECK_EQ(SPI.bytes,     cmdLen + TEST_LEN);
+  }
+
+  // W5500 register writes up to 5 bytes go out with the command in one transfer
+  if (model == 55)
+  {
+    const uint8_t mac[6] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED };
+    uint8_t ip[4] = { 192, 168, 2, 100 };
+
+    SPI.resetCounters();
+    W5100.setIPAddress(ip);
+    CHECK_EQ(SPI.transfers, 1);
+    CHECK(memcmp(&W5x00.mem[W5x00Chip::BLOCK_COMMON][0x000F], ip, 4) == 0);
+
+    SPI.resetCounters();
+    W5100.setMACAddress(mac);
+    CHECK_EQ(SPI.transfers, 1 + blockTransfers(6));
+    CHECK(memcmp(&W5x00.mem[W5x00Chip::BLOCK_COMMON][0x0009], mac, 6) == 0);
+  }
+
+  CHECK_EQ(SPI.unselectedBytes, 0);
+  CHECK_EQ(W5x00.errors, 0);
+}
+
+int main()
+{
+  testChip(51);
+  testChip(52);
+  testChip(55);
+
+  return HOST_TEST_RESULT("w5x00_spi_test " DRIVER_NAME);
+}
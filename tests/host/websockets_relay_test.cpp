@@ -0,0 +1,444 @@
+/****************************************************************************************************************************
+  websockets_relay_test.cpp - WebSocketsRelay of the WebSockets library over in-memory transports
+
+  Built against src/ with the W5x00 network and mock/WebSockets, see Makefile.
+
+  A peer sends masked frames to the source connection of a server, the targets are other connections
+  of that server and the client end of a connection (masked). Checked:
+  - fragmented messages keep their fragments, control frames stay with the source
+  - a target busy with another source's message misses the message, sendTXT() to a target in the
+    middle of a relayed message returns false
+  - a target added for one client leaves its relay when it disconnects, the next client of its slot
+    gets nothing, one added for all clients stays. removeRelayTarget() ends the message it is in
+  - compressed messages of the source reach the event handler, plain ones are relayed
+  - a relay destroyed while it is a source, and a server or client destroyed while it is a source or
+    a target, leave nothing behind (ASan)
+ *****************************************************************************************************************************/
+
+#include <WebSocketsServer_Generic.h>
+#include <WebSocketsClient_Generic.h>
+
+#include <vector>
+
+#include "HostTest.h"
+
+// TCP connection, bytes written go to out, the ones in in are read
+class Loopback : public EthernetClient
+{
+  public:
+    Loopback(std::string *in, std::string *out) : in(in), out(out) {}
+
+    int available() override { return in->size(); }
+    uint8_t connected() override { return 1; }
+
+    int read() override
+    {
+      if (in->empty())
+        return -1;
+
+      int c = (uint8_t) (*in)[0];
+
+      in->erase(0, 1);
+      return c;
+    }
+
+    int read(uint8_t *buf, size_t size) override
+    {
+      size = std::min(size, in->size());
+      memcpy(buf, in->data(), size);
+      in->erase(0, size);
+
+      return size;
+    }
+
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+      out->append((const char *) buf, size);
+      return size;
+    }
+
+  private:
+    std::string *in;
+    std::string *out;
+};
+
+class TestServer : public WebSocketsServerCore
+{
+  public:
+    // text and binary messages that reached the event handler
+    std::vector<std::string> messages;
+
+    using WebSocketsServerCore::_clients;
+
+    TestServer()
+    {
+      onEvent([this](uint8_t, WStype_t type, uint8_t *payload, size_t length)
+      {
+        if ((type == WStype_TEXT) || (type == WStype_BIN))
+          messages.push_back(std::string((char *) payload, length));
+      });
+
+      begin();
+    }
+
+    // client num connected over in / out, isClient for the client end of a connection
+    WSclient_t * connect(uint8_t num, std::string *in, std::string *out, bool isClient = false)
+    {
+      WSclient_t *client = &_clients[num];
+
+      client->tcp       = new Loopback(in, out);
+      client->status    = WSC_CONNECTED;
+      client->cIsClient = isClient;
+
+      return client;
+    }
+
+    bool send(WSclient_t *client, WSopcode_t opcode, const std::string& data, bool fin = true)
+    {
+      return sendFrame(client, opcode, (uint8_t *) data.data(), data.size(), fin);
+    }
+
+    void pump(WSclient_t *client)
+    {
+      while ((client->status == WSC_CONNECTED) && client->tcp && rxAvailable(client))
+        handleWebsocket(client);
+    }
+
+    // permessage-deflate between client and the client end peer of another server
+    bool negotiate(WSclient_t *client, TestServer& peerServer, WSclient_t *peer)
+    {
+      String response;
+
+      client->cExtensions = peerServer.extensionOffer();
+
+      if (!extensionAccept(client, response))
+        return false;
+
+      peer->cExtensions = response;
+
+      return peerServer.extensionConfirm(peer);
+    }
+};
+
+typedef struct
+{
+  uint8_t     opcode;
+  bool        fin;
+  bool        rsv1;
+  bool        masked;
+  std::string data;
+} Frame;
+
+// the frames written to wire, taken off it
+static std::vector<Frame> takeFrames(std::string& wire)
+{
+  std::vector<Frame> frames;
+  size_t pos = 0;
+
+  while (pos + 2 <= wire.size())
+  {
+    Frame frame;
+    uint8_t key[4] = { 0, 0, 0, 0 };
+    size_t headerSize = 2;
+    size_t length = wire[pos + 1] & 0x7F;
+
+    frame.opcode = wire[pos] & 0x0F;
+    frame.fin    = wire[pos] & 0x80;
+    frame.rsv1   = wire[pos] & 0x40;
+    frame.masked = wire[pos + 1] & 0x80;
+
+    if (length == 126)
+    {
+      length     = ((uint8_t) wire[pos + 2] << 8) | (uint8_t) wire[pos + 3];
+      headerSize = 4;
+    }
+
+    if (frame.masked)
+    {
+      memcpy(key, &wire[pos + headerSize], 4);
+      headerSize += 4;
+    }
+
+    CHECK(pos + headerSize + length <= wire.size());
+
+    frame.data = wire.substr(pos + headerSize, length);
+
+    for (size_t i = 0; i < length; i++)
+      frame.data[i] ^= key[i % 4];
+
+    frames.push_back(frame);
+    pos += headerSize + length;
+  }
+
+  wire.erase(0, pos);
+
+  return frames;
+}
+
+// wires of the connections, up / down between the peer and the source
+static std::string up, down, in1, out1, in2, out2, in3, out3;
+
+static TestServer server, clientEnd, peerServer;
+static WSclient_t *source, *target1, *target2, *target3, *peer;
+
+static void connectAll()
+{
+  peer    = peerServer.connect(0, &down, &up, true);
+  source  = server.connect(0, &up, &down);
+  target1 = server.connect(1, &in1, &out1);
+  target2 = clientEnd.connect(0, &in2, &out2, true);
+  target3 = server.connect(2, &in3, &out3);
+}
+
+static void testFragmented()
+{
+  WebSocketsRelay relay;
+
+  printf("fragmented relay\n");
+
+  server.setRelay(0, &relay);
+  CHECK(server.addRelayTarget(relay, 1));
+  CHECK(clientEnd.addRelayTarget(relay, 0));
+  CHECK_EQ(relay.targets(), 2);
+
+  CHECK(peerServer.send(peer, WSop_binary, "abc", false));
+  CHECK(peerServer.send(peer, WSop_ping, "p"));
+  CHECK(peerServer.send(peer, WSop_continuation, "defgh", false));
+  CHECK(peerServer.send(peer, WSop_continuation, "ij"));
+  server.pump(source);
+
+  std::vector<Frame> f1 = takeFrames(out1), f2 = takeFrames(out2), back = takeFrames(down);
+
+  CHECK_EQ(f1.size(), 3);
+  CHECK(f1[0].opcode == WSop_binary && !f1[0].fin && !f1[0].masked && (f1[0].data == "abc"));
+  CHECK(f1[1].opcode == WSop_continuation && !f1[1].fin && (f1[1].data == "defgh"));
+  CHECK(f1[2].opcode == WSop_continuation && f1[2].fin && (f1[2].data == "ij"));
+
+  // the client end masks
+  CHECK_EQ(f2.size(), 3);
+  CHECK(f2[0].masked && (f2[0].data == "abc") && (f2[1].data == "defgh") && (f2[2].data == "ij"));
+
+  // the ping is answered by the source, nothing reaches the event handler
+  CHECK_EQ(back.size(), 1);
+  CHECK(back[0].opcode == WSop_pong && (back[0].data == "p"));
+  CHECK(server.messages.empty());
+  CHECK(!source->cRelaying && !target1->cRelayOwner && !target2->cRelayOwner);
+
+  server.setRelay(0, NULL);
+}
+
+static void testBusyTarget()
+{
+  WebSocketsRelay relay, other;
+  TestServer otherPeer;
+
+  printf("busy target\n");
+
+  server.setRelay(0, &relay);
+  server.setRelay(2, &other);
+  CHECK(server.addRelayTarget(relay, 1));
+  CHECK(clientEnd.addRelayTarget(relay, 0));
+  CHECK(server.addRelayTarget(other, 1));
+
+  // a fragmented message of client 2 holds target 1
+  WSclient_t *peer3 = otherPeer.connect(0, &out3, &in3, true);
+
+  CHECK(otherPeer.send(peer3, WSop_text, "other-", false));
+  server.pump(target3);
+  CHECK(target1->cRelayOwner == target3);
+  takeFrames(out1);
+
+  CHECK(peerServer.send(peer, WSop_text, "missed"));
+  server.pump(source);
+  CHECK(takeFrames(out1).empty());
+  CHECK_EQ(takeFrames(out2).size(), 1);
+
+  // nothing goes in between the fragments
+  CHECK(!server.sendTXT(1, "interactive"));
+
+  CHECK(otherPeer.send(peer3, WSop_continuation, "end"));
+  server.pump(target3);
+  CHECK(!target1->cRelayOwner);
+  CHECK(server.sendTXT(1, "interactive"));
+  CHECK_EQ(takeFrames(out1).size(), 2);
+
+  server.setRelay(NULL);
+  server.removeRelayTarget(relay);
+  server.removeRelayTarget(other);
+  clientEnd.removeRelayTarget(relay);
+  CHECK_EQ(relay.targets(), 0);
+  CHECK_EQ(other.targets(), 0);
+
+  otherPeer.onEvent(nullptr);
+}
+
+static void testSlotReuse()
+{
+  WebSocketsRelay relay;
+
+  printf("target disconnects, its slot is reused\n");
+
+  server.setRelay(0, &relay);
+  CHECK(server.addRelayTarget(relay, 1));
+
+  // the target leaves in the middle of a message
+  CHECK(peerServer.send(peer, WSop_text, "part-", false));
+  server.pump(source);
+  CHECK(target1->cRelayOwner == source);
+
+  server.disconnect(1);
+  CHECK_EQ(relay.targets(), 0);
+  CHECK(!target1->cRelayOwner);
+
+  // the next client of the slot gets neither the rest of it nor the next ones
+  in1.clear();
+  out1.clear();
+  target1 = server.connect(1, &in1, &out1);
+
+  CHECK(peerServer.send(peer, WSop_continuation, "end"));
+  CHECK(peerServer.send(peer, WSop_text, "next"));
+  server.pump(source);
+  CHECK(out1.empty());
+
+  // added for all clients, the slots stay targets
+  CHECK(server.addRelayTarget(relay));
+  server.disconnect(1);
+  CHECK_EQ(relay.targets(), WEBSOCKETS_SERVER_CLIENT_MAX);
+
+  out1.clear();
+  target1 = server.connect(1, &in1, &out1);
+
+  CHECK(peerServer.send(peer, WSop_text, "all"));
+  server.pump(source);
+
+  std::vector<Frame> f1 = takeFrames(out1);
+
+  CHECK(f1.size() == 1 && (f1[0].data == "all"));
+  takeFrames(out3);
+
+  // removed in the middle of a message, it gets the end of it
+  CHECK(peerServer.send(peer, WSop_binary, "cut-", false));
+  server.pump(source);
+  CHECK(server.removeRelayTarget(relay, 1));
+  CHECK(!server.removeRelayTarget(relay, 1));
+  CHECK(!target1->cRelayOwner);
+
+  CHECK(peerServer.send(peer, WSop_continuation, "rest"));
+  server.pump(source);
+
+  f1 = takeFrames(out1);
+  CHECK_EQ(f1.size(), 2);
+  CHECK(f1[1].opcode == WSop_continuation && f1[1].fin && f1[1].data.empty());
+  CHECK_EQ(takeFrames(out3).size(), 2);
+
+  server.setRelay(0, NULL);
+}
+
+static void testCompressedSource()
+{
+  WebSocketsRelay relay;
+  std::string message;
+
+  printf("compressed source\n");
+
+  for (int i = 0; i < 12; i++)
+    message += "{\"id\":" + std::to_string(i) + ",\"temp\":21.5,\"name\":\"sensor\"},";
+
+  server.enableCompression(10, 2, true, 16);
+  peerServer.enableCompression(10, 2, true, 16);
+  CHECK(server.negotiate(source, peerServer, peer));
+
+  server.setRelay(0, &relay);
+  CHECK(server.addRelayTarget(relay, 1));
+
+  // compressed: not relayed, the event handler gets it inflated
+  CHECK(peerServer.send(peer, WSop_text, message));
+  CHECK(up[0] & 0x40);
+  server.pump(source);
+  CHECK(out1.empty());
+  CHECK(server.messages.size() == 1 && (server.messages[0] == message));
+
+  // too short to compress: relayed as it is
+  CHECK(peerServer.send(peer, WSop_text, "hi"));
+  server.pump(source);
+
+  std::vector<Frame> f1 = takeFrames(out1);
+
+  CHECK(f1.size() == 1 && !f1[0].rsv1 && (f1[0].data == "hi"));
+  CHECK_EQ(server.messages.size(), 1);
+
+  server.setRelay(0, NULL);
+  server.messages.clear();
+}
+
+static void testLifetime()
+{
+  WebSocketsRelay relay;
+
+  printf("relay, server and client lifetime\n");
+
+  // a relay destroyed in the middle of a message of its source
+  {
+    WebSocketsRelay scoped;
+
+    server.setRelay(0, &scoped);
+    CHECK(server.addRelayTarget(scoped, 1));
+    CHECK(peerServer.send(peer, WSop_text, "half", false));
+    server.pump(source);
+  }
+
+  std::vector<Frame> f1 = takeFrames(out1);
+
+  CHECK_EQ(f1.size(), 2);
+  CHECK(f1[1].opcode == WSop_continuation && f1[1].fin && f1[1].data.empty());
+  CHECK(!source->cRelay && !source->cRelaying && !target1->cRelayOwner);
+
+  CHECK(peerServer.send(peer, WSop_continuation, "rest"));
+  CHECK(peerServer.send(peer, WSop_text, "handler"));
+  server.pump(source);
+  CHECK(server.messages.size() == 1 && (server.messages[0] == "handler"));
+
+  // servers and clients destroyed as sources and targets
+  server.setRelay(0, &relay);
+  CHECK(server.addRelayTarget(relay, 1));
+
+  {
+    TestServer scoped;
+    WebSocketsClient client;
+
+    CHECK(scoped.addRelayTarget(relay));
+    CHECK(client.addRelayTarget(relay));
+    scoped.setRelay(&relay);
+    client.setRelay(&relay);
+    CHECK_EQ(relay.targets(), 2 + WEBSOCKETS_SERVER_CLIENT_MAX);
+
+    scoped.onEvent(nullptr);
+  }
+
+  CHECK_EQ(relay.targets(), 1);
+
+  CHECK(peerServer.send(peer, WSop_text, "after"));
+  server.pump(source);
+
+  f1 = takeFrames(out1);
+  CHECK(f1.size() == 1 && (f1[0].data == "after"));
+
+  server.setRelay(0, NULL);
+}
+
+int main()
+{
+  connectAll();
+
+  testFragmented();
+  testBusyTarget();
+  testSlotReuse();
+  testCompressedSource();
+  testLifetime();
+
+  server.onEvent(nullptr);
+  clientEnd.onEvent(nullptr);
+  peerServer.onEvent(nullptr);
+
+  return HOST_TEST_RESULT("websockets_relay_test");
+}